@@ -23,6 +23,8 @@ LOCAL_SRC_PATH := ../../../../../../../src
 LOCAL_SRC_FILES	:=  $(LOCAL_SRC_PATH)/core/debugrenderer.cpp \
 				    $(LOCAL_SRC_PATH)/core/image.cpp \
 					$(LOCAL_SRC_PATH)/core/log.cpp \
+					$(LOCAL_SRC_PATH)/core/mappedfile.cpp \
+					$(LOCAL_SRC_PATH)/core/parallelfor.cpp \
 					$(LOCAL_SRC_PATH)/core/program.cpp \
 					$(LOCAL_SRC_PATH)/core/texture.cpp \
 					$(LOCAL_SRC_PATH)/core/util.cpp \
@@ -32,13 +34,20 @@ LOCAL_SRC_FILES	:=  $(LOCAL_SRC_PATH)/core/debugrenderer.cpp \
 					$(LOCAL_SRC_PATH)/app.cpp \
 					$(LOCAL_SRC_PATH)/android_main.cpp \
 					$(LOCAL_SRC_PATH)/camerasconfig.cpp \
+					$(LOCAL_SRC_PATH)/cpusort.cpp \
 					$(LOCAL_SRC_PATH)/flycam.cpp \
 					$(LOCAL_SRC_PATH)/gaussiancloud.cpp \
 					$(LOCAL_SRC_PATH)/magiccarpet.cpp \
+					$(LOCAL_SRC_PATH)/multiradixsort.cpp \
+					$(LOCAL_SRC_PATH)/onesweepsort.cpp \
 					$(LOCAL_SRC_PATH)/ply.cpp \
 					$(LOCAL_SRC_PATH)/pointcloud.cpp \
 					$(LOCAL_SRC_PATH)/pointrenderer.cpp \
+					$(LOCAL_SRC_PATH)/shcolorcache.cpp \
+					$(LOCAL_SRC_PATH)/sorttuner.cpp \
+					$(LOCAL_SRC_PATH)/splatcache.cpp \
 					$(LOCAL_SRC_PATH)/splatrenderer.cpp \
+					$(LOCAL_SRC_PATH)/tilerasterizer.cpp \
 					$(LOCAL_SRC_PATH)/vrconfig.cpp \
 
 LOCAL_LDLIBS := -lEGL -lGLESv3 -landroid -llog -lpng -lpng16 -lz
@@ -16,9 +16,7 @@
 
 layout (local_size_x = WORKGROUP_SIZE) in;
 
-uniform uint g_num_elements;
 uniform uint g_shift;
-uniform uint g_num_workgroups;
 uniform uint g_num_blocks_per_workgroup;
 
 layout (std430, binding = 0) buffer elements_in {
@@ -42,6 +40,14 @@ layout (std430, binding = 4) buffer histograms {
     uint g_histograms[];// |g_histograms| = RADIX_SORT_BINS * #WORKGROUPS = RADIX_SORT_BINS * g_num_workgroups
 };
 
+// written by sort_args_compute.glsl, the element count is only known on the gpu.
+layout (std430, binding = 5) readonly buffer sort_args {
+    uint g_num_workgroups; // DispatchIndirectCommand.num_groups_x
+    uint g_num_groups_y;
+    uint g_num_groups_z;
+    uint g_num_elements; // DrawElementsIndirectCommand.count
+};
+
 shared uint[RADIX_SORT_BINS / SUBGROUP_SIZE] sums;// subgroup reductions
 shared uint[RADIX_SORT_BINS] global_offsets;// global exclusive scan (prefix sum)
 
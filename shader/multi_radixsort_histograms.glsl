@@ -8,9 +8,7 @@
 #define WORKGROUP_SIZE 256 // assert WORKGROUP_SIZE >= RADIX_SORT_BINS
 #define RADIX_SORT_BINS 256
 
-uniform uint g_num_elements;
 uniform uint g_shift;
-//uniform uint g_num_workgroups;
 uniform uint g_num_blocks_per_workgroup;
 
 layout (local_size_x = WORKGROUP_SIZE) in;
@@ -24,6 +22,14 @@ layout (std430, binding = 1) buffer histograms {
     uint g_histograms[]; // |g_histograms| = RADIX_SORT_BINS * #WORKGROUPS
 };
 
+// written by sort_args_compute.glsl, the element count is only known on the gpu.
+layout (std430, binding = 5) readonly buffer sort_args {
+    uint g_num_workgroups; // DispatchIndirectCommand.num_groups_x
+    uint g_num_groups_y;
+    uint g_num_groups_z;
+    uint g_num_elements; // DrawElementsIndirectCommand.count
+};
+
 shared uint[RADIX_SORT_BINS] histogram;
 
 void main() {
@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// first pass of the onesweep sort, see OnesweepSorter.
+// counts the digits of every radix pass in a single read of the keys, so each pass only has to scatter.
+// also clears the look-back status of this workgroup's tile, for onesweep_scatter.glsl.
+//
+
+/*%%HEADER%%*/
+
+#define WORKGROUP_SIZE 256  // must equal RADIX_BINS
+#define ITEMS_PER_THREAD 8  // must match onesweep_scatter.glsl and OnesweepSorter::GetTileSize()
+#define TILE_SIZE (WORKGROUP_SIZE * ITEMS_PER_THREAD)
+#define RADIX_BINS 256
+#define MAX_PASSES 4
+
+layout(local_size_x = WORKGROUP_SIZE) in;
+
+uniform uint g_num_passes;
+
+layout(std430, binding = 0) readonly buffer keys_in
+{
+    uint g_keys_in[];
+};
+
+layout(std430, binding = 4) buffer global_histograms
+{
+    uint g_global_histograms[];  // [pass][RADIX_BINS], zeroed before this pass
+};
+
+// written by sort_args_compute.glsl
+layout(std430, binding = 5) readonly buffer sort_args
+{
+    uint g_num_tiles;  // DispatchIndirectCommand.num_groups_x
+    uint g_num_groups_y;
+    uint g_num_groups_z;
+    uint g_num_elements;  // DrawElementsIndirectCommand.count
+};
+
+layout(std430, binding = 6) writeonly buffer partition_status
+{
+    uint g_status[];  // [pass][tile][RADIX_BINS]
+};
+
+shared uint s_histograms[MAX_PASSES][RADIX_BINS];
+
+void main()
+{
+    uint lID = gl_LocalInvocationID.x;
+    uint tile = gl_WorkGroupID.x;
+
+    for (uint pass = 0u; pass < MAX_PASSES; pass++)
+    {
+        s_histograms[pass][lID] = 0u;
+    }
+    barrier();
+
+    for (uint i = 0u; i < ITEMS_PER_THREAD; i++)
+    {
+        uint idx = tile * TILE_SIZE + i * WORKGROUP_SIZE + lID;
+        if (idx < g_num_elements)
+        {
+            uint key = g_keys_in[idx];
+            for (uint pass = 0u; pass < g_num_passes; pass++)
+            {
+                atomicAdd(s_histograms[pass][(key >> (8u * pass)) & uint(RADIX_BINS - 1)], 1u);
+            }
+        }
+    }
+    barrier();
+
+    for (uint pass = 0u; pass < g_num_passes; pass++)
+    {
+        uint count = s_histograms[pass][lID];
+        if (count > 0u)
+        {
+            atomicAdd(g_global_histograms[pass * RADIX_BINS + lID], count);
+        }
+        g_status[(pass * g_num_tiles + tile) * RADIX_BINS + lID] = 0u;
+    }
+}
@@ -0,0 +1,219 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// one radix pass of the onesweep sort, see OnesweepSorter.
+// where a tile's keys go depends on the digit counts of all the tiles before it. instead of a separate histogram
+// and scan dispatch per pass, each tile publishes its counts to g_status and looks back over its predecessors,
+// adding up their counts until it reaches one that has already published its inclusive prefix (decoupled look-back).
+// tiles are numbered in the order their workgroups start, so a tile only ever waits on tiles that are already running.
+// if a predecessor still hasn't published after MAX_SPINS tries, its counts are recomputed from its keys instead,
+// so the sort can't deadlock on hardware that doesn't schedule workgroups fairly.
+//
+
+/*%%HEADER%%*/
+
+#define WORKGROUP_SIZE 256  // must equal RADIX_BINS
+#define ITEMS_PER_THREAD 8  // must match onesweep_histogram.glsl and OnesweepSorter::GetTileSize()
+#define TILE_SIZE (WORKGROUP_SIZE * ITEMS_PER_THREAD)
+#define RADIX_BINS 256
+#define BITS 32
+
+// g_status entries are a 2 bit flag and a 30 bit count
+#define FLAG_NOT_READY 0u
+#define FLAG_AGGREGATE 1u  // count of this tile only
+#define FLAG_PREFIX 2u  // count of this tile and all the tiles before it
+#define FLAG_SHIFT 30u
+#define COUNT_MASK 0x3fffffffu
+#define MAX_SPINS 4096u
+
+layout(local_size_x = WORKGROUP_SIZE) in;
+
+uniform uint g_shift;
+uniform uint g_pass;
+
+layout(std430, binding = 0) readonly buffer keys_in
+{
+    uint g_keys_in[];
+};
+
+layout(std430, binding = 1) writeonly buffer keys_out
+{
+    uint g_keys_out[];
+};
+
+layout(std430, binding = 2) readonly buffer vals_in
+{
+    uint g_vals_in[];
+};
+
+layout(std430, binding = 3) writeonly buffer vals_out
+{
+    uint g_vals_out[];
+};
+
+layout(std430, binding = 4) readonly buffer global_histograms
+{
+    uint g_global_histograms[];  // [pass][RADIX_BINS], from onesweep_histogram.glsl
+};
+
+// written by sort_args_compute.glsl
+layout(std430, binding = 5) readonly buffer sort_args
+{
+    uint g_num_tiles;  // DispatchIndirectCommand.num_groups_x
+    uint g_num_groups_y;
+    uint g_num_groups_z;
+    uint g_num_elements;  // DrawElementsIndirectCommand.count
+};
+
+layout(std430, binding = 6) coherent buffer partition_status
+{
+    uint g_status[];  // [pass][tile][RADIX_BINS], cleared by onesweep_histogram.glsl
+};
+
+layout(std430, binding = 7) coherent buffer partition_counters
+{
+    uint g_partition_counters[];  // [pass], zeroed before the sort
+};
+
+shared uint s_tile;
+shared uint s_counts[RADIX_BINS];
+shared uint s_offsets[RADIX_BINS];  // output index of the next key with each digit
+shared uint s_bin_flags[RADIX_BINS][WORKGROUP_SIZE / BITS];
+
+uint GetDigit(uint key)
+{
+    return (key >> g_shift) & uint(RADIX_BINS - 1);
+}
+
+// slow path of the look-back, counts the keys of a tile that have this digit
+uint CountDigit(uint tile, uint digit)
+{
+    uint count = 0u;
+    uint end = min((tile + 1u) * TILE_SIZE, g_num_elements);
+    for (uint idx = tile * TILE_SIZE; idx < end; idx++)
+    {
+        count += GetDigit(g_keys_in[idx]) == digit ? 1u : 0u;
+    }
+    return count;
+}
+
+void main()
+{
+    uint lID = gl_LocalInvocationID.x;
+
+    if (lID == 0u)
+    {
+        s_tile = atomicAdd(g_partition_counters[g_pass], 1u);
+    }
+    s_counts[lID] = 0u;
+    barrier();
+    uint tile = s_tile;
+
+    uint keys[ITEMS_PER_THREAD];
+    for (uint i = 0u; i < ITEMS_PER_THREAD; i++)
+    {
+        uint idx = tile * TILE_SIZE + i * WORKGROUP_SIZE + lID;
+        keys[i] = idx < g_num_elements ? g_keys_in[idx] : 0u;
+        if (idx < g_num_elements)
+        {
+            atomicAdd(s_counts[GetDigit(keys[i])], 1u);
+        }
+    }
+    barrier();
+
+    // publish as early as possible, the tiles after this one are waiting on it.
+    uint count = s_counts[lID];
+    uint statusBase = g_pass * g_num_tiles * RADIX_BINS;
+    uint flag = tile == 0u ? FLAG_PREFIX : FLAG_AGGREGATE;
+    atomicExchange(g_status[statusBase + tile * RADIX_BINS + lID], (flag << FLAG_SHIFT) | count);
+
+    // exclusive scan of this pass's global histogram gives where each digit starts in the output
+    uint globalCount = g_global_histograms[g_pass * RADIX_BINS + lID];
+    s_offsets[lID] = globalCount;
+    barrier();
+    for (uint offset = 1u; offset < RADIX_BINS; offset <<= 1u)
+    {
+        uint value = lID >= offset ? s_offsets[lID - offset] : 0u;
+        barrier();
+        s_offsets[lID] += value;
+        barrier();
+    }
+    uint digitStart = s_offsets[lID] - globalCount;
+
+    // look-back, each thread handles one digit
+    uint prefix = 0u;
+    if (tile > 0u)
+    {
+        uint pred = tile - 1u;
+        uint spins = 0u;
+        while (true)
+        {
+            uint status = atomicOr(g_status[statusBase + pred * RADIX_BINS + lID], 0u);
+            uint predFlag = status >> FLAG_SHIFT;
+            if (predFlag == FLAG_NOT_READY)
+            {
+                if (++spins < MAX_SPINS)
+                {
+                    continue;
+                }
+                status = (FLAG_AGGREGATE << FLAG_SHIFT) | CountDigit(pred, lID);
+                predFlag = FLAG_AGGREGATE;
+            }
+
+            prefix += status & COUNT_MASK;
+            if (predFlag == FLAG_PREFIX || pred == 0u)
+            {
+                break;
+            }
+            pred--;
+            spins = 0u;
+        }
+        atomicExchange(g_status[statusBase + tile * RADIX_BINS + lID], (FLAG_PREFIX << FLAG_SHIFT) | (prefix + count));
+    }
+    barrier();
+    s_offsets[lID] = digitStart + prefix;
+
+    // scatter one row of WORKGROUP_SIZE keys at a time, ranking keys with the same digit by thread, so the sort is stable.
+    uint flagsWord = lID / BITS;
+    uint flagsBit = 1u << (lID % BITS);
+    for (uint i = 0u; i < ITEMS_PER_THREAD; i++)
+    {
+        for (uint w = 0u; w < WORKGROUP_SIZE / BITS; w++)
+        {
+            s_bin_flags[lID][w] = 0u;
+        }
+        barrier();
+
+        uint idx = tile * TILE_SIZE + i * WORKGROUP_SIZE + lID;
+        uint digit = GetDigit(keys[i]);
+        if (idx < g_num_elements)
+        {
+            atomicOr(s_bin_flags[digit][flagsWord], flagsBit);
+        }
+        barrier();
+
+        if (idx < g_num_elements)
+        {
+            uint rank = bitCount(s_bin_flags[digit][flagsWord] & (flagsBit - 1u));
+            for (uint w = 0u; w < flagsWord; w++)
+            {
+                rank += bitCount(s_bin_flags[digit][w]);
+            }
+            uint dst = s_offsets[digit] + rank;
+            g_keys_out[dst] = keys[i];
+            g_vals_out[dst] = g_vals_in[idx];
+        }
+        barrier();
+
+        uint rowCount = 0u;
+        for (uint w = 0u; w < WORKGROUP_SIZE / BITS; w++)
+        {
+            rowCount += bitCount(s_bin_flags[lID][w]);
+        }
+        s_offsets[lID] += rowCount;
+        barrier();
+    }
+}
@@ -0,0 +1,296 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// projects each splat once per frame, before the sort. evaluates the view transform, the 2D covariance and its inverse,
+// the SH color and the 3 sigma radius, culls the splats whose 3 sigma bounds are off screen, and writes a compact 2D record
+// for each visible splat, which splat_record_vert.glsl and tile_render_compute.glsl draw without looking at the splat again.
+//
+// each record is three vec4s, at three times the splat index:
+//     (center.x, center.y, ndc depth, radius), center and radius are in pixels, relative to the viewport.
+//     (conic.x, conic.y, conic.z, alpha), conic is the inverse of the 2D covariance. it stays a float, for long thin splats
+//     its determinant is tiny compared to its terms, and rounding them to halfs can turn the gaussian inside out.
+//     (color.r, color.g, color.b, 0)
+//
+// the sort keys are written like presort_compute.glsl's, or with TILE_KEYS, once for every 16x16 tile the splat overlaps,
+// for TileRasterizer. with RECORDS_ONLY no keys are written, the records are just projected again for another view
+// of the same sorted order, e.g. the second eye in vr, and the splats that are culled in that view get an empty record.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+// SPLAT_STRIDE and the *_OFFSET defines give the layout of the interleaved splat buffer, in floats,
+// see SplatRenderer::GetSplatLayoutDefines(). SH_DEGREE is 0 - 3, like splat_vert.glsl
+#ifndef SH_DEGREE
+#define SH_DEGREE 1
+#endif
+
+// KEEP_CULLED: see presort_compute.glsl
+// SH_COLOR_CACHE: read the colors evaluated by sh_color_compute.glsl, instead of evaluating the SH here
+// SH_LOD: evaluate the SH of each splat only up to the degree its size and distance call for, see SelectSHDegree() in sh_eval.glsl
+// SH_LOD_STATS: count the splats drawn with each degree, and how much their colors differ from the full SH
+// VISIBLE_CHUNKS: see presort_compute.glsl, the splats of the other chunks get no key and keep their old record
+
+#define TILE_SIZE 16
+
+layout(local_size_x = 256) in;
+
+uniform mat4 viewMat;
+uniform mat4 projMat;
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform vec3 eye;
+uniform float zNear;
+uniform vec2 cullPadding;  // in pixels, splats this far outside of the viewport are kept, e.g. for the other eye in vr
+#ifdef SH_LOD
+uniform vec2 shLodRadius;  // in pixels, smaller splats only use the dc color (x), or the first degree (y)
+uniform vec2 shLodDistance;  // farther splats only use the first degree (x), or the dc color (y)
+#endif
+#ifdef TILE_KEYS
+uniform vec2 depthRange;  // x = min depth, y = 1 / (max depth - min depth), see SortKeyParams in cpusort.h
+uniform uvec2 numTiles;
+uniform uint depthBits;  // the tile index is stored above the depth
+uniform uint maxInstances;  // size of the key and value buffers
+#elif !defined(RECORDS_ONLY)
+uniform vec2 depthRange;
+uniform uint keyMax;
+#endif
+
+layout(std430, binding = 0) readonly buffer SplatBuffer
+{
+    float splatData[];
+};
+
+layout(std430, binding = 1) writeonly buffer KeyBuffer
+{
+    uint keys[];
+};
+
+layout(std430, binding = 2) writeonly buffer ValBuffer
+{
+    uint vals[];  // splat indices
+};
+
+layout(std430, binding = 3) writeonly buffer RecordBuffer
+{
+    vec4 records[];
+};
+
+// number of keys written. with TILE_KEYS it can end up larger than maxInstances, TileRasterizer grows the buffers when it does.
+layout(std430, binding = 4) buffer CountBuffer
+{
+    uint outputCount;
+};
+
+#ifdef SH_COLOR_CACHE
+layout(std430, binding = 5) readonly buffer ColorBuffer
+{
+    uvec2 colors[];
+};
+#endif
+
+#ifdef SH_LOD_STATS
+layout(std430, binding = 6) buffer SHLodStatsBuffer
+{
+    uint numPerDegree[4];  // visible splats
+    uint numChanged;  // visible splats whose color differs from the full SH by more than 1 / 255
+    uint maxErrorBits;  // largest difference, as float bits, which sort like uints for positive floats
+};
+#endif
+
+#ifdef VISIBLE_CHUNKS
+layout(std430, binding = 7) readonly buffer ChunkBuffer
+{
+    uint visibleChunks[];
+};
+#endif
+
+vec3 LoadVec3(uint offset)
+{
+    return vec3(splatData[offset], splatData[offset + 1u], splatData[offset + 2u]);
+}
+
+vec4 LoadVec4(uint offset)
+{
+    return vec4(splatData[offset], splatData[offset + 1u], splatData[offset + 2u], splatData[offset + 3u]);
+}
+
+/*%%SH_EVAL%%*/
+
+#ifdef FRAMEBUFFER_SRGB
+float SRGBToLinearF(float srgb)
+{
+    if (srgb <= 0.04045f)
+    {
+        return srgb / 12.92f;
+    }
+    else
+    {
+        return pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+}
+
+vec3 SRGBToLinear(const vec3 srgbColor)
+{
+    vec3 linearColor;
+    for (int i = 0; i < 3; ++i) // Convert RGB, leave A unchanged
+    {
+        linearColor[i] = SRGBToLinearF(srgbColor[i]);
+    }
+    return linearColor;
+}
+#endif
+
+void main()
+{
+#ifdef VISIBLE_CHUNKS
+    uint idx = visibleChunks[gl_WorkGroupID.x] * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+#else
+    uint idx = gl_GlobalInvocationID.x;
+#endif
+    uint base = idx * SPLAT_STRIDE;
+    if (base >= uint(splatData.length()))
+    {
+        return;
+    }
+
+    vec4 position = LoadVec4(base + POSITION_OFFSET);
+    float alpha = position.w;
+    vec4 t = viewMat * vec4(position.xyz, 1.0f);
+    float depth = -t.z;
+
+    float WIDTH = viewport.z;
+    float HEIGHT = viewport.w;
+
+    // same affine approximation of the projection as splat_vert.glsl, the z row isn't needed.
+    float SX = projMat[0][0];
+    float SY = projMat[1][1];
+    float tzSq = t.z * t.z;
+    float jsx = -(SX * WIDTH) / (2.0f * t.z);
+    float jsy = -(SY * HEIGHT) / (2.0f * t.z);
+    float jtx = (SX * t.x * WIDTH) / (2.0f * tzSq);
+    float jty = (SY * t.y * HEIGHT) / (2.0f * tzSq);
+    mat3 J = mat3(vec3(jsx, 0.0f, 0.0f),
+                  vec3(0.0f, jsy, 0.0f),
+                  vec3(jtx, jty, 0.0f));
+
+    mat3 W = mat3(viewMat);
+    mat3 V = mat3(LoadVec3(base + COV3_COL0_OFFSET), LoadVec3(base + COV3_COL1_OFFSET), LoadVec3(base + COV3_COL2_OFFSET));
+    mat3 JW = J * W;
+    mat3 V_prime = JW * V * transpose(JW);
+
+    // low-pass filter, like splat_vert.glsl
+    float a = V_prime[0][0] + 0.3f;
+    float b = V_prime[0][1];
+    float c = V_prime[1][1] + 0.3f;
+    float det = a * c - b * b;
+
+    // 3 sigma along the major axis
+    float mid = 0.5f * (a + c);
+    float lambda = mid + sqrt(max(0.1f, mid * mid - det));
+    float radius = ceil(3.0f * sqrt(lambda));
+
+    vec4 p4 = projMat * t;
+    vec2 p = vec2(0.5f * WIDTH * (p4.x / p4.w + 1.0f), 0.5f * HEIGHT * (p4.y / p4.w + 1.0f));
+
+    // instead of testing the center against a guard band, the whole 3 sigma square must miss the viewport.
+    bool visible = depth > zNear && alpha >= (1.0f / 256.0f) && det > 0.0f &&
+                   p.x + radius > -cullPadding.x && p.x - radius < WIDTH + cullPadding.x &&
+                   p.y + radius > -cullPadding.y && p.y - radius < HEIGHT + cullPadding.y;
+
+#ifdef TILE_KEYS
+    ivec2 rectMin = clamp(ivec2(floor((p - radius) / float(TILE_SIZE))), ivec2(0), ivec2(numTiles));
+    ivec2 rectMax = clamp(ivec2(floor((p + radius) / float(TILE_SIZE))) + 1, ivec2(0), ivec2(numTiles));
+    uint numSplatTiles = uint((rectMax.x - rectMin.x) * (rectMax.y - rectMin.y));
+    if (!visible || numSplatTiles == 0u)
+    {
+        return;
+    }
+#elif defined(RECORDS_ONLY)
+    if (!visible)
+    {
+        // a degenerate quad, outside of the clip volume
+        records[idx * 3u] = vec4(0.0f, 0.0f, 2.0f, 0.0f);
+        return;
+    }
+#else
+    // depths in the range map onto keys keyMax .. 0, so far splats are drawn first, see presort_compute.glsl
+    float keyT = clamp((depth - depthRange.x) * depthRange.y, 0.0f, 0.99999994f);
+    uint fixedPointZ = keyMax - uint(keyT * float(keyMax));
+
+#ifdef KEEP_CULLED
+    if (visible)
+    {
+        atomicAdd(outputCount, 1u);
+    }
+    keys[idx] = visible ? fixedPointZ : 0xffffffffu;
+    vals[idx] = idx;
+#else
+    if (visible)
+    {
+        uint count = atomicAdd(outputCount, 1u);
+        keys[count] = fixedPointZ;
+        vals[count] = idx;
+    }
+#endif
+    if (!visible)
+    {
+        return;
+    }
+#endif
+
+    vec3 conic = vec3(c, -b, a) / det;
+#ifdef SH_COLOR_CACHE
+    vec3 color = vec3(unpackHalf2x16(colors[idx].x), unpackHalf2x16(colors[idx].y).x);
+#else
+    vec3 v = normalize(position.xyz - eye);
+#ifdef SH_LOD
+    uint degree = SelectSHDegree(radius, depth);
+#else
+    uint degree = uint(SH_DEGREE);
+#endif
+    vec3 color = ComputeRadianceFromSH(base, v, degree);
+#ifdef SH_LOD_STATS
+    float error = 0.0f;
+    if (degree < uint(SH_DEGREE))
+    {
+        vec3 diff = abs(ComputeRadianceFromSH(base, v, uint(SH_DEGREE)) - color);
+        error = max(diff.x, max(diff.y, diff.z));
+    }
+    atomicAdd(numPerDegree[degree], 1u);
+    if (error > (1.0f / 255.0f))
+    {
+        atomicAdd(numChanged, 1u);
+    }
+    atomicMax(maxErrorBits, floatBitsToUint(error));
+#endif
+#ifdef FRAMEBUFFER_SRGB
+    // see splat_vert.glsl
+    color = SRGBToLinear(color);
+#endif
+#endif
+
+    records[idx * 3u] = vec4(p, p4.z / p4.w, radius);
+    records[idx * 3u + 1u] = vec4(conic, alpha);
+    records[idx * 3u + 2u] = vec4(color, 0.0f);
+
+#ifdef TILE_KEYS
+    // near splats get the smaller keys, so each tile is blended front to back.
+    float depthT = clamp((depth - depthRange.x) * depthRange.y, 0.0f, 0.99999994f);
+    uint depthKey = uint(depthT * float((1u << depthBits) - 1u));
+
+    uint offset = atomicAdd(outputCount, numSplatTiles);
+    for (int y = rectMin.y; y < rectMax.y; y++)
+    {
+        for (int x = rectMin.x; x < rectMax.x && offset < maxInstances; x++)
+        {
+            keys[offset] = ((uint(y) * numTiles.x + uint(x)) << depthBits) | depthKey;
+            vals[offset] = idx;
+            offset++;
+        }
+    }
+#endif
+}
@@ -5,10 +5,19 @@
 
 /*%%HEADER%%*/
 
+/*%%DEFINES%%*/
+
+// KEEP_CULLED: instead of compacting the visible splats to the front, every splat is written at its own index.
+// culled splats get a key of 0xffffffff, keyMax must be less than that, so they sort after all the visible splats.
+// the sort can then use the total number of splats, so it doesn't need to know output_count on the cpu.
+
+// VISIBLE_CHUNKS: each workgroup handles the 256 splats of one chunk that passed SplatRenderer::CullChunks(),
+// instead of the workgroups covering every splat. can't be used with KEEP_CULLED.
+
 layout(local_size_x = 256) in;
 
 uniform mat4 modelViewProj;
-uniform vec2 nearFar;
+uniform vec2 depthRange;  // x = min depth, y = 1 / (max depth - min depth), see SortKeyParams in cpusort.h
 uniform uint keyMax;
 
 layout(binding = 4, offset = 0) uniform atomic_uint output_count;
@@ -28,9 +37,20 @@ layout(std430, binding = 2) writeonly buffer OutputBuffer2
     uint indices[];
 };
 
+#ifdef VISIBLE_CHUNKS
+layout(std430, binding = 7) readonly buffer ChunkBuffer
+{
+    uint visibleChunks[];
+};
+#endif
+
 void main()
 {
+#ifdef VISIBLE_CHUNKS
+    uint idx = visibleChunks[gl_WorkGroupID.x] * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+#else
     uint idx = gl_GlobalInvocationID.x;
+#endif
 
 	uint len = uint(positions.length());
     if (idx >= len)
@@ -45,13 +65,26 @@ void main()
     float yy = p.y / depth;
 
     const float CLIP = 1.5f;
-    if (depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP)
+    bool visible = depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP;
+
+    // depths in the range map onto keys keyMax .. 0, so far splats are drawn first.
+    // t is kept just below 1, so a 32 bit keyMax (which rounds up to 2^32 as a float) can't overflow.
+    float t = clamp((depth - depthRange.x) * depthRange.y, 0.0f, 0.99999994f);
+    uint fixedPointZ = keyMax - uint(t * float(keyMax));
+
+#ifdef KEEP_CULLED
+    if (visible)
+    {
+        atomicCounterIncrement(output_count);
+    }
+    quantizedZs[idx] = visible ? fixedPointZ : 0xffffffffu;
+    indices[idx] = idx;
+#else
+    if (visible)
     {
         uint count = atomicCounterIncrement(output_count);
-        // 16.16 fixed point
-        //uint fixedPointZ = uint(0xffffffff) - uint(clamp(depth, 0.0f, 65535.0f) * 65536.0f);
-		uint fixedPointZ = keyMax - uint((depth / nearFar.y) * keyMax);
         quantizedZs[count] = fixedPointZ;
         indices[count] = idx;
     }
+#endif
 }
@@ -0,0 +1,140 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// evaluates the view dependent color of each splat from its SH coefficients, for SHColorCache.
+// a color is only evaluated again once the direction from the eye to the splat has turned by more than the tolerance
+// since it was last evaluated. with numPhases > 1, each update only looks at every numPhases-th splat.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+// SPLAT_STRIDE and the *_OFFSET defines give the layout of the interleaved splat buffer, in floats,
+// see SplatRenderer::GetSplatLayoutDefines(). SH_DEGREE is 0 - 3, like splat_vert.glsl
+#ifndef SH_DEGREE
+#define SH_DEGREE 1
+#endif
+
+layout(local_size_x = 256) in;
+
+uniform vec3 eye;
+uniform float cosTolerance;
+uniform uint numPhases;
+uniform uint phase;  // 0 .. numPhases - 1
+uniform bool recomputeAll;
+
+layout(std430, binding = 0) readonly buffer SplatBuffer
+{
+    float splatData[];
+};
+
+// (r, g) and (b, 0) as halfs, already converted to linear with FRAMEBUFFER_SRGB
+layout(std430, binding = 1) buffer ColorBuffer
+{
+    uvec2 colors[];
+};
+
+// the direction each color was evaluated for, octahedral encoded as two snorm16s
+layout(std430, binding = 2) buffer DirBuffer
+{
+    uint dirs[];
+};
+
+layout(std430, binding = 3) buffer CountBuffer
+{
+    uint numRecomputed;
+};
+
+shared uint s_numRecomputed;
+
+vec3 LoadVec3(uint offset)
+{
+    return vec3(splatData[offset], splatData[offset + 1u], splatData[offset + 2u]);
+}
+
+vec4 LoadVec4(uint offset)
+{
+    return vec4(splatData[offset], splatData[offset + 1u], splatData[offset + 2u], splatData[offset + 3u]);
+}
+
+/*%%SH_EVAL%%*/
+
+#ifdef FRAMEBUFFER_SRGB
+float SRGBToLinearF(float srgb)
+{
+    if (srgb <= 0.04045f)
+    {
+        return srgb / 12.92f;
+    }
+    else
+    {
+        return pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+}
+
+vec3 SRGBToLinear(const vec3 srgbColor)
+{
+    vec3 linearColor;
+    for (int i = 0; i < 3; ++i) // Convert RGB, leave A unchanged
+    {
+        linearColor[i] = SRGBToLinearF(srgbColor[i]);
+    }
+    return linearColor;
+}
+#endif
+
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    return n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * signs;
+}
+
+vec3 OctDecode(vec2 p)
+{
+    vec3 n = vec3(p, 1.0f - abs(p.x) - abs(p.y));
+    if (n.z < 0.0f)
+    {
+        vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.xy = (1.0f - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        s_numRecomputed = 0u;
+    }
+    barrier();
+
+    uint idx = gl_GlobalInvocationID.x;
+    uint base = idx * SPLAT_STRIDE;
+    if (base < uint(splatData.length()) && (recomputeAll || idx % numPhases == phase))
+    {
+        vec3 v = normalize(LoadVec3(base + POSITION_OFFSET) - eye);
+        if (recomputeAll || dot(v, OctDecode(unpackSnorm2x16(dirs[idx]))) < cosTolerance)
+        {
+            vec3 color = ComputeRadianceFromSH(base, v, uint(SH_DEGREE));
+#ifdef FRAMEBUFFER_SRGB
+            // see splat_vert.glsl
+            color = SRGBToLinear(color);
+#endif
+            colors[idx] = uvec2(packHalf2x16(color.rg), packHalf2x16(vec2(color.b, 0.0f)));
+            dirs[idx] = packSnorm2x16(OctEncode(v));
+            atomicAdd(s_numRecomputed, 1u);
+        }
+    }
+
+    // one global atomic per workgroup
+    barrier();
+    if (gl_LocalInvocationIndex == 0u && s_numRecomputed > 0u)
+    {
+        atomicAdd(numRecomputed, s_numRecomputed);
+    }
+}
@@ -0,0 +1,125 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// spherical harmonics evaluation, shared by every shader that computes the view dependent color of a splat.
+// this is not a shader by itself, SplatRenderer injects it in place of /*%%SH_EVAL%%*/, after SH_DEGREE is defined.
+//
+// the coeffs are read through the SH_ macros below, so a coeff is only loaded once the degree calls for it.
+// by default they read the splatData layout of SplatRenderer::GetSplatLayoutDefines() at offset base, with the
+// LoadVec4() of the including shader. splat_vert.glsl defines them as its vertex attributes instead.
+// SH_R0 holds the dc and first order coeffs of the red channel, SH_R1 and SH_R2 the next 8, and SH_R3 the last 4.
+//
+
+#ifndef SH_DC
+#define SH_DC vec3(splatData[base + R_SH0_OFFSET], splatData[base + G_SH0_OFFSET], splatData[base + B_SH0_OFFSET])
+#define SH_R0 LoadVec4(base + R_SH0_OFFSET)
+#define SH_G0 LoadVec4(base + G_SH0_OFFSET)
+#define SH_B0 LoadVec4(base + B_SH0_OFFSET)
+#define SH_R1 LoadVec4(base + R_SH1_OFFSET)
+#define SH_G1 LoadVec4(base + G_SH1_OFFSET)
+#define SH_B1 LoadVec4(base + B_SH1_OFFSET)
+#define SH_R2 LoadVec4(base + R_SH2_OFFSET)
+#define SH_G2 LoadVec4(base + G_SH2_OFFSET)
+#define SH_B2 LoadVec4(base + B_SH2_OFFSET)
+#define SH_R3 LoadVec4(base + R_SH3_OFFSET)
+#define SH_G3 LoadVec4(base + G_SH3_OFFSET)
+#define SH_B3 LoadVec4(base + B_SH3_OFFSET)
+#endif
+
+// the dc color only, the first coefficient of each channel
+vec3 ComputeDCRadiance(const uint base)
+{
+    // (/ 1.0 (* 2.0 (sqrt pi)))
+    float b0 = 0.28209479177387814f;
+    return vec3(0.5f, 0.5f, 0.5f) + b0 * SH_DC;
+}
+
+// degree can be lower than SH_DEGREE, the coefficients above it aren't loaded at all.
+vec3 ComputeRadianceFromSH(const uint base, const vec3 v, const uint degree)
+{
+#if SH_DEGREE == 0
+    return ComputeDCRadiance(base);
+#else
+    if (degree == 0u)
+    {
+        return ComputeDCRadiance(base);
+    }
+
+    float vx2 = v.x * v.x;
+    float vy2 = v.y * v.y;
+    float vz2 = v.z * v.z;
+
+    // zeroth and first order
+    // (/ 1.0 (* 2.0 (sqrt pi)))
+    float k0 = 0.28209479177387814f;
+    // (/ (sqrt 3.0) (* 2 (sqrt pi)))
+    float k1 = 0.4886025119029199f;
+    vec4 b0 = vec4(k0, -k1 * v.y, k1 * v.z, -k1 * v.x);
+
+    vec3 color = vec3(dot(b0, SH_R0), dot(b0, SH_G0), dot(b0, SH_B0));
+
+#if SH_DEGREE >= 2
+    if (degree < 2u)
+    {
+        return vec3(0.5f, 0.5f, 0.5f) + color;
+    }
+
+    // second order, and the first three third order coeffs, which are uploaded with it
+    // (/ (sqrt 15.0) (* 2 (sqrt pi)))
+    float k2 = 1.0925484305920792f;
+    // (/ (sqrt 5.0) (* 4 (sqrt  pi)))
+    float k3 = 0.31539156525252005f;
+    // (/ (sqrt 15.0) (* 4 (sqrt pi)))
+    float k4 = 0.5462742152960396f;
+    // (/ (* (sqrt 2) (sqrt 35)) (* 8 (sqrt pi)))
+    float k5 = 0.5900435899266435f;
+    // (/ (sqrt 105) (* 2 (sqrt pi)))
+    float k6 = 2.8906114426405543f;
+    // (/ (* (sqrt 2) (sqrt 21)) (* 8 (sqrt pi)))
+    float k7 = 0.4570457994644658f;
+    vec4 b1 = vec4(k2 * v.y * v.x, -k2 * v.y * v.z, k3 * (3.0f * vz2 - 1.0f), -k2 * v.x * v.z);
+    vec4 b2 = vec4(k4 * (vx2 - vy2), -k5 * v.y * (3.0f * vx2 - vy2), k6 * v.y * v.x * v.z, -k7 * v.y * (5.0f * vz2 - 1.0f));
+
+    color += vec3(dot(b1, SH_R1) + dot(b2, SH_R2),
+                  dot(b1, SH_G1) + dot(b2, SH_G2),
+                  dot(b1, SH_B1) + dot(b2, SH_B2));
+#endif
+
+#if SH_DEGREE >= 3
+    if (degree < 3u)
+    {
+        return vec3(0.5f, 0.5f, 0.5f) + color;
+    }
+
+    // the rest of the third order
+    // (/ (sqrt 7) (* 4 (sqrt pi)))
+    float k8 = 0.37317633259011546f;
+    // (/ (sqrt 105) (* 4 (sqrt pi)))
+    float k9 = 1.4453057213202771f;
+    vec4 b3 = vec4(k8 * v.z * (5.0f * vz2 - 3.0f), -k7 * v.x * (5.0f * vz2 - 1.0f), k9 * v.z * (vx2 - vy2), -k5 * v.x * (vx2 - 3.0f * vy2));
+
+    color += vec3(dot(b3, SH_R3), dot(b3, SH_G3), dot(b3, SH_B3));
+#endif
+    return vec3(0.5f, 0.5f, 0.5f) + color;
+#endif
+}
+
+#ifdef SH_LOD
+// small and distant splats gain nothing from the higher degrees, radius is the 3 sigma radius in pixels.
+// the including shader declares the shLodRadius and shLodDistance uniforms.
+uint SelectSHDegree(float radius, float depth)
+{
+    if (radius < shLodRadius.x || depth > shLodDistance.y)
+    {
+        return 0u;
+    }
+    if (radius < shLodRadius.y || depth > shLodDistance.x)
+    {
+        return min(1u, uint(SH_DEGREE));
+    }
+    return uint(SH_DEGREE);
+}
+#endif
@@ -17,19 +17,19 @@ layout (local_size_x = WORKGROUP_SIZE) in;
 
 uniform uint g_num_elements;
 
-layout (std430, set = 0, binding = 0) buffer elements_in {
+layout (std430, binding = 0) buffer elements_in {
     uint g_elements_in[];
 };
 
-layout (std430, set = 0, binding = 1) buffer elements_out {
+layout (std430, binding = 1) buffer elements_out {
     uint g_elements_out[];
 };
 
-layout (std430, set = 0, binding = 2) buffer indices_in {
+layout (std430, binding = 2) buffer indices_in {
     uint g_indices_in[];
 };
 
-layout (std430, set = 0, binding = 3) buffer indices_out {
+layout (std430, binding = 3) buffer indices_out {
     uint g_indices_out[];
 };
 
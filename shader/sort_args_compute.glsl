@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// turns the number of visible splats, counted by presort_compute.glsl, into indirect dispatch and draw commands.
+// so the count never has to be read back on the cpu.
+//
+
+/*%%HEADER%%*/
+
+layout(local_size_x = 1) in;
+
+uniform uint numElementsPerWorkgroup;
+uniform uint maxCount;  // size of the buffers that are sorted and drawn, larger counts are clamped to it
+
+layout(std430, binding = 0) readonly buffer CountBuffer
+{
+    uint visibleCount;  // output_count from presort_compute.glsl
+};
+
+layout(std430, binding = 1) writeonly buffer IndirectBuffer
+{
+    // DispatchIndirectCommand, for the sort passes
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+
+    // DrawElementsIndirectCommand, for the splats
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+
+    // DrawArraysIndirectCommand, for the splats drawn as instanced quads, see splat_quad_vert.glsl
+    uint quadCount;
+    uint quadInstanceCount;
+    uint quadFirst;
+    uint quadBaseInstance;
+};
+
+void main()
+{
+    uint n = min(visibleCount, maxCount);
+    numGroupsX = (n + numElementsPerWorkgroup - 1u) / numElementsPerWorkgroup;
+    numGroupsY = 1u;
+    numGroupsZ = 1u;
+
+    count = n;
+    instanceCount = 1u;
+    firstIndex = 0u;
+    baseVertex = 0;
+    baseInstance = 0u;
+
+    quadCount = 4u;
+    quadInstanceCount = n;
+    quadFirst = 0u;
+    quadBaseInstance = 0u;
+}
@@ -0,0 +1,222 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// 3d gaussian splat vertex shader, without a geometry shader.
+// each splat is an instance of a 4 vertex triangle strip, its attributes are pulled from the interleaved splat buffer,
+// in the sorted order, and each vertex computes its own corner of the quad splat_geom.glsl would have emitted.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+// SPLAT_STRIDE and the *_OFFSET defines give the layout of the interleaved splat buffer, in floats,
+// see SplatRenderer::GetSplatLayoutDefines(). SH_DEGREE is 0 - 3, like splat_vert.glsl
+#ifndef SH_DEGREE
+#define SH_DEGREE 1
+#endif
+
+// SH_COLOR_CACHE: read the colors evaluated by sh_color_compute.glsl, instead of evaluating the SH here
+// SH_LOD: evaluate the SH of each splat only up to the degree its size and distance call for, see SelectSHDegree() in sh_eval.glsl
+
+uniform mat4 viewMat;  // used to project position into view coordinates.
+uniform mat4 projMat;  // used to project view coordinates into clip coordinates.
+uniform vec4 projParams;  // x = HEIGHT / tan(FOVY / 2), y = Z_NEAR, z = Z_FAR
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform vec3 eye;
+#ifdef SH_LOD
+uniform vec2 shLodRadius;  // in pixels, smaller splats only use the dc color (x), or the first degree (y)
+uniform vec2 shLodDistance;  // farther splats only use the first degree (x), or the dc color (y)
+#endif
+
+layout(std430, binding = 0) readonly buffer SplatBuffer
+{
+    float splatData[];
+};
+
+// the element buffer, written by the sort
+layout(std430, binding = 1) readonly buffer IndexBuffer
+{
+    uint indices[];
+};
+
+#ifdef SH_COLOR_CACHE
+layout(std430, binding = 2) readonly buffer ColorBuffer
+{
+    uvec2 colors[];
+};
+#endif
+
+out vec4 frag_color;  // radiance of splat
+out vec4 frag_cov2inv;  // inverse of the 2D screen space covariance matrix of the guassian
+out vec2 frag_p;  // the 2D screen space center of the gaussian
+
+vec3 LoadVec3(uint offset)
+{
+    return vec3(splatData[offset], splatData[offset + 1u], splatData[offset + 2u]);
+}
+
+vec4 LoadVec4(uint offset)
+{
+    return vec4(splatData[offset], splatData[offset + 1u], splatData[offset + 2u], splatData[offset + 3u]);
+}
+
+/*%%SH_EVAL%%*/
+
+#ifdef FRAMEBUFFER_SRGB
+float SRGBToLinearF(float srgb)
+{
+    if (srgb <= 0.04045f)
+    {
+        return srgb / 12.92f;
+    }
+    else
+    {
+        return pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+}
+
+vec3 SRGBToLinear(const vec3 srgbColor)
+{
+    vec3 linearColor;
+    for (int i = 0; i < 3; ++i) // Convert RGB, leave A unchanged
+    {
+        linearColor[i] = SRGBToLinearF(srgbColor[i]);
+    }
+    return linearColor;
+}
+#endif
+
+// used to invert the 2D screen space covariance matrix
+mat2 inverseMat2(mat2 m)
+{
+    float det = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    mat2 inv;
+    inv[0][0] =  m[1][1] / det;
+    inv[0][1] = -m[0][1] / det;
+    inv[1][0] = -m[1][0] / det;
+    inv[1][1] =  m[0][0] / det;
+
+    return inv;
+}
+
+void main(void)
+{
+    uint idx = indices[gl_InstanceID];
+    uint base = idx * SPLAT_STRIDE;
+
+    // t is in view coordinates
+    vec4 position = LoadVec4(base + POSITION_OFFSET);
+    float alpha = position.w;
+    vec4 t = viewMat * vec4(position.xyz, 1.0f);
+
+    //float X0 = viewport.x;
+    float X0 = viewport.x * (0.00001f * projParams.y);  // one weird hack to prevent projParams from being compiled away
+    float Y0 = viewport.y;
+    float WIDTH = viewport.z;
+    float HEIGHT = viewport.w;
+    float Z_NEAR = projParams.y;
+    float Z_FAR = projParams.z;
+
+    // J is the jacobian of the projection and viewport transformations, see splat_vert.glsl
+    float SX = projMat[0][0];
+    float SY = projMat[1][1];
+    float WZ =  projMat[3][2];
+    float tzSq = t.z * t.z;
+    float jsx = -(SX * WIDTH) / (2.0f * t.z);
+    float jsy = -(SY * HEIGHT) / (2.0f * t.z);
+    float jtx = (SX * t.x * WIDTH) / (2.0f * tzSq);
+    float jty = (SY * t.y * HEIGHT) / (2.0f * tzSq);
+    float jtz = ((Z_FAR - Z_NEAR) * WZ) / (2.0f * tzSq);
+    mat3 J = mat3(vec3(jsx, 0.0f, 0.0f),
+                  vec3(0.0f, jsy, 0.0f),
+                  vec3(jtx, jty, jtz));
+
+    mat3 W = mat3(viewMat);
+    mat3 V = mat3(LoadVec3(base + COV3_COL0_OFFSET), LoadVec3(base + COV3_COL1_OFFSET), LoadVec3(base + COV3_COL2_OFFSET));
+    mat3 JW = J * W;
+    mat3 V_prime = JW * V * transpose(JW);
+    mat2 cov2D = mat2(V_prime);
+
+    // low-pass filter to anti-alias the splats
+    cov2D[0][0] += 0.3f;
+    cov2D[1][1] += 0.3f;
+
+    vec4 p4 = projMat * t;
+
+    // discard splats that end up outside of a guard band, like splat_geom.glsl, by collapsing the quad outside the clip volume.
+    vec3 ndcP = p4.xyz / p4.w;
+    if (ndcP.z < 0.25f ||
+        ndcP.x > 2.0f || ndcP.x < -2.0f ||
+        ndcP.y > 2.0f || ndcP.y < -2.0f)
+    {
+        gl_Position = vec4(0.0f, 0.0f, 2.0f, 1.0f);
+        frag_color = vec4(0.0f);
+        frag_cov2inv = vec4(0.0f);
+        frag_p = vec2(0.0f);
+        return;
+    }
+
+    // the gaussian center in screen space
+    frag_p = vec2(p4.x / p4.w, p4.y / p4.w);
+    frag_p.x = 0.5f * (WIDTH + (frag_p.x * WIDTH) + (2.0f * X0));
+    frag_p.y = 0.5f * (HEIGHT + (frag_p.y * HEIGHT) + (2.0f * Y0));
+
+    mat2 cov2Dinv = inverseMat2(cov2D);
+    frag_cov2inv = vec4(cov2Dinv[0], cov2Dinv[1]);
+
+#ifdef SH_COLOR_CACHE
+    uvec2 color = colors[idx];
+    frag_color = vec4(unpackHalf2x16(color.x), unpackHalf2x16(color.y).x, alpha);
+#else
+    vec3 v = normalize(position.xyz - eye);
+#ifdef SH_LOD
+    // the larger axis aligned deviation is close enough to pick a degree
+    uint degree = SelectSHDegree(3.0f * sqrt(max(cov2D[0][0], cov2D[1][1])), -t.z);
+#else
+    uint degree = uint(SH_DEGREE);
+#endif
+    frag_color = vec4(ComputeRadianceFromSH(base, v, degree), alpha);
+#ifdef FRAMEBUFFER_SRGB
+    // see splat_vert.glsl
+    frag_color.rgb = SRGBToLinear(frag_color.rgb);
+#endif
+#endif
+
+    // 2d extents of the splat, using the covariance matrix ellipse, see splat_geom.glsl
+    float k = 3.5f;
+    float a = cov2D[0][0];
+    float b = cov2D[0][1];
+    float c = cov2D[1][1];
+    float apco2 = (a + c) / 2.0f;
+    float amco2 = (a - c) / 2.0f;
+    float term = sqrt(amco2 * amco2 + b * b);
+    float maj = apco2 + term;
+    float min = apco2 - term;
+
+    float theta;
+    if (b == 0.0f)
+    {
+        theta = (a >= c) ? 0.0f : radians(90.0f);
+    }
+    else
+    {
+        theta = atan(maj - a, b);
+    }
+
+    float r1 = k * sqrt(maj);
+    float r2 = k * sqrt(min);
+    vec2 majAxis = vec2(r1 * cos(theta), r1 * sin(theta));
+    vec2 minAxis = vec2(r2 * cos(theta + radians(90.0f)), r2 * sin(theta + radians(90.0f)));
+
+    // same corners, in the same strip order, as splat_geom.glsl
+    vec2 offset = (((gl_VertexID & 1) == 0) ? majAxis : -majAxis) + (((gl_VertexID & 2) == 0) ? minAxis : -minAxis);
+
+    // transform offset back into clip space
+    offset.x *= (2.0f / WIDTH) * p4.w;
+    offset.y *= (2.0f / HEIGHT) * p4.w;
+    gl_Position = p4 + vec4(offset.x, offset.y, 0.0f, 0.0f);
+}
@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// 3d gaussian splat vertex shader, for splats that have already been projected by preprocess_compute.glsl.
+// each splat is an instance of a 4 vertex triangle strip, covering the square of its 3 sigma radius.
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+
+// written by preprocess_compute.glsl
+layout(std430, binding = 0) readonly buffer RecordBuffer
+{
+    vec4 records[];
+};
+
+// the element buffer, written by the sort
+layout(std430, binding = 1) readonly buffer IndexBuffer
+{
+    uint indices[];
+};
+
+out vec4 frag_color;  // radiance of splat
+out vec4 frag_cov2inv;  // inverse of the 2D screen space covariance matrix of the guassian
+out vec2 frag_p;  // the 2D screen space center of the gaussian
+
+void main(void)
+{
+    uint idx = indices[gl_InstanceID];
+    vec4 r0 = records[idx * 3u];
+    vec4 r1 = records[idx * 3u + 1u];
+    vec4 r2 = records[idx * 3u + 2u];
+
+    frag_color = vec4(r2.rgb, r1.w);
+    frag_cov2inv = vec4(r1.x, r1.y, r1.y, r1.z);
+    frag_p = r0.xy + viewport.xy;
+
+    // corners in triangle strip order
+    vec2 corner = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1)) * 2.0f - 1.0f;
+    vec2 pixel = r0.xy + corner * r0.w;
+    gl_Position = vec4(2.0f * pixel / viewport.zw - 1.0f, r0.z, 1.0f);
+}
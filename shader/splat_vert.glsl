@@ -11,6 +11,11 @@
 
 /*%%DEFINES%%*/
 
+// SH_DEGREE is 0 - 3, only the coeffs for that many bands are uploaded.
+#ifndef SH_DEGREE
+#define SH_DEGREE 1
+#endif
+
 uniform mat4 viewMat;  // used to project position into view coordinates.
 uniform mat4 projMat;  // used to project view coordinates into clip coordinates.
 uniform vec4 projParams;  // x = HEIGHT / tan(FOVY / 2), y = Z_NEAR, z = Z_FAR
@@ -20,22 +25,26 @@ uniform vec3 eye;
 in vec4 position;  // center of the gaussian in object coordinates, (with alpha crammed in to w)
 
 // spherical harmonics coeff for radiance of the splat
+#if SH_DEGREE == 0
+in float r_sh0;  // zeroth-order only, i.e. a constant color
+in float g_sh0;
+in float b_sh0;
+#else
 in vec4 r_sh0;  // sh coeff for red channel (up to third-order)
-#ifdef FULL_SH
+in vec4 g_sh0;  // sh coeff for green channel
+in vec4 b_sh0;  // sh coeff for blue channel
+#endif
+#if SH_DEGREE >= 2
 in vec4 r_sh1;
 in vec4 r_sh2;
-in vec4 r_sh3;
-#endif
-in vec4 g_sh0;  // sh coeff for green channel
-#ifdef FULL_SH
 in vec4 g_sh1;
 in vec4 g_sh2;
-in vec4 g_sh3;
-#endif
-in vec4 b_sh0;  // sh coeff for blue channel
-#ifdef FULL_SH
 in vec4 b_sh1;
 in vec4 b_sh2;
+#endif
+#if SH_DEGREE >= 3
+in vec4 r_sh3;
+in vec4 g_sh3;
 in vec4 b_sh3;
 #endif
 
@@ -48,83 +57,26 @@ out vec4 geom_color;  // radiance of splat
 out vec4 geom_cov2;  // 2D screen space covariance matrix of the gaussian
 out vec2 geom_p;  // the 2D screen space center of the gaussian, (z is alpha)
 
-vec3 ComputeRadianceFromSH(const vec3 v)
-{
-#ifdef FULL_SH
-    float b[16];
+// the SH coeffs are the vertex attributes above, see sh_eval.glsl
+#if SH_DEGREE == 0
+#define SH_DC vec3(r_sh0, g_sh0, b_sh0)
 #else
-    float b[4];
+#define SH_DC vec3(r_sh0.x, g_sh0.x, b_sh0.x)
 #endif
-
-    float vx2 = v.x * v.x;
-    float vy2 = v.y * v.y;
-    float vz2 = v.z * v.z;
-
-    // zeroth order
-    // (/ 1.0 (* 2.0 (sqrt pi)))
-    b[0] = 0.28209479177387814f;
-
-    // first order
-    // (/ (sqrt 3.0) (* 2 (sqrt pi)))
-    float k1 = 0.4886025119029199f;
-    b[1] = -k1 * v.y;
-    b[2] = k1 * v.z;
-    b[3] = -k1 * v.x;
-
-#ifdef FULL_SH
-    // second order
-    // (/ (sqrt 15.0) (* 2 (sqrt pi)))
-    float k2 = 1.0925484305920792f;
-    // (/ (sqrt 5.0) (* 4 (sqrt  pi)))
-    float k3 = 0.31539156525252005f;
-    // (/ (sqrt 15.0) (* 4 (sqrt pi)))
-    float k4 = 0.5462742152960396f;
-    b[4] = k2 * v.y * v.x;
-    b[5] = -k2 * v.y * v.z;
-    b[6] = k3 * (3.0f * vz2 - 1.0f);
-    b[7] = -k2 * v.x * v.z;
-    b[8] = k4 * (vx2 - vy2);
-
-    // third order
-    // (/ (* (sqrt 2) (sqrt 35)) (* 8 (sqrt pi)))
-    float k5 = 0.5900435899266435f;
-    // (/ (sqrt 105) (* 2 (sqrt pi)))
-    float k6 = 2.8906114426405543f;
-    // (/ (* (sqrt 2) (sqrt 21)) (* 8 (sqrt pi)))
-    float k7 = 0.4570457994644658f;
-    // (/ (sqrt 7) (* 4 (sqrt pi)))
-    float k8 = 0.37317633259011546f;
-    // (/ (sqrt 105) (* 4 (sqrt pi)))
-    float k9 = 1.4453057213202771f;
-    b[9] = -k5 * v.y * (3.0f * vx2 - vy2);
-    b[10] = k6 * v.y * v.x * v.z;
-    b[11] = -k7 * v.y * (5.0f * vz2 - 1.0f);
-    b[12] = k8 * v.z * (5.0f * vz2 - 3.0f);
-    b[13] = -k7 * v.x * (5.0f * vz2 - 1.0f);
-    b[14] = k9 * v.z * (vx2 - vy2);
-    b[15] = -k5 * v.x * (vx2 - 3.0f * vy2);
-
-    float re = (b[0] * r_sh0.x + b[1] * r_sh0.y + b[2] * r_sh0.z + b[3] * r_sh0.w +
-                b[4] * r_sh1.x + b[5] * r_sh1.y + b[6] * r_sh1.z + b[7] * r_sh1.w +
-                b[8] * r_sh2.x + b[9] * r_sh2.y + b[10]* r_sh2.z + b[11]* r_sh2.w +
-                b[12]* r_sh3.x + b[13]* r_sh3.y + b[14]* r_sh3.z + b[15]* r_sh3.w);
-
-    float gr = (b[0] * g_sh0.x + b[1] * g_sh0.y + b[2] * g_sh0.z + b[3] * g_sh0.w +
-                b[4] * g_sh1.x + b[5] * g_sh1.y + b[6] * g_sh1.z + b[7] * g_sh1.w +
-                b[8] * g_sh2.x + b[9] * g_sh2.y + b[10]* g_sh2.z + b[11]* g_sh2.w +
-                b[12]* g_sh3.x + b[13]* g_sh3.y + b[14]* g_sh3.z + b[15]* g_sh3.w);
-
-    float bl = (b[0] * b_sh0.x + b[1] * b_sh0.y + b[2] * b_sh0.z + b[3] * b_sh0.w +
-                b[4] * b_sh1.x + b[5] * b_sh1.y + b[6] * b_sh1.z + b[7] * b_sh1.w +
-                b[8] * b_sh2.x + b[9] * b_sh2.y + b[10]* b_sh2.z + b[11]* b_sh2.w +
-                b[12]* b_sh3.x + b[13]* b_sh3.y + b[14]* b_sh3.z + b[15]* b_sh3.w);
-#else
-    float re = (b[0] * r_sh0.x + b[1] * r_sh0.y + b[2] * r_sh0.z + b[3] * r_sh0.w);
-    float gr = (b[0] * g_sh0.x + b[1] * g_sh0.y + b[2] * g_sh0.z + b[3] * g_sh0.w);
-    float bl = (b[0] * b_sh0.x + b[1] * b_sh0.y + b[2] * b_sh0.z + b[3] * b_sh0.w);
-#endif
-    return vec3(0.5f, 0.5f, 0.5f) + vec3(re, gr, bl);
-}
+#define SH_R0 r_sh0
+#define SH_G0 g_sh0
+#define SH_B0 b_sh0
+#define SH_R1 r_sh1
+#define SH_G1 g_sh1
+#define SH_B1 b_sh1
+#define SH_R2 r_sh2
+#define SH_G2 g_sh2
+#define SH_B2 b_sh2
+#define SH_R3 r_sh3
+#define SH_G3 g_sh3
+#define SH_B3 b_sh3
+
+/*%%SH_EVAL%%*/
 
 #ifdef FRAMEBUFFER_SRGB
 float SRGBToLinearF(float srgb)
@@ -204,7 +156,7 @@ void main(void)
 
     // compute radiance from sh
     vec3 v = normalize(position.xyz - eye);
-    geom_color = vec4(ComputeRadianceFromSH(v), alpha);
+    geom_color = vec4(ComputeRadianceFromSH(0u, v, uint(SH_DEGREE)), alpha);
 
 #ifdef FRAMEBUFFER_SRGB
     // The SIBR reference renderer uses sRGB throughout,
@@ -0,0 +1,21 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// draws the image from tile_render_compute.glsl into the viewport
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform sampler2D colorTexture;
+
+out vec4 out_color;
+
+void main(void)
+{
+    // already premultiplied
+    out_color = texelFetch(colorTexture, ivec2(gl_FragCoord.xy - viewport.xy), 0);
+}
@@ -0,0 +1,16 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// fullscreen triangle, without any vertex attributes
+//
+
+/*%%HEADER%%*/
+
+void main(void)
+{
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(2.0f * p - 1.0f, 0.0f, 1.0f);
+}
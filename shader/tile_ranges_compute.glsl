@@ -0,0 +1,54 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// second pass of the tile rasterizer, see TileRasterizer.
+// after the sort, the keys of each tile are contiguous, this finds where each tile's run starts and ends.
+//
+
+/*%%HEADER%%*/
+
+layout(local_size_x = 256) in;
+
+uniform uint numElementsPerWorkgroup;  // the same dispatch as the sort, see sort_args_compute.glsl
+uniform uint depthBits;
+
+layout(std430, binding = 0) readonly buffer KeyBuffer
+{
+    uint keys[];  // sorted
+};
+
+// begin and end of each tile's keys, zeroed before this pass, so tiles without any splats are empty.
+layout(std430, binding = 1) writeonly buffer RangeBuffer
+{
+    uvec2 ranges[];
+};
+
+// written by sort_args_compute.glsl
+layout(std430, binding = 5) readonly buffer sort_args
+{
+    uint g_num_groups_x;
+    uint g_num_groups_y;
+    uint g_num_groups_z;
+    uint g_num_elements;  // DrawElementsIndirectCommand.count
+};
+
+void main()
+{
+    uint begin = gl_WorkGroupID.x * numElementsPerWorkgroup;
+    uint end = min(begin + numElementsPerWorkgroup, g_num_elements);
+    for (uint i = begin + gl_LocalInvocationID.x; i < end; i += gl_WorkGroupSize.x)
+    {
+        uint tile = keys[i] >> depthBits;
+        if (i == 0u || (keys[i - 1u] >> depthBits) != tile)
+        {
+            ranges[tile].x = i;
+        }
+        if (i == g_num_elements - 1u || (keys[i + 1u] >> depthBits) != tile)
+        {
+            ranges[tile].y = i + 1u;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// last pass of the tile rasterizer, see TileRasterizer.
+// one workgroup per 16x16 tile, one thread per pixel. the tile's splats are loaded into shared memory 256 at a time
+// and blended front to back, until every pixel in the tile is opaque enough that nothing behind it would show.
+//
+
+/*%%HEADER%%*/
+
+#define TILE_SIZE 16
+#define BATCH_SIZE 256u  // TILE_SIZE * TILE_SIZE
+
+// once a pixel's transmittance drops below this, the splats behind it are skipped.
+#define MIN_TRANSMITTANCE 0.0001f
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+uniform uvec2 numTiles;
+uniform uvec2 outImageSize;
+
+// written by preprocess_compute.glsl
+layout(std430, binding = 0) readonly buffer RecordBuffer
+{
+    vec4 records[];
+};
+
+// splat indices, sorted by tile then depth
+layout(std430, binding = 1) readonly buffer ValBuffer
+{
+    uint vals[];
+};
+
+// written by tile_ranges_compute.glsl
+layout(std430, binding = 2) readonly buffer RangeBuffer
+{
+    uvec2 ranges[];
+};
+
+// premultiplied color and coverage
+layout(binding = 0, rgba16f) writeonly uniform image2D outImage;
+
+shared vec4 s_record0[BATCH_SIZE];
+shared vec4 s_record1[BATCH_SIZE];
+shared vec3 s_color[BATCH_SIZE];
+shared uint s_numDone;
+
+void main()
+{
+    uvec2 pixel = gl_GlobalInvocationID.xy;
+    vec2 pixelCenter = vec2(pixel) + 0.5f;
+    uvec2 range = ranges[gl_WorkGroupID.y * numTiles.x + gl_WorkGroupID.x];
+
+    bool inside = pixel.x < outImageSize.x && pixel.y < outImageSize.y;
+    bool done = !inside;
+
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        s_numDone = 0u;
+    }
+    barrier();
+    if (done)
+    {
+        atomicAdd(s_numDone, 1u);
+    }
+
+    vec3 color = vec3(0.0f);
+    float T = 1.0f;
+    for (uint batch = range.x; batch < range.y; batch += BATCH_SIZE)
+    {
+        memoryBarrierShared();
+        barrier();
+        if (s_numDone == BATCH_SIZE)
+        {
+            break;
+        }
+
+        uint i = batch + gl_LocalInvocationIndex;
+        if (i < range.y)
+        {
+            uint splat = vals[i];
+            s_record0[gl_LocalInvocationIndex] = records[splat * 3u];
+            s_record1[gl_LocalInvocationIndex] = records[splat * 3u + 1u];
+            s_color[gl_LocalInvocationIndex] = records[splat * 3u + 2u].rgb;
+        }
+        memoryBarrierShared();
+        barrier();
+
+        uint batchEnd = min(BATCH_SIZE, range.y - batch);
+        for (uint j = 0u; j < batchEnd && !done; j++)
+        {
+            vec4 r0 = s_record0[j];
+            vec4 r1 = s_record1[j];
+
+            // evaluate the gaussian, conic is the inverse of the 2D covariance
+            vec2 d = r0.xy - pixelCenter;
+            float power = -0.5f * (r1.x * d.x * d.x + r1.z * d.y * d.y) - r1.y * d.x * d.y;
+            if (power > 0.0f)
+            {
+                continue;
+            }
+            float alpha = min(0.99f, r1.w * exp(power));
+            if (alpha <= (1.0f / 256.0f))
+            {
+                continue;
+            }
+
+            float nextT = T * (1.0f - alpha);
+            if (nextT < MIN_TRANSMITTANCE)
+            {
+                done = true;
+                atomicAdd(s_numDone, 1u);
+                break;
+            }
+
+            color += s_color[j] * (alpha * T);
+            T = nextT;
+        }
+    }
+
+    if (inside)
+    {
+        imageStore(outImage, ivec2(pixel), vec4(color, 1.0f - T));
+    }
+}
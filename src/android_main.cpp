@@ -212,6 +212,7 @@ struct AppContext
         UnpackAsset("shader/point_geom.glsl");
         UnpackAsset("shader/point_vert.glsl");
         UnpackAsset("shader/presort_compute.glsl");
+        UnpackAsset("shader/sort_args_compute.glsl");
         UnpackAsset("shader/splat_frag.glsl");
         UnpackAsset("shader/splat_geom.glsl");
         UnpackAsset("shader/splat_vert.glsl");
@@ -14,13 +14,19 @@
 #include <SDL.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <random>
 #include <thread>
 
 #include "core/log.h"
 #include "core/debugrenderer.h"
 #include "core/inputbuddy.h"
 #include "core/optionparser.h"
+#include "core/parallelfor.h"
 #include "core/textrenderer.h"
 #include "core/util.h"
 #include "core/xrbuddy.h"
@@ -31,6 +37,7 @@
 #include "magiccarpet.h"
 #include "pointcloud.h"
 #include "pointrenderer.h"
+#include "splatcache.h"
 #include "splatrenderer.h"
 #include "vrconfig.h"
 
@@ -40,6 +47,26 @@ enum optionIndex
     OPENXR,
     FULLSCREEN,
     DEBUG,
+    LOAD_BENCHMARK,
+    STREAM_CHECK,
+    NO_SPLAT_CACHE,
+    EXPORT_COMPACT,
+    EXPORT_MORTON,
+    SEPARATE_ATTRIBS,
+    CPU_SORT,
+    INCREMENTAL_SORT,
+    ASYNC_SORT,
+    SORT_KEY_BITS,
+    MEASURE_SORT_ERROR,
+    ONESWEEP_SORT,
+    TUNE_SORT,
+    TILE_RENDER,
+    GEOMETRY_SHADER,
+    SH_CACHE,
+    SH_CACHE_PHASES,
+    SH_LOD,
+    MEASURE_SH_LOD,
+    NO_CHUNK_CULL,
     HELP
 };
 
@@ -50,6 +77,26 @@ const option::Descriptor usage[] =
     { OPENXR, 0, "v", "openxr", option::Arg::None,        "  -v, --openxr      Launch app in vr mode, using openxr runtime." },
     { FULLSCREEN, 0, "f", "fullscren", option::Arg::None, "  -f, --fullscreen  Launch window in fullscreen." },
     { DEBUG, 0, "d", "debug", option::Arg::None,          "  -d, --debug       Enable verbose debug logging." },
+    { LOAD_BENCHMARK, 0, "", "load-benchmark", option::Arg::None, "  --load-benchmark  Compare single and multi-threaded ply load times." },
+    { STREAM_CHECK, 0, "", "stream-check", option::Arg::Optional, "  --stream-check=MB  Stream a generated ply 4x larger than MB (default 1) back in chunks and check every splat." },
+    { NO_SPLAT_CACHE, 0, "", "no-splat-cache", option::Arg::None, "  --no-splat-cache  Always load from the ply, don't read or write FILE.splatcache." },
+    { EXPORT_COMPACT, 0, "", "export-compact", option::Arg::None, "  --export-compact  Write FILE.splatc, a quantized copy of the input, and print the round trip error." },
+    { EXPORT_MORTON, 0, "", "export-morton", option::Arg::None, "  --export-morton  Write FILE.morton.ply, a copy of the input with the splats in morton order." },
+    { SEPARATE_ATTRIBS, 0, "", "separate-attribs", option::Arg::None, "  --separate-attribs  Upload each splat attribute as its own vertex buffer, instead of one interleaved buffer." },
+    { CPU_SORT, 0, "", "cpu-sort", option::Arg::None, "  --cpu-sort  Sort splats on the cpu, instead of with compute shaders." },
+    { INCREMENTAL_SORT, 0, "", "incremental-sort", option::Arg::None, "  --incremental-sort  Sort on the cpu, reusing the previous frame's order when the view has barely changed." },
+    { ASYNC_SORT, 0, "", "async-sort", option::Arg::None, "  --async-sort  Sort on a cpu worker thread, and draw with the latest finished order." },
+    { SORT_KEY_BITS, 0, "", "sort-key-bits", option::Arg::Optional, "  --sort-key-bits=N  Use N bit (16, 24 or 32) sort keys, instead of picking the size every frame." },
+    { MEASURE_SORT_ERROR, 0, "", "measure-sort-error", option::Arg::None, "  --measure-sort-error  Check the sorted order against the exact splat depths every frame. Slow." },
+    { ONESWEEP_SORT, 0, "", "onesweep-sort", option::Arg::None, "  --onesweep-sort  Always use the onesweep gpu sort, even if it fails its startup check." },
+    { TUNE_SORT, 0, "", "tune-sort", option::Arg::None, "  --tune-sort  Time the gpu sorts again and update the choice saved in sortprofile.json." },
+    { TILE_RENDER, 0, "", "tile-render", option::Arg::None, "  --tile-render  Render splats with compute shaders, one 16x16 pixel tile at a time, instead of as quads." },
+    { GEOMETRY_SHADER, 0, "", "geometry-shader", option::Arg::None, "  --geometry-shader  Expand splats into quads with a geometry shader, instead of drawing instanced quads." },
+    { SH_CACHE, 0, "", "sh-cache", option::Arg::Optional, "  --sh-cache=DEGREES  Cache the sh color of each splat until the view of it turns by DEGREES (default 0.5)." },
+    { SH_CACHE_PHASES, 0, "", "sh-cache-phases", option::Arg::Optional, "  --sh-cache-phases=N  With --sh-cache, check 1/N of the cached colors each frame." },
+    { SH_LOD, 0, "", "sh-lod", option::Arg::None, "  --sh-lod  Evaluate the sh of small and distant splats only up to a lower degree." },
+    { MEASURE_SH_LOD, 0, "", "measure-sh-lod", option::Arg::None, "  --measure-sh-lod  With --sh-lod, count the splats drawn at each degree and compare them with the full sh." },
+    { NO_CHUNK_CULL, 0, "", "no-chunk-cull", option::Arg::None, "  --no-chunk-cull  Pre-sort every splat, instead of only the chunks of splats inside the view." },
     { UNKNOWN, 0, "", "", option::Arg::None,              "\nExamples:\n  splataplut data/test.ply\n  splatapult -v data/test.ply" },
     { 0, 0, 0, 0, 0, 0}
 };
@@ -243,18 +290,342 @@ static std::shared_ptr<PointCloud> LoadPointCloud(std::vector<std::string>& plyF
 
 //     return gaussianCloud;
 // }
-static std::shared_ptr<GaussianCloud> LoadGaussianCloud(std::vector<std::string>& plyFilenames)
+static bool IsCompactFile(const std::string& filename)
+{
+    const std::string EXT = ".splatc";
+    return filename.size() >= EXT.size() && filename.compare(filename.size() - EXT.size(), EXT.size(), EXT) == 0;
+}
+
+static std::string ReplaceExtension(const std::string& filename, const std::string& ext)
+{
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return filename + ext;
+    }
+    return filename.substr(0, dot) + ext;
+}
+
+// sh bands above maxSHDegree are never read from the files, the cloud is returned in structure of arrays form.
+static std::shared_ptr<GaussianCloud> LoadGaussianCloud(std::vector<std::string>& plyFilenames, uint32_t maxSHDegree)
 {
     auto gaussianCloud = std::make_shared<GaussianCloud>();
+    GaussianCloud::ImportOptions importOptions;
+    importOptions.maxSHDegree = maxSHDegree;
 
-    if (!gaussianCloud->ImportPly(plyFilenames))
+    // plys are loaded concurrently, but if compact files are mixed in, load one at a time to preserve the order.
+    bool anyCompact = std::any_of(plyFilenames.begin(), plyFilenames.end(), IsCompactFile);
+    if (!anyCompact)
     {
-        Log::E("Error loading GaussianCloud!\n");
-        return nullptr;
+        importOptions.structureOfArrays = true;
+        if (!gaussianCloud->ImportPly(plyFilenames, importOptions))
+        {
+            Log::E("Error loading GaussianCloud!\n");
+            return nullptr;
+        }
+        return gaussianCloud;
+    }
+
+    for (auto&& filename : plyFilenames)
+    {
+        bool ok = IsCompactFile(filename) ? gaussianCloud->ImportCompact(filename) :
+            gaussianCloud->ImportPly({filename}, importOptions);
+        if (!ok)
+        {
+            Log::E("Error loading GaussianCloud \"%s\"!\n", filename.c_str());
+            return nullptr;
+        }
     }
 
+    // compact files always carry all bands, so trim them here.
+    gaussianCloud->ConvertToSoA(maxSHDegree);
     return gaussianCloud;
 }
+
+// writes a compact copy of the input next to the first file, then reads it back and prints the error.
+static void ExportCompactGaussianCloud(std::vector<std::string>& plyFilenames)
+{
+    // the compact format always stores all sh bands
+    const uint32_t MAX_SH_DEGREE = 3;
+    auto gaussianCloud = LoadGaussianCloud(plyFilenames, MAX_SH_DEGREE);
+    if (!gaussianCloud)
+    {
+        return;
+    }
+
+    std::string compactFilename = ReplaceExtension(plyFilenames[0], ".splatc");
+    if (!gaussianCloud->ExportCompact(compactFilename))
+    {
+        Log::E("Error writing \"%s\"\n", compactFilename.c_str());
+        return;
+    }
+
+    GaussianCloud roundTrip;
+    GaussianCloud::ErrorReport report;
+    if (!roundTrip.ImportCompact(compactFilename) || !GaussianCloud::ComputeError(*gaussianCloud, roundTrip, report))
+    {
+        Log::E("Error reading back \"%s\"\n", compactFilename.c_str());
+        return;
+    }
+
+    fprintf(stdout, "export-compact: wrote %zu splats to \"%s\"\n", gaussianCloud->size(), compactFilename.c_str());
+    GaussianCloud::PrintErrorReport(report);
+}
+
+static void ExportMortonGaussianCloud(std::vector<std::string>& plyFilenames)
+{
+    // keep all sh bands, like the input
+    const uint32_t MAX_SH_DEGREE = 3;
+    auto gaussianCloud = LoadGaussianCloud(plyFilenames, MAX_SH_DEGREE);
+    if (!gaussianCloud)
+    {
+        return;
+    }
+
+    gaussianCloud->SortByMortonOrder();
+    std::string mortonFilename = ReplaceExtension(plyFilenames[0], ".morton.ply");
+    if (!gaussianCloud->ExportPly(mortonFilename))
+    {
+        Log::E("Error writing \"%s\"\n", mortonFilename.c_str());
+        return;
+    }
+
+    fprintf(stdout, "export-morton: wrote %zu splats to \"%s\"\n", gaussianCloud->size(), mortonFilename.c_str());
+}
+
+// uses the .splatcache next to the ply if it's up to date, otherwise converts the gaussianCloud and writes a new cache.
+// caches are only used for a single input file.
+static std::shared_ptr<SplatCache> LoadSplatCache(std::vector<std::string>& plyFilenames, bool useSplatCache, uint32_t maxSHDegree,
+                                                  std::shared_ptr<GaussianCloud>& gaussianCloudOut)
+{
+    useSplatCache = useSplatCache && plyFilenames.size() == 1;
+    std::string cacheFilename = useSplatCache ? SplatCache::GetCacheFilename(plyFilenames[0]) : "";
+
+    auto splatCache = std::make_shared<SplatCache>();
+    if (useSplatCache && splatCache->Load(cacheFilename, plyFilenames[0], maxSHDegree))
+    {
+        Log::I("Loaded \"%s\"\n", cacheFilename.c_str());
+        return splatCache;
+    }
+
+    gaussianCloudOut = LoadGaussianCloud(plyFilenames, maxSHDegree);
+    if (!gaussianCloudOut)
+    {
+        return nullptr;
+    }
+
+    // the splat renderer culls runs of consecutive splats, which only works if they're near each other,
+    // and neighbours on screen then read neighbouring memory. the cache keeps this order, see --export-morton for plys.
+    gaussianCloudOut->SortByMortonOrder();
+    splatCache->Build(*gaussianCloudOut);
+    if (useSplatCache && splatCache->Save(cacheFilename, plyFilenames[0], maxSHDegree))
+    {
+        Log::I("Wrote \"%s\"\n", cacheFilename.c_str());
+    }
+
+    return splatCache;
+}
+
+// loads the gaussian cloud with a single decode thread and then again with all threads,
+// prints the times and verifies that both paths produce identical data.
+static void BenchmarkLoadGaussianCloud(std::vector<std::string>& plyFilenames)
+{
+    std::vector<std::shared_ptr<GaussianCloud>> clouds;
+    std::vector<double> times;
+    const uint32_t numThreadsVec[] = {1, 0};
+    for (auto&& numThreads : numThreadsVec)
+    {
+        GaussianCloud::ImportOptions importOptions;
+        importOptions.numThreads = numThreads;
+        auto gaussianCloud = std::make_shared<GaussianCloud>();
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!gaussianCloud->ImportPly(plyFilenames, importOptions))
+        {
+            Log::E("Error loading GaussianCloud!\n");
+            return;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        clouds.push_back(gaussianCloud);
+        times.push_back(elapsed.count());
+    }
+
+    const size_t numBytes = clouds[0]->size() * sizeof(GaussianCloud::Gaussian);
+    bool identical = clouds[0]->size() == clouds[1]->size() &&
+        memcmp(clouds[0]->GetGaussianVec().data(), clouds[1]->GetGaussianVec().data(), numBytes) == 0;
+
+    fprintf(stdout, "load-benchmark: %zu splats\n", clouds[0]->size());
+    fprintf(stdout, "    1 thread:   %.3f sec\n", times[0]);
+    fprintf(stdout, "    %u threads: %.3f sec (%.2fx)\n", GetDefaultNumThreads(), times[1], times[0] / times[1]);
+    fprintf(stdout, "    output is %s\n", identical ? "identical" : "DIFFERENT");
+}
+
+// writes a ply of random splats that is 4x larger than maxMemory to the temp directory, reads it back with
+// GaussianCloud::StreamPly() and checks that no chunk needed more than maxMemory and that every splat is unchanged.
+// writes the splats with the same properties as ExportPly, but in reverse order and with two extra
+// properties the importer ignores, a double and a uchar. so the vertices are neither float only nor aligned,
+// and StreamPly and ImportPly have to take the generic decode path.
+static bool WriteReorderedPly(const std::string& plyFilename, const std::vector<GaussianCloud::Gaussian>& gaussianVec)
+{
+    std::vector<std::string> names = {"x", "y", "z", "nx", "ny", "nz"};
+    for (int i = 0; i < 3; i++)
+    {
+        names.push_back("f_dc_" + std::to_string(i));
+    }
+    for (int i = 0; i < 45; i++)
+    {
+        names.push_back("f_rest_" + std::to_string(i));
+    }
+    names.push_back("opacity");
+    for (int i = 0; i < 3; i++)
+    {
+        names.push_back("scale_" + std::to_string(i));
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        names.push_back("rot_" + std::to_string(i));
+    }
+
+    // the float at names[i] is floats[i] of a Gaussian, -1 and -2 are the extra double and uchar.
+    std::vector<int> layout = {-1};
+    for (int i = (int)names.size() - 1; i >= 0; i--)
+    {
+        layout.push_back(i);
+        if (i == (int)names.size() / 2)
+        {
+            layout.push_back(-2);
+        }
+    }
+
+    std::ofstream plyFile(plyFilename, std::ios::binary);
+    if (!plyFile.is_open())
+    {
+        return false;
+    }
+    plyFile << "ply\nformat binary_little_endian 1.0\nelement vertex " << gaussianVec.size() << "\n";
+    for (auto&& i : layout)
+    {
+        if (i == -1)
+        {
+            plyFile << "property double timestamp\n";
+        }
+        else if (i == -2)
+        {
+            plyFile << "property uchar label\n";
+        }
+        else
+        {
+            plyFile << "property float " << names[i] << "\n";
+        }
+    }
+    plyFile << "end_header\n";
+
+    std::vector<uint8_t> vertex;
+    for (size_t j = 0; j < gaussianVec.size(); j++)
+    {
+        const float* floats = reinterpret_cast<const float*>(&gaussianVec[j]);
+        vertex.clear();
+        for (auto&& i : layout)
+        {
+            const double timestamp = (double)j;
+            const uint8_t label = (uint8_t)j;
+            const uint8_t* bytes = (i == -1) ? reinterpret_cast<const uint8_t*>(&timestamp) :
+                                   (i == -2) ? &label : reinterpret_cast<const uint8_t*>(floats + i);
+            const size_t size = (i == -1) ? sizeof(double) : (i == -2) ? sizeof(uint8_t) : sizeof(float);
+            vertex.insert(vertex.end(), bytes, bytes + size);
+        }
+        plyFile.write(reinterpret_cast<const char*>(vertex.data()), vertex.size());
+    }
+    return plyFile.good();
+}
+
+// streams plyFilename and compares every chunk against ImportPly of the same file, which must match sourceVec.
+static bool CheckStreamPlyFile(const std::string& plyFilename, const char* layoutName, size_t maxMemory,
+                               const std::vector<GaussianCloud::Gaussian>& sourceVec)
+{
+    const size_t numSplats = sourceVec.size();
+    const size_t recordBytes = numSplats * sizeof(GaussianCloud::Gaussian);
+
+    GaussianCloud importedCloud;
+    bool importOk = importedCloud.ImportPly({plyFilename});
+    const std::vector<GaussianCloud::Gaussian>& importedVec = importedCloud.GetGaussianVec();
+    bool importIdentical = importOk && importedVec.size() == numSplats &&
+        memcmp(importedVec.data(), sourceVec.data(), recordBytes) == 0;
+
+    GaussianCloud::StreamOptions streamOptions;
+    streamOptions.maxMemory = maxMemory;
+    GaussianCloud::StreamStats streamStats;
+    size_t numStreamed = 0;
+    bool streamIdentical = importIdentical;
+    auto start = std::chrono::high_resolution_clock::now();
+    bool streamOk = GaussianCloud::StreamPly(plyFilename, streamOptions,
+        [&](const GaussianCloud::Gaussian* chunk, size_t firstIndex, size_t count)
+        {
+            streamIdentical = streamIdentical && firstIndex == numStreamed && firstIndex + count <= numSplats &&
+                memcmp(chunk, importedVec.data() + firstIndex, count * sizeof(GaussianCloud::Gaussian)) == 0;
+            numStreamed += count;
+            return true;
+        }, &streamStats);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    bool withinLimit = streamStats.peakBufferBytes <= maxMemory;
+    bool passed = streamOk && streamIdentical && numStreamed == numSplats && withinLimit;
+    fprintf(stdout, "stream-check %s layout: %zu splats in %zu chunks, %.3f sec\n",
+            layoutName, numSplats, streamStats.numChunks, elapsed.count());
+    fprintf(stdout, "    peak buffer capacity %zu bytes, limit %zu bytes%s\n",
+            streamStats.peakBufferBytes, maxMemory, withinLimit ? "" : ", EXCEEDED");
+    fprintf(stdout, "    ImportPly %s the generated splats\n", importIdentical ? "matches" : "DOES NOT MATCH");
+    fprintf(stdout, "    %zu splats streamed, %s ImportPly\n", numStreamed, streamIdentical ? "identical to" : "DIFFERENT from");
+    fprintf(stdout, "    %s\n", passed ? "passed" : "FAILED");
+    return passed;
+}
+
+// returns false if any check failed, so the process exits with an error.
+static bool CheckStreamPly(size_t maxMemory)
+{
+    // a partial chunk at the end as well
+    const size_t numSplats = 4 * maxMemory / sizeof(GaussianCloud::Gaussian) + 123;
+
+    GaussianCloud gaussianCloud;
+    std::vector<GaussianCloud::Gaussian>& gaussianVec = gaussianCloud.GetGaussianVec();
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+    gaussianVec.resize(numSplats);
+    for (auto&& g : gaussianVec)
+    {
+        float* floats = reinterpret_cast<float*>(&g);
+        for (size_t i = 0; i < sizeof(GaussianCloud::Gaussian) / sizeof(float); i++)
+        {
+            floats[i] = dist(rng);
+        }
+
+        // the generic decoder doesn't read normals, it leaves them zero
+        g.normal[0] = g.normal[1] = g.normal[2] = 0.0f;
+    }
+
+    const std::filesystem::path tempDir = std::filesystem::temp_directory_path();
+    std::string canonicalFilename = (tempDir / "splatapult_stream_check.ply").string();
+    std::string reorderedFilename = (tempDir / "splatapult_stream_check_reordered.ply").string();
+    if (!gaussianCloud.ExportPly(canonicalFilename))
+    {
+        Log::E("Error writing \"%s\"\n", canonicalFilename.c_str());
+        return false;
+    }
+    if (!WriteReorderedPly(reorderedFilename, gaussianVec))
+    {
+        Log::E("Error writing \"%s\"\n", reorderedFilename.c_str());
+        std::filesystem::remove(canonicalFilename);
+        return false;
+    }
+
+    bool passed = CheckStreamPlyFile(canonicalFilename, "canonical", maxMemory, gaussianVec);
+    passed = CheckStreamPlyFile(reorderedFilename, "reordered", maxMemory, gaussianVec) && passed;
+
+    std::filesystem::remove(canonicalFilename);
+    std::filesystem::remove(reorderedFilename);
+    return passed;
+}
+
 static void PrintControls()
 {
     fprintf(stdout, "\
@@ -340,6 +711,134 @@ App::ParseResult App::ParseArguments(int argc, const char* argv[])
         opt.debugLogging = true;
     }
 
+    if (options[LOAD_BENCHMARK])
+    {
+        opt.loadBenchmark = true;
+    }
+
+    if (options[STREAM_CHECK])
+    {
+        opt.streamCheck = true;
+        if (options[STREAM_CHECK].arg)
+        {
+            opt.streamCheckMemory = (float)atof(options[STREAM_CHECK].arg);
+        }
+        if (opt.streamCheckMemory <= 0.0f)
+        {
+            std::cout << "--stream-check memory must be positive\n";
+            return ERROR_RESULT;
+        }
+    }
+
+    if (options[NO_SPLAT_CACHE])
+    {
+        opt.useSplatCache = false;
+    }
+
+    if (options[EXPORT_COMPACT])
+    {
+        opt.exportCompact = true;
+    }
+
+    if (options[EXPORT_MORTON])
+    {
+        opt.exportMorton = true;
+    }
+
+    if (options[SEPARATE_ATTRIBS])
+    {
+        opt.interleaveAttribs = false;
+    }
+
+    if (options[CPU_SORT])
+    {
+        opt.cpuSort = true;
+    }
+
+    if (options[INCREMENTAL_SORT])
+    {
+        opt.cpuSort = true;
+        opt.incrementalSort = true;
+    }
+
+    if (options[ASYNC_SORT])
+    {
+        opt.cpuSort = true;
+        opt.asyncSort = true;
+    }
+
+    if (options[SORT_KEY_BITS])
+    {
+        uint32_t bits = options[SORT_KEY_BITS].arg ? (uint32_t)atoi(options[SORT_KEY_BITS].arg) : 0;
+        if (bits != 16 && bits != 24 && bits != 32)
+        {
+            std::cout << "--sort-key-bits must be 16, 24 or 32\n";
+            return ERROR_RESULT;
+        }
+        opt.sortKeyBits = bits;
+    }
+
+    if (options[MEASURE_SORT_ERROR])
+    {
+        opt.measureSortError = true;
+    }
+
+    if (options[ONESWEEP_SORT])
+    {
+        opt.onesweepSort = true;
+    }
+
+    if (options[TUNE_SORT])
+    {
+        opt.tuneSort = true;
+    }
+
+    if (options[TILE_RENDER])
+    {
+        opt.tileRender = true;
+    }
+
+    if (options[GEOMETRY_SHADER])
+    {
+        opt.geometryShader = true;
+    }
+
+    if (options[SH_CACHE])
+    {
+        opt.shCache = true;
+        if (options[SH_CACHE].arg)
+        {
+            opt.shCacheTolerance = (float)atof(options[SH_CACHE].arg);
+        }
+    }
+
+    if (options[SH_CACHE_PHASES])
+    {
+        int phases = options[SH_CACHE_PHASES].arg ? atoi(options[SH_CACHE_PHASES].arg) : 0;
+        if (phases < 1)
+        {
+            std::cout << "--sh-cache-phases must be at least 1\n";
+            return ERROR_RESULT;
+        }
+        opt.shCachePhases = (uint32_t)phases;
+    }
+
+    if (options[SH_LOD])
+    {
+        opt.shLod = true;
+    }
+
+    if (options[MEASURE_SH_LOD])
+    {
+        opt.shLod = true;
+        opt.measureSHLod = true;
+    }
+
+    if (options[NO_CHUNK_CULL])
+    {
+        opt.chunkCull = false;
+    }
+
     bool unknownOptionFound = false;
     for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next())
     {
@@ -358,15 +857,10 @@ App::ParseResult App::ParseArguments(int argc, const char* argv[])
     }
     else
     {
-        //plyFilename = parse.nonOption(0);
-        // for (int i = 0; i < parse.nonOptionsCount(); ++i)
-        // {
-        //     plyFilenames.push_back(parse.nonOption(i));
-        // }
-        for(int i =0 ;i<argc;i++)
+        // only non-option arguments are ply files, options such as --load-benchmark are not.
+        for (int i = 0; i < parse.nonOptionsCount(); ++i)
         {
-            std::cout<<argv[i] << std::endl;
-            plyFilenames.push_back(argv[i]);
+            plyFilenames.push_back(parse.nonOption(i));
         }
     }
 
@@ -577,8 +1071,42 @@ bool App::Init()
         Log::D("Could not find input.ply\n");
     }
 
-    gaussianCloud = LoadGaussianCloud(plyFilenames);
-    if (!gaussianCloud)
+    if (opt.loadBenchmark)
+    {
+        BenchmarkLoadGaussianCloud(plyFilenames);
+    }
+
+    if (opt.streamCheck)
+    {
+        if (!CheckStreamPly((size_t)(opt.streamCheckMemory * 1024.0f * 1024.0f)))
+        {
+            Log::E("stream-check failed\n");
+            return false;
+        }
+    }
+
+    if (opt.exportCompact)
+    {
+        ExportCompactGaussianCloud(plyFilenames);
+    }
+
+    if (opt.exportMorton)
+    {
+        ExportMortonGaussianCloud(plyFilenames);
+    }
+
+#if __ANDROID__
+    bool useFullSH = false;
+    bool useRgcSortOverride = true;
+#else
+    bool useFullSH = true;
+    bool useRgcSortOverride = false;
+#endif
+
+    // NOTE: gaussianCloud is null when the splat cache was up to date.
+    uint32_t maxSHDegree = useFullSH ? 3 : 1;
+    auto splatCache = LoadSplatCache(plyFilenames, opt.useSplatCache, maxSHDegree, gaussianCloud);
+    if (!splatCache)
     {
         Log::E("Error loading GaussianCloud\n");
         return false;
@@ -592,14 +1120,41 @@ bool App::Init()
 #endif
 
     splatRenderer = std::make_shared<SplatRenderer>();
-#if __ANDROID__
-    bool useFullSH = false;
-    bool useRgcSortOverride = true;
-#else
-    bool useFullSH = true;
-    bool useRgcSortOverride = false;
-#endif
-    if (!splatRenderer->Init(gaussianCloud, isFramebufferSRGBEnabled, useFullSH, useRgcSortOverride))
+    splatRenderer->useInterleavedAttribs = opt.interleaveAttribs;
+    splatRenderer->sortKeyBits = opt.sortKeyBits;
+    splatRenderer->measureSortError = opt.measureSortError;
+    splatRenderer->sortProfileFilename = "sortprofile.json";
+    splatRenderer->retuneSort = opt.tuneSort;
+    if (opt.vrMode)
+    {
+        // both eyes are drawn with the sort of the first one, keep the splats just outside of it.
+        splatRenderer->cullPadding = 0.25f;
+    }
+    splatRenderer->useSHColorCache = opt.shCache;
+    splatRenderer->shColorTolerance = glm::radians(opt.shCacheTolerance);
+    splatRenderer->shColorPhases = opt.shCachePhases;
+    splatRenderer->useSHLod = opt.shLod;
+    splatRenderer->measureSHLod = opt.measureSHLod;
+    splatRenderer->useChunkCulling = opt.chunkCull;
+    if (opt.tileRender)
+    {
+        splatRenderer->renderMethod = SplatRenderer::RenderMethod::Tile;
+    }
+    else if (opt.geometryShader)
+    {
+        splatRenderer->renderMethod = SplatRenderer::RenderMethod::GeometryShader;
+    }
+    if (opt.onesweepSort)
+    {
+        splatRenderer->sortMethod = SplatRenderer::SortMethod::Onesweep;
+    }
+    if (opt.cpuSort)
+    {
+        splatRenderer->sortMethod = SplatRenderer::SortMethod::Cpu;
+        splatRenderer->useIncrementalSort = opt.incrementalSort;
+        splatRenderer->useAsyncSort = opt.asyncSort;
+    }
+    if (!splatRenderer->Init(splatCache, isFramebufferSRGBEnabled, useFullSH, useRgcSortOverride))
     {
         Log::E("Error initializing splat renderer!\n");
         return false;
@@ -838,38 +1393,50 @@ void App::UpdateFps(float fps)
     textRenderer->RemoveText(fpsText);
     fpsText = textRenderer->AddScreenTextWithDropShadow(glm::ivec2(0, 0), TEXT_NUM_ROWS, WHITE, BLACK, text);
 
-//#define FIND_BEST_NUM_BLOCKS_PER_WORKGROUP
-#ifdef FIND_BEST_NUM_BLOCKS_PER_WORKGROUP
-    Log::E("%s\n", text.c_str());
-    fpsVec.push_back(fps);
-    const uint32_t STEP_SIZE = 64;
-    if (fpsVec.size() == 2)
+    // counts since the last fps update
+    if (splatRenderer && (opt.cpuSort || opt.measureSortError || opt.tileRender || opt.shCache || opt.measureSHLod ||
+                          splatRenderer->useChunkCulling))
     {
-        float dFps = fpsVec[1] - fpsVec[0];
-
-        uint32_t x = splatRenderer->numBlocksPerWorkgroup - STEP_SIZE;
-        Log::E("    (%.3f -> %.3f) dFps = %.3f, x = %u\n", fpsVec[0], fpsVec[1], dFps, x);
-        if (dFps < 0)
+        SplatRenderer::SortStats stats = splatRenderer->GetSortStats();
+        if (opt.measureSortError)
         {
-            Log::E("    FPS DOWN, new x = %u\n", x - STEP_SIZE);
-            if (splatRenderer->numBlocksPerWorkgroup > STEP_SIZE)
-            {
-                splatRenderer->numBlocksPerWorkgroup = x - STEP_SIZE;
-            }
+            Log::D("sort error: %u bit keys, %.5f of neighbors out of order, by up to %.5f\n",
+                   stats.lastKeyBits, stats.orderingError.fraction, stats.orderingError.maxInversion);
         }
-        else
+        if (opt.incrementalSort)
         {
-            Log::E("    FPS UP, new x = %u\n", x + STEP_SIZE);
-            splatRenderer->numBlocksPerWorkgroup = x + STEP_SIZE;
+            Log::D("incremental sort: %llu repaired, %llu full, last disorder %.4f\n",
+                   (unsigned long long)stats.incrementalStats.numIncremental,
+                   (unsigned long long)stats.incrementalStats.numFull, stats.incrementalStats.lastDisorder);
         }
-
-        fpsVec.clear();
-    }
-    else
-    {
-        splatRenderer->numBlocksPerWorkgroup = splatRenderer->numBlocksPerWorkgroup + STEP_SIZE;
+        if (opt.asyncSort)
+        {
+            Log::D("async sort: %llu sorts, %llu stale frames, %llu waits\n",
+                   (unsigned long long)stats.numSorts, (unsigned long long)stats.numStaleFrames,
+                   (unsigned long long)stats.numWaits);
+        }
+        if (opt.tileRender)
+        {
+            Log::D("tile render: %.2f ms per frame, %u tile instances\n", 1000.0f / fps, stats.numTileInstances);
+        }
+        if (opt.shCache)
+        {
+            Log::D("sh color cache: %.4f of the colors evaluated again per frame\n", stats.shRecomputeFraction);
+        }
+        if (splatRenderer->useChunkCulling)
+        {
+            Log::D("chunk culling: %.3f of the chunks pre-sorted\n", stats.visibleChunkFraction);
+        }
+        if (opt.measureSHLod)
+        {
+            Log::D("sh lod: %.3f dc, %.3f degree 1, %.3f degree 2, %.3f degree 3, %.1f of %.1f sh bytes read per splat\n",
+                   stats.shLodFractions[0], stats.shLodFractions[1], stats.shLodFractions[2], stats.shLodFractions[3],
+                   stats.shLodBytes, stats.shFullBytes);
+            Log::D("sh lod: %.4f of the colors off by more than 1/255, by up to %.4f\n",
+                   stats.shLodChangedFraction, stats.shLodMaxError);
+        }
+        splatRenderer->ResetSortStats();
     }
-#endif
 }
 
 bool App::Process(float dt)
@@ -61,6 +61,28 @@ protected:
         bool drawDebug = true;
         bool debugLogging = false;
         bool drawFps = true;
+        bool loadBenchmark = false;
+        bool streamCheck = false;
+        float streamCheckMemory = 1.0f;  // MB
+        bool useSplatCache = true;
+        bool exportCompact = false;
+        bool exportMorton = false;
+        bool interleaveAttribs = true;
+        bool cpuSort = false;
+        bool incrementalSort = false;
+        bool asyncSort = false;
+        uint32_t sortKeyBits = 0;  // 0 = pick every frame
+        bool measureSortError = false;
+        bool onesweepSort = false;
+        bool tuneSort = false;
+        bool tileRender = false;
+        bool geometryShader = false;
+        bool shCache = false;
+        float shCacheTolerance = 0.5f;  // degrees
+        uint32_t shCachePhases = 1;
+        bool shLod = false;
+        bool measureSHLod = false;
+        bool chunkCull = true;
     };
 
     MainContext mainContext;
@@ -96,6 +118,4 @@ protected:
 
     VoidCallback quitCallback;
     ResizeCallback resizeCallback;
-
-    std::vector<float> fpsVec;
 };
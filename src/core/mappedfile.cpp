@@ -0,0 +1,163 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+
+MappedFile::MappedFile() : data(nullptr), size(0)
+{
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        Log::E("MappedFile: failed to open \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Log::E("MappedFile: could not get size of \"%s\"\n", filename.c_str());
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        Log::E("MappedFile: CreateFileMapping failed for \"%s\"\n", filename.c_str());
+        CloseHandle(file);
+        return false;
+    }
+
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr)
+    {
+        Log::E("MappedFile: MapViewOfFile failed for \"%s\"\n", filename.c_str());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = (const uint8_t*)ptr;
+    size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+    {
+        UnmapViewOfFile((void*)data);
+        data = nullptr;
+        size = 0;
+    }
+    if (mappingHandle)
+    {
+        CloseHandle((HANDLE)mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle((HANDLE)fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+}
+
+void MappedFile::AdviseSequential(size_t offset, size_t sizeIn) const
+{
+    // FILE_FLAG_SEQUENTIAL_SCAN was passed to CreateFile, which is the closest equivalent.
+}
+#else
+bool MappedFile::Open(const std::string& filename)
+{
+    Close();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        Log::E("MappedFile: failed to open \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        Log::E("MappedFile: could not get size of \"%s\"\n", filename.c_str());
+        close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file.
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        Log::E("MappedFile: mmap failed for \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    data = (const uint8_t*)ptr;
+    size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+    {
+        munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+void MappedFile::AdviseSequential(size_t offset, size_t sizeIn) const
+{
+    if (!data)
+    {
+        return;
+    }
+
+    // madvise requires a page aligned address
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset & ~(pageSize - 1);
+    size_t alignedSize = sizeIn + (offset - alignedOffset);
+    madvise((void*)(data + alignedOffset), alignedSize, MADV_SEQUENTIAL);
+    madvise((void*)(data + alignedOffset), alignedSize, MADV_WILLNEED);
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// read-only memory mapping of an entire file.
+class MappedFile
+{
+public:
+    MappedFile();
+    MappedFile(const MappedFile& orig) = delete;
+    ~MappedFile();
+
+    // returns true on success, false on failure
+    bool Open(const std::string& filename);
+    void Close();
+
+    // hint to the os that the range [offset, offset + size) will be read front to back.
+    // this is a no-op on platforms without madvise.
+    void AdviseSequential(size_t offset, size_t size) const;
+
+    const uint8_t* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+    bool IsOpen() const { return data != nullptr; }
+
+protected:
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
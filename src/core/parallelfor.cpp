@@ -0,0 +1,169 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "parallelfor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one ParallelFor call. ranges are claimed with nextRange, by the pool workers and the calling thread.
+struct ParallelForJob
+{
+    ParallelForJob(const RangeCallback& cbIn, size_t count, size_t numRangesIn) :
+        cb(cbIn), rangeSize(count / numRangesIn), remainder(count % numRangesIn), numRanges(numRangesIn), nextRange(0), numDone(0) {}
+
+    // distribute the remainder over the first few ranges, so range sizes differ by at most one.
+    size_t RangeBegin(size_t i) const { return i * rangeSize + std::min(i, remainder); }
+
+    // runs ranges until none are left to claim
+    void Run()
+    {
+        size_t i;
+        while ((i = nextRange.fetch_add(1)) < numRanges)
+        {
+            cb(RangeBegin(i), RangeBegin(i + 1));
+            if (numDone.fetch_add(1) + 1 == numRanges)
+            {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                doneCv.notify_all();
+            }
+        }
+    }
+
+    bool IsClaimed() const { return nextRange.load() >= numRanges; }
+
+    const RangeCallback& cb;
+    const size_t rangeSize;
+    const size_t remainder;
+    const size_t numRanges;
+    std::atomic<size_t> nextRange;
+    std::atomic<size_t> numDone;
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+};
+
+// worker threads are started once, the first time ParallelFor needs them, and live until exit.
+class ParallelForPool
+{
+public:
+    ParallelForPool() : stop(false)
+    {
+        // the calling thread always runs ranges too
+        const uint32_t numWorkers = GetDefaultNumThreads() - 1;
+        workerVec.reserve(numWorkers);
+        for (uint32_t i = 0; i < numWorkers; i++)
+        {
+            workerVec.emplace_back(&ParallelForPool::WorkerMain, this);
+        }
+    }
+
+    ~ParallelForPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto&& worker : workerVec)
+        {
+            worker.join();
+        }
+    }
+
+    // the calling thread claims ranges alongside the workers, so nested calls from a worker can't deadlock.
+    void Run(const std::shared_ptr<ParallelForJob>& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobQueue.push_back(job);
+        }
+        cv.notify_all();
+
+        job->Run();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto iter = std::find(jobQueue.begin(), jobQueue.end(), job);
+            if (iter != jobQueue.end())
+            {
+                jobQueue.erase(iter);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(job->doneMutex);
+        job->doneCv.wait(lock, [&job]() { return job->numDone.load() == job->numRanges; });
+    }
+
+protected:
+    void WorkerMain()
+    {
+        while (true)
+        {
+            std::shared_ptr<ParallelForJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return stop || !jobQueue.empty(); });
+                if (stop)
+                {
+                    return;
+                }
+                job = jobQueue.front();
+                if (job->IsClaimed())
+                {
+                    jobQueue.pop_front();
+                    continue;
+                }
+            }
+            job->Run();
+        }
+    }
+
+    std::vector<std::thread> workerVec;
+    std::deque<std::shared_ptr<ParallelForJob>> jobQueue;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop;
+};
+
+static ParallelForPool& GetParallelForPool()
+{
+    static ParallelForPool pool;
+    return pool;
+}
+
+uint32_t GetDefaultNumThreads()
+{
+    uint32_t numThreads = std::thread::hardware_concurrency();
+    return numThreads > 0 ? numThreads : 1;
+}
+
+void ParallelFor(size_t count, size_t minRangeSize, const RangeCallback& cb, uint32_t numThreads)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (numThreads == 0)
+    {
+        numThreads = GetDefaultNumThreads();
+    }
+
+    minRangeSize = std::max(minRangeSize, (size_t)1);
+    size_t numRanges = std::min((size_t)numThreads, (count + minRangeSize - 1) / minRangeSize);
+    if (numRanges <= 1)
+    {
+        cb(0, count);
+        return;
+    }
+
+    GetParallelForPool().Run(std::make_shared<ParallelForJob>(cb, count, numRanges));
+}
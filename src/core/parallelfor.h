@@ -0,0 +1,20 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+// Splits the range [0, count) into contiguous sub-ranges and invokes cb(begin, end) once per sub-range,
+// on a pool of worker threads that is started on the first call and reused after that.
+// The calling thread also does work and does not return until all sub-ranges are done, so it's safe to nest calls.
+// Sub-ranges are never smaller than minRangeSize, so small inputs run on the calling thread.
+// At most numThreads sub-ranges are made. If numThreads is 0, std::thread::hardware_concurrency() is used.
+using RangeCallback = std::function<void(size_t, size_t)>;
+void ParallelFor(size_t count, size_t minRangeSize, const RangeCallback& cb, uint32_t numThreads = 0);
+
+// returns the number of threads ParallelFor will use, when numThreads is 0.
+uint32_t GetDefaultNumThreads();
@@ -375,6 +375,11 @@ void Program::SetUniformRaw(int loc, const glm::vec2& value) const
     glUniform2fv(loc, 1, (float*)&value);
 }
 
+void Program::SetUniformRaw(int loc, const glm::uvec2& value) const
+{
+    glUniform2uiv(loc, 1, (uint32_t*)&value);
+}
+
 void Program::SetUniformRaw(int loc, const glm::vec3& value) const
 {
     glUniform3fv(loc, 1, (float*)&value);
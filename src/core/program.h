@@ -49,6 +49,7 @@ public:
     void SetUniformRaw(int loc, uint32_t value) const;
     void SetUniformRaw(int loc, float value) const;
     void SetUniformRaw(int loc, const glm::vec2& value) const;
+    void SetUniformRaw(int loc, const glm::uvec2& value) const;
     void SetUniformRaw(int loc, const glm::vec3& value) const;
     void SetUniformRaw(int loc, const glm::vec4& value) const;
     void SetUniformRaw(int loc, const glm::mat2& value) const;
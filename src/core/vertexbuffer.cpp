@@ -107,6 +107,17 @@ BufferObject::BufferObject(int targetIn, const std::vector<uint32_t>& data, unsi
 	numElements = (int)data.size();
 }
 
+BufferObject::BufferObject(int targetIn, const float* data, int elementSizeIn, size_t numElementsIn, unsigned int flags)
+{
+	target = targetIn;
+    glGenBuffers(1, &obj);
+	Bind();
+    glBufferStorage(target, sizeof(float) * elementSizeIn * numElementsIn, (void*)data, flags);
+	Unbind();
+	elementSize = elementSizeIn;
+	numElements = (int)numElementsIn;
+}
+
 BufferObject::~BufferObject()
 {
     glDeleteBuffers(1, &obj);
@@ -205,6 +216,19 @@ void VertexArrayObject::SetAttribBuffer(int loc, std::shared_ptr<BufferObject> a
 	Unbind();
 }
 
+void VertexArrayObject::SetAttribBuffer(int loc, std::shared_ptr<BufferObject> attribBuffer, int elementSizeIn, size_t stride, size_t offset)
+{
+	assert(attribBuffer->target == GL_ARRAY_BUFFER);
+
+	Bind();
+	attribBuffer->Bind();
+	glVertexAttribPointer(loc, elementSizeIn, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)offset);
+	glEnableVertexAttribArray(loc);
+	attribBuffer->Unbind();
+	attribBufferVec.push_back(attribBuffer);
+	Unbind();
+}
+
 void VertexArrayObject::SetElementBuffer(std::shared_ptr<BufferObject> elementBufferIn)
 {
 	assert(elementBufferIn->target == GL_ELEMENT_ARRAY_BUFFER);
@@ -36,6 +36,8 @@ public:
 	BufferObject(int targetIn, const std::vector<glm::vec3>& data, unsigned int flags = 0);
 	BufferObject(int targetIn, const std::vector<glm::vec4>& data, unsigned int flags = 0);
 	BufferObject(int targetIn, const std::vector<uint32_t>& data, unsigned int flags = 0);
+	// raw float data, numElementsIn elements of elementSizeIn floats each. e.g. from a memory mapped file.
+	BufferObject(int targetIn, const float* data, int elementSizeIn, size_t numElementsIn, unsigned int flags = 0);
 	BufferObject(const BufferObject& orig) = delete;
     ~BufferObject();
 
@@ -69,6 +71,8 @@ public:
 	void Unbind() const;
 
 	void SetAttribBuffer(int loc, std::shared_ptr<BufferObject> attribBufferIn);
+	// for interleaved buffers, elementSizeIn floats starting at offset bytes into each stride byte vertex.
+	void SetAttribBuffer(int loc, std::shared_ptr<BufferObject> attribBufferIn, int elementSizeIn, size_t stride, size_t offset);
 	void SetElementBuffer(std::shared_ptr<BufferObject> elementBufferIn);
 	std::shared_ptr<BufferObject> GetElementBuffer() const { return elementBuffer; }
 	void DrawElements(int mode) const;
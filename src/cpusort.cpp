@@ -0,0 +1,579 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "cpusort.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "core/parallelfor.h"
+
+// smaller inputs are not worth splitting across threads.
+static const size_t MIN_PARTITION_SIZE = 16384;
+
+// keys are generated a block at a time, so the projection loop has no branches and can be vectorized.
+static const size_t KEY_BLOCK_SIZE = 256;
+
+static const uint32_t RADIX_BITS = 8;
+static const uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+
+CpuSorter::CpuSorter(uint32_t numThreadsIn)
+{
+    numThreads = numThreadsIn ? numThreadsIn : GetDefaultNumThreads();
+}
+
+size_t CpuSorter::GetNumPartitions(size_t count) const
+{
+    size_t numPartitions = (count + MIN_PARTITION_SIZE - 1) / MIN_PARTITION_SIZE;
+    return std::max((size_t)1, std::min(numPartitions, (size_t)numThreads));
+}
+
+// maps a depth onto a key, see SortKeyParams.
+struct KeyQuantizer
+{
+    KeyQuantizer(const SortKeyParams& keyParams) :
+        minDepth(keyParams.minDepth),
+        invRange(1.0f / std::max(keyParams.maxDepth - keyParams.minDepth, 1e-6f)),
+        keyMax(keyParams.GetKeyMax())
+    {
+    }
+
+    uint32_t operator()(float depth) const
+    {
+        float t = std::max(0.0f, std::min((depth - minDepth) * invRange, 1.0f));
+        return keyMax - (uint32_t)((double)t * keyMax);
+    }
+
+    float minDepth;
+    float invRange;
+    uint32_t keyMax;
+};
+
+size_t CpuSorter::ComputeKeys(const glm::vec4* posVec, size_t count, const glm::mat4& modelViewProj, const SortKeyParams& keyParams)
+{
+    const KeyQuantizer quantize(keyParams);
+    const size_t numPartitions = GetNumPartitions(count);
+    const size_t partitionSize = (count + numPartitions - 1) / numPartitions;
+
+    // each partition writes its visible splats to the start of its own range in the scratch buffers.
+    keyVec2.resize(count);
+    valVec2.resize(count);
+    countVec.assign(numPartitions, 0);
+
+    const glm::mat4& m = modelViewProj;
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        float depth[KEY_BLOCK_SIZE];
+        uint8_t visible[KEY_BLOCK_SIZE];
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            const size_t begin = p * partitionSize;
+            const size_t end = std::min(count, begin + partitionSize);
+            size_t numVisible = 0;
+            for (size_t blockBegin = begin; blockBegin < end; blockBegin += KEY_BLOCK_SIZE)
+            {
+                const size_t blockSize = std::min(KEY_BLOCK_SIZE, end - blockBegin);
+                const glm::vec4* pos = posVec + blockBegin;
+                for (size_t j = 0; j < blockSize; j++)
+                {
+                    // NOTE: alpha is encoded into the w component of the positions
+                    const float x = pos[j].x, y = pos[j].y, z = pos[j].z;
+                    const float px = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+                    const float py = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+                    const float pw = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+
+                    const float CLIP = 1.5f;
+                    const float xx = px / pw;
+                    const float yy = py / pw;
+                    depth[j] = pw;
+                    visible[j] = (pw > 0.0f) & (xx < CLIP) & (xx > -CLIP) & (yy < CLIP) & (yy > -CLIP);
+                }
+
+                for (size_t j = 0; j < blockSize; j++)
+                {
+                    if (visible[j])
+                    {
+                        keyVec2[begin + numVisible] = quantize(depth[j]);
+                        valVec2[begin + numVisible] = (uint32_t)(blockBegin + j);
+                        numVisible++;
+                    }
+                }
+            }
+            countVec[p] = numVisible;
+        }
+    }, numThreads);
+
+    // pack the partitions together
+    std::vector<size_t> offsetVec(numPartitions, 0);
+    size_t numVisible = 0;
+    for (size_t p = 0; p < numPartitions; p++)
+    {
+        offsetVec[p] = numVisible;
+        numVisible += countVec[p];
+    }
+    keyVec.resize(numVisible);
+    valVec.resize(numVisible);
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            memcpy(keyVec.data() + offsetVec[p], keyVec2.data() + p * partitionSize, countVec[p] * sizeof(uint32_t));
+            memcpy(valVec.data() + offsetVec[p], valVec2.data() + p * partitionSize, countVec[p] * sizeof(uint32_t));
+        }
+    }, numThreads);
+
+    return numVisible;
+}
+
+size_t CpuSorter::SortIncremental(const glm::vec4* posVec, size_t count, const glm::mat4& modelViewProj, const SortKeyParams& keyParams)
+{
+    const KeyQuantizer quantize(keyParams);
+
+    // first call, or the number of splats changed.
+    bool needsFullSort = false;
+    if (orderVec.size() != count)
+    {
+        orderVec.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            orderVec[i] = (uint32_t)i;
+        }
+        needsFullSort = true;
+    }
+
+    // recompute the keys of all splats and count how many neighbors in the previous order are now out of order.
+    // culled splats are kept in the order too, so they are already in place when they come back into view.
+    // keys are computed in index order, so positions are read sequentially, and then gathered into the previous order.
+    const size_t numPartitions = GetNumPartitions(count);
+    const size_t partitionSize = (count + numPartitions - 1) / numPartitions;
+    keyVec2.resize(count);
+    orderKeyVec.resize(count);
+    visibleVec.resize(count);
+    countVec.assign(numPartitions, 0);
+
+    const glm::mat4& m = modelViewProj;
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            const size_t begin = p * partitionSize;
+            const size_t end = std::min(count, begin + partitionSize);
+            for (size_t i = begin; i < end; i++)
+            {
+                const float x = posVec[i].x, y = posVec[i].y, z = posVec[i].z;
+                const float px = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+                const float py = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+                const float pw = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+
+                const float CLIP = 1.5f;
+                const float xx = px / pw;
+                const float yy = py / pw;
+                visibleVec[i] = (pw > 0.0f) & (xx < CLIP) & (xx > -CLIP) & (yy < CLIP) & (yy > -CLIP);
+
+                keyVec2[i] = quantize(pw);
+            }
+        }
+    }, numThreads);
+
+    // the keys decrease with depth, so the tolerance is applied as: out of order if prev > key + tolerance.
+    float toleranceFrac = std::max(0.0f, std::min(repairTolerance * quantize.invRange, 1.0f));
+    const uint32_t keyTolerance = (uint32_t)((double)toleranceFrac * quantize.keyMax);
+    auto isOutOfOrder = [keyTolerance](uint32_t prev, uint32_t key)
+    {
+        return prev > key && prev - key > keyTolerance;
+    };
+
+    // estimate the disorder from a sample of neighbors first, so a full sort doesn't also pay for the gather.
+    const size_t SAMPLE_STRIDE = 64;
+    size_t numSampled = 0;
+    size_t numSampledOutOfOrder = 0;
+    for (size_t i = 1; i < count; i += SAMPLE_STRIDE)
+    {
+        numSampledOutOfOrder += isOutOfOrder(keyVec2[orderVec[i - 1]], keyVec2[orderVec[i]]);
+        numSampled++;
+    }
+    incrementalStats.lastDisorder = numSampled > 0 ? (float)numSampledOutOfOrder / (float)numSampled : 0.0f;
+    needsFullSort = needsFullSort || incrementalStats.lastDisorder > maxDisorder;
+
+    if (!needsFullSort)
+    {
+        ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+        {
+            for (size_t p = partBegin; p < partEnd; p++)
+            {
+                const size_t begin = p * partitionSize;
+                const size_t end = std::min(count, begin + partitionSize);
+                for (size_t i = begin; i < end; i++)
+                {
+                    orderKeyVec[i] = keyVec2[orderVec[i]];
+                }
+
+                size_t numOutOfOrder = 0;
+                for (size_t i = begin + 1; i < end; i++)
+                {
+                    numOutOfOrder += isOutOfOrder(orderKeyVec[i - 1], orderKeyVec[i]);
+                }
+                countVec[p] = numOutOfOrder;
+            }
+        }, numThreads);
+
+        // add the pairs that straddle partition boundaries
+        size_t numOutOfOrder = 0;
+        for (size_t p = 0; p < numPartitions; p++)
+        {
+            numOutOfOrder += countVec[p];
+            const size_t begin = p * partitionSize;
+            if (begin > 0 && begin < count)
+            {
+                numOutOfOrder += isOutOfOrder(orderKeyVec[begin - 1], orderKeyVec[begin]);
+            }
+        }
+        incrementalStats.lastDisorder = count > 1 ? (float)numOutOfOrder / (float)(count - 1) : 0.0f;
+
+        // if the repair gives up half way the order is still a valid permutation, but it's thrown away anyway.
+        if (numOutOfOrder > 0)
+        {
+            needsFullSort = incrementalStats.lastDisorder > maxDisorder || !RepairOrder(keyTolerance);
+        }
+    }
+
+    if (needsFullSort)
+    {
+        // keyVec2 is in index order
+        std::swap(keyVec, keyVec2);
+        valVec.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            valVec[i] = (uint32_t)i;
+        }
+        Sort(keyParams.numBits);
+        std::swap(keyVec, orderKeyVec);
+        std::swap(valVec, orderVec);
+        incrementalStats.numFull++;
+    }
+    else
+    {
+        incrementalStats.numIncremental++;
+    }
+
+    // output only the visible splats, order is preserved.
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            const size_t end = std::min(count, (p + 1) * partitionSize);
+            size_t numVisible = 0;
+            for (size_t i = p * partitionSize; i < end; i++)
+            {
+                numVisible += visibleVec[orderVec[i]];
+            }
+            countVec[p] = numVisible;
+        }
+    }, numThreads);
+
+    std::vector<size_t> offsetVec(numPartitions, 0);
+    size_t numVisible = 0;
+    for (size_t p = 0; p < numPartitions; p++)
+    {
+        offsetVec[p] = numVisible;
+        numVisible += countVec[p];
+    }
+    keyVec.resize(numVisible);
+    valVec.resize(numVisible);
+
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            const size_t end = std::min(count, (p + 1) * partitionSize);
+            size_t offset = offsetVec[p];
+            for (size_t i = p * partitionSize; i < end; i++)
+            {
+                const uint32_t index = orderVec[i];
+                if (visibleVec[index])
+                {
+                    keyVec[offset] = orderKeyVec[i];
+                    valVec[offset] = index;
+                    offset++;
+                }
+            }
+        }
+    }, numThreads);
+
+    return numVisible;
+}
+
+bool CpuSorter::RepairOrder(uint32_t keyTolerance)
+{
+    const size_t count = orderKeyVec.size();
+    uint32_t* keys = orderKeyVec.data();
+    uint32_t* vals = orderVec.data();
+
+    // the number of moves is the number of inversions, which can be quadratic, so it's bounded.
+    const size_t maxMoves = count * maxRepairMoves;
+    size_t numMoves = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        const uint32_t key = keys[i];
+        const uint32_t maxKey = key > UINT32_MAX - keyTolerance ? UINT32_MAX : key + keyTolerance;
+        if (keys[i - 1] <= maxKey)
+        {
+            continue;
+        }
+
+        const uint32_t val = vals[i];
+        size_t j = i;
+        while (j > 0 && keys[j - 1] > maxKey)
+        {
+            keys[j] = keys[j - 1];
+            vals[j] = vals[j - 1];
+            j--;
+        }
+        keys[j] = key;
+        vals[j] = val;
+
+        numMoves += i - j;
+        if (numMoves > maxMoves)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CpuSorter::SetKeys(const uint32_t* keys, size_t count)
+{
+    keyVec.assign(keys, keys + count);
+    valVec.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        valVec[i] = (uint32_t)i;
+    }
+}
+
+void CpuSorter::Sort(uint32_t numBits)
+{
+    const size_t count = keyVec.size();
+    const size_t numPartitions = GetNumPartitions(count);
+    const size_t partitionSize = (count + numPartitions - 1) / numPartitions;
+    const uint32_t numPasses = (std::min(numBits, 32u) + RADIX_BITS - 1) / RADIX_BITS;
+
+    keyVec2.resize(count);
+    valVec2.resize(count);
+    countVec.resize(numPartitions * RADIX_SIZE);
+
+    uint32_t* srcKeys = keyVec.data();
+    uint32_t* srcVals = valVec.data();
+    uint32_t* dstKeys = keyVec2.data();
+    uint32_t* dstVals = valVec2.data();
+    for (uint32_t pass = 0; pass < numPasses; pass++)
+    {
+        const uint32_t shift = pass * RADIX_BITS;
+
+        // per partition histograms
+        ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+        {
+            for (size_t p = partBegin; p < partEnd; p++)
+            {
+                size_t* histogram = countVec.data() + p * RADIX_SIZE;
+                std::fill(histogram, histogram + RADIX_SIZE, 0);
+                const size_t end = std::min(count, (p + 1) * partitionSize);
+                for (size_t i = p * partitionSize; i < end; i++)
+                {
+                    histogram[(srcKeys[i] >> shift) & (RADIX_SIZE - 1)]++;
+                }
+            }
+        }, numThreads);
+
+        // turn the histograms into scatter offsets, ordered by digit and then by partition, which keeps the sort stable.
+        size_t offset = 0;
+        bool allSameDigit = false;
+        for (uint32_t d = 0; d < RADIX_SIZE; d++)
+        {
+            size_t digitCount = 0;
+            for (size_t p = 0; p < numPartitions; p++)
+            {
+                size_t c = countVec[p * RADIX_SIZE + d];
+                countVec[p * RADIX_SIZE + d] = offset;
+                offset += c;
+                digitCount += c;
+            }
+            allSameDigit = allSameDigit || digitCount == count;
+        }
+
+        // nothing would move, e.g. the high byte when all splats are at a similar depth.
+        if (allSameDigit)
+        {
+            continue;
+        }
+
+        ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+        {
+            for (size_t p = partBegin; p < partEnd; p++)
+            {
+                size_t* offsets = countVec.data() + p * RADIX_SIZE;
+                const size_t end = std::min(count, (p + 1) * partitionSize);
+                for (size_t i = p * partitionSize; i < end; i++)
+                {
+                    size_t dst = offsets[(srcKeys[i] >> shift) & (RADIX_SIZE - 1)]++;
+                    dstKeys[dst] = srcKeys[i];
+                    dstVals[dst] = srcVals[i];
+                }
+            }
+        }, numThreads);
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcVals, dstVals);
+    }
+
+    // make sure the results end up in keyVec and valVec
+    if (srcKeys != keyVec.data())
+    {
+        std::swap(keyVec, keyVec2);
+        std::swap(valVec, valVec2);
+    }
+}
+
+CpuSorter::OrderingError CpuSorter::MeasureOrderingError(const glm::vec4* posVec, const uint32_t* indices, size_t numIndices,
+                                                         const glm::mat4& modelViewProj)
+{
+    const glm::mat4& m = modelViewProj;
+    auto depthOf = [&m, posVec](uint32_t index)
+    {
+        const glm::vec4& p = posVec[index];
+        return m[0][3] * p.x + m[1][3] * p.y + m[2][3] * p.z + m[3][3];
+    };
+
+    OrderingError error;
+    if (numIndices < 2)
+    {
+        return error;
+    }
+
+    // splats are drawn back to front, so the depth should never increase.
+    size_t numInverted = 0;
+    float prevDepth = depthOf(indices[0]);
+    for (size_t i = 1; i < numIndices; i++)
+    {
+        float depth = depthOf(indices[i]);
+        if (depth > prevDepth)
+        {
+            numInverted++;
+            error.maxInversion = std::max(error.maxInversion, depth - prevDepth);
+        }
+        prevDepth = depth;
+    }
+    error.fraction = (float)numInverted / (float)(numIndices - 1);
+    return error;
+}
+
+CpuSortWorker::CpuSortWorker(const glm::vec4* posVecIn, size_t countIn, bool useIncrementalSortIn) :
+    posVec(posVecIn),
+    count(countIn),
+    useIncrementalSort(useIncrementalSortIn),
+    quit(false),
+    busy(false),
+    hasResult(false)
+{
+    sorter = std::make_shared<CpuSorter>();
+    thread = std::thread(&CpuSortWorker::Run, this);
+}
+
+CpuSortWorker::~CpuSortWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+bool CpuSortWorker::Request(const glm::mat4& modelViewProj, const SortKeyParams& keyParams)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (busy)
+        {
+            return false;
+        }
+        busy = true;
+        requestMat = modelViewProj;
+        requestKeyParams = keyParams;
+    }
+    cv.notify_all();
+    return true;
+}
+
+bool CpuSortWorker::TakeResult(std::vector<uint32_t>& indexVecInOut)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasResult)
+    {
+        return false;
+    }
+
+    // swap, so the buffer is reused for the next result
+    std::swap(indexVecInOut, resultVec);
+    hasResult = false;
+    return true;
+}
+
+void CpuSortWorker::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !busy; });
+}
+
+bool CpuSortWorker::IsBusy() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return busy;
+}
+
+CpuSorter::IncrementalStats CpuSortWorker::GetIncrementalStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return incrementalStats;
+}
+
+void CpuSortWorker::Run()
+{
+    while (true)
+    {
+        glm::mat4 mat;
+        SortKeyParams keyParams;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return quit || busy; });
+            if (quit)
+            {
+                return;
+            }
+            mat = requestMat;
+            keyParams = requestKeyParams;
+        }
+
+        // the sorter is only touched by this thread, outside of the lock.
+        if (useIncrementalSort)
+        {
+            sorter->SortIncremental(posVec, count, mat, keyParams);
+        }
+        else
+        {
+            sorter->ComputeKeys(posVec, count, mat, keyParams);
+            sorter->Sort(keyParams.numBits);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            resultVec.assign(sorter->GetIndexVec().begin(), sorter->GetIndexVec().end());
+            incrementalStats = sorter->GetIncrementalStats();
+            hasResult = true;
+            busy = false;
+        }
+        cv.notify_all();
+    }
+}
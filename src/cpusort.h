@@ -0,0 +1,153 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// How view depth is quantized into a sort key, see presort_compute.glsl.
+// depths from minDepth to maxDepth map onto keys from keyMax down to 0, so far splats have small keys and are drawn first.
+// depths outside that range are clamped. a tight range lets fewer bits keep the same precision.
+struct SortKeyParams
+{
+    float minDepth = 0.0f;
+    float maxDepth = 1000.0f;
+    uint32_t numBits = 32;  // 16, 24 or 32
+
+    uint32_t GetKeyMax() const { return numBits >= 32 ? 0xffffffff : (1u << numBits) - 1; }
+    // depth difference between neighboring keys, splats closer than this may be drawn in either order.
+    float GetResolution() const { return (maxDepth - minDepth) / (float)GetKeyMax(); }
+};
+
+// CPU implementation of the splat depth sort, used when compute shaders are unavailable or unreliable.
+// Produces the same keys as presort_compute.glsl (up to float rounding), but the output is deterministic,
+// visible splats are always in index order before sorting and the sort is stable.
+// Does not touch OpenGL, so it can also be used to check or benchmark the gpu sorts.
+class CpuSorter
+{
+public:
+    // each pass is split into at most numThreadsIn partitions, which run on ParallelFor's shared worker pool.
+    // if numThreadsIn is 0, GetDefaultNumThreads() is used.
+    CpuSorter(uint32_t numThreadsIn = 0);
+
+    // culls and quantizes the depth of each position, see SortKeyParams.
+    // returns the number of visible splats.
+    size_t ComputeKeys(const glm::vec4* posVec, size_t count, const glm::mat4& modelViewProj, const SortKeyParams& keyParams);
+
+    // replaces the keys with these, the values are their indices. for checking other sorts on arbitrary keys.
+    void SetKeys(const uint32_t* keys, size_t count);
+
+    // stable LSD radix sort of the visible splats, 8 bits per pass. only the low numBits bits of each key are compared.
+    void Sort(uint32_t numBits = 32);
+
+    // same as ComputeKeys() followed by Sort(), but starts from the order of the previous call.
+    // when the view has barely changed that order is only slightly off, so it is repaired with an insertion sort
+    // instead of re-sorting from scratch. if too many neighbors are out of order, or the repair would take more than
+    // maxRepairMoves moves per splat, it falls back to a full Sort().
+    // the repair leaves neighbors that are less than repairTolerance apart in depth in their previous order.
+    // in a dense scene almost any rotation swaps some neighbors, so an exact repair would rarely be cheaper than a sort.
+    // returns the number of visible splats.
+    size_t SortIncremental(const glm::vec4* posVec, size_t count, const glm::mat4& modelViewProj, const SortKeyParams& keyParams);
+
+    struct IncrementalStats
+    {
+        uint64_t numIncremental = 0;  // frames that only needed a repair
+        uint64_t numFull = 0;  // frames that fell back to a full sort
+        float lastDisorder = 0.0f;  // fraction of neighbors that were out of order, before the last sort
+    };
+    const IncrementalStats& GetIncrementalStats() const { return incrementalStats; }
+
+    // fraction of neighbors that may be out of order before the repair is skipped and a full sort is done.
+    float maxDisorder = 0.02f;
+    // in world units, neighbors closer than this in depth are not considered out of order.
+    float repairTolerance = 0.001f;
+    // the repair gives up after this many moves per splat, a full 32 bit sort reads and writes each splat 8 times.
+    uint32_t maxRepairMoves = 4;
+
+    struct OrderingError
+    {
+        float fraction = 0.0f;  // fraction of neighbors in draw order where the nearer splat is drawn first
+        float maxInversion = 0.0f;  // largest depth difference of such a pair
+    };
+
+    // checks a back to front draw order against the exact float depths of the splats, e.g. to see
+    // what a lower key precision or a looser incremental repair costs. works on the output of any of the sorts.
+    static OrderingError MeasureOrderingError(const glm::vec4* posVec, const uint32_t* indices, size_t numIndices,
+                                              const glm::mat4& modelViewProj);
+
+    // indices of the visible splats, sorted after Sort() is called.
+    const std::vector<uint32_t>& GetIndexVec() const { return valVec; }
+    const std::vector<uint32_t>& GetKeyVec() const { return keyVec; }
+
+protected:
+    // number of partitions used to split count elements over the pool's worker threads.
+    size_t GetNumPartitions(size_t count) const;
+
+    // bounded insertion sort of orderKeyVec and orderVec, returns false if it gave up.
+    bool RepairOrder(uint32_t keyTolerance);
+
+    uint32_t numThreads;
+    std::vector<uint32_t> keyVec;
+    std::vector<uint32_t> valVec;
+    std::vector<uint32_t> keyVec2;  // scratch
+    std::vector<uint32_t> valVec2;
+    std::vector<size_t> countVec;  // per partition counts or histograms
+
+    // every splat, visible or not, in the order of the last SortIncremental() call.
+    std::vector<uint32_t> orderKeyVec;
+    std::vector<uint32_t> orderVec;
+    std::vector<uint8_t> visibleVec;  // by splat index
+    IncrementalStats incrementalStats;
+};
+
+// Runs a CpuSorter on its own thread, so rendering doesn't have to wait for the sort.
+// The renderer hands it a view with Request() whenever it's idle and picks up finished orders with TakeResult().
+class CpuSortWorker
+{
+public:
+    // posVecIn must stay valid for the lifetime of the worker.
+    CpuSortWorker(const glm::vec4* posVecIn, size_t countIn, bool useIncrementalSortIn);
+    ~CpuSortWorker();
+
+    // starts sorting for this view, returns false without doing anything if a sort is already in flight.
+    bool Request(const glm::mat4& modelViewProj, const SortKeyParams& keyParams);
+
+    // if a sort has finished since the last call, swaps its sorted indices into indexVecInOut and returns true.
+    // there is only ever one sort in flight, so the result is always for the last successful Request().
+    bool TakeResult(std::vector<uint32_t>& indexVecInOut);
+
+    // blocks until the sort in flight, if any, has finished.
+    void Wait();
+
+    bool IsBusy() const;
+
+    // copy of the sorter's stats, as of the last finished sort.
+    CpuSorter::IncrementalStats GetIncrementalStats() const;
+
+protected:
+    void Run();
+
+    std::shared_ptr<CpuSorter> sorter;
+    const glm::vec4* posVec;
+    size_t count;
+    bool useIncrementalSort;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    bool quit;
+    bool busy;  // a request is pending or being sorted
+    bool hasResult;
+    glm::mat4 requestMat;
+    SortKeyParams requestKeyParams;
+    std::vector<uint32_t> resultVec;
+    CpuSorter::IncrementalStats incrementalStats;
+    std::thread thread;
+};
@@ -7,18 +7,28 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 #include "core/log.h"
+#include "core/mappedfile.h"
+#include "core/parallelfor.h"
 #include "core/util.h"
 
+#include "cpusort.h"
 #include "ply.h"
 
-GaussianCloud::GaussianCloud()
+GaussianCloud::GaussianCloud() : shDegree(3), isSoA(false)
 {
+    soa.numRestPerChannel = 0;
 }
 
 // bool GaussianCloud::ImportPly(const std::string& plyFilename)
@@ -120,107 +130,518 @@ GaussianCloud::GaussianCloud()
 //     return true;
 // }
 
-bool GaussianCloud::ImportPly(const std::vector<std::string>& plyFilenames)
+// property names in the order written by ExportPly, which is also the layout of GaussianCloud::Gaussian.
+// almost every 3dgs ply file in the wild uses exactly this layout.
+static const std::vector<std::string>& GetCanonicalPropertyNames()
 {
-    for (const auto& plyFilename : plyFilenames)
+    static const std::vector<std::string> names = []()
     {
-        std::ifstream plyFile(plyFilename, std::ios::binary);
-        if (!plyFile.is_open())
+        std::vector<std::string> v = {"x", "y", "z", "nx", "ny", "nz"};
+        for (int i = 0; i < 3; i++)
         {
-            Log::E("failed to open %s\n", plyFilename.c_str());
-            return false;
+            v.push_back("f_dc_" + std::to_string(i));
         }
-
-        Ply ply;
-        if (!ply.Parse(plyFile))
+        for (int i = 0; i < 45; i++)
         {
-            Log::E("Error parsing ply file \"%s\"\n", plyFilename.c_str());
-            return false;
+            v.push_back("f_rest_" + std::to_string(i));
         }
-
-        struct
+        v.push_back("opacity");
+        for (int i = 0; i < 3; i++)
         {
-            Ply::Property x, y, z;
-            Ply::Property f_dc[3];
-            Ply::Property f_rest[45];
-            Ply::Property opacity;
-            Ply::Property scale[3];
-            Ply::Property rot[4];
-        } props;
-
-        if (!ply.GetProperty("x", props.x) || !ply.GetProperty("y", props.y) || !ply.GetProperty("z", props.z))
+            v.push_back("scale_" + std::to_string(i));
+        }
+        for (int i = 0; i < 4; i++)
         {
-            Log::E("Error parsing ply file \"%s\", missing position property\n", plyFilename.c_str());
+            v.push_back("rot_" + std::to_string(i));
         }
+        return v;
+    }();
+    return names;
+}
 
-        for (int i = 0; i < 3; i++)
+// fast path for plys whose vertices are tightly packed T records, copies vertices [0, count).
+// there are no per-property lookups, each range is a single memcpy straight out of the (mapped) file.
+template <typename T>
+static void CopyRecords(const Ply& ply, size_t count, T* out, uint32_t numThreads)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "records must be trivially copyable");
+    assert(ply.GetVertexSize() == sizeof(T));
+
+    const size_t MIN_RANGE_SIZE = 16384;
+    ParallelFor(count, MIN_RANGE_SIZE, [&ply, out](size_t begin, size_t end)
+    {
+        memcpy(out + begin, ply.GetVertexData(begin), (end - begin) * sizeof(T));
+    }, numThreads);
+}
+
+// number of f_rest coefficients per color channel, indexed by sh degree.
+static const uint32_t NUM_REST_PER_DEGREE[] = {0, 3, 8, 15};
+
+// the sh degree is implied by the number of f_rest properties, 0, 9, 24 or 45.
+static uint32_t DetectSHDegree(const Ply& ply, const std::string& plyFilename)
+{
+    uint32_t numRest = 0;
+    Ply::Property prop;
+    while (ply.GetProperty("f_rest_" + std::to_string(numRest), prop))
+    {
+        numRest++;
+    }
+
+    uint32_t degree = 0;
+    while (degree < 3 && NUM_REST_PER_DEGREE[degree + 1] * 3 <= numRest)
+    {
+        degree++;
+    }
+    if (NUM_REST_PER_DEGREE[degree] * 3 != numRest)
+    {
+        Log::W("\"%s\" has %u f_rest properties, using sh degree %u\n", plyFilename.c_str(), numRest, degree);
+    }
+    return degree;
+}
+
+struct GaussianProps
+{
+    Ply::Property x, y, z;
+    Ply::Property f_dc[3];
+    Ply::Property f_rest[3][15];  // [channel][coeff], coeffs that are not loaded are left Unknown and read as 0
+    Ply::Property opacity;
+    Ply::Property scale[3];
+    Ply::Property rot[4];
+};
+
+// looks up the properties of the first numRest f_rest coefficients of each channel.
+// fileSHDegree is the degree of the file, see DetectSHDegree().
+static void LookupProps(const Ply& ply, const std::string& plyFilename, uint32_t numRest, uint32_t fileSHDegree, GaussianProps& props)
+{
+    if (!ply.GetProperty("x", props.x) || !ply.GetProperty("y", props.y) || !ply.GetProperty("z", props.z))
+    {
+        Log::E("Error parsing ply file \"%s\", missing position property\n", plyFilename.c_str());
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!ply.GetProperty("f_dc_" + std::to_string(i), props.f_dc[i]))
         {
-            if (!ply.GetProperty("f_dc_" + std::to_string(i), props.f_dc[i]))
-            {
-                Log::E("Error parsing ply file \"%s\", missing f_dc property\n", plyFilename.c_str());
-            }
+            Log::E("Error parsing ply file \"%s\", missing f_dc property\n", plyFilename.c_str());
         }
+    }
 
-        for (int i = 0; i < 45; i++)
+    // f_rest is stored channel by channel, with as many coeffs per channel as the file's sh degree needs.
+    const uint32_t fileNumRest = NUM_REST_PER_DEGREE[fileSHDegree];
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        for (uint32_t k = 0; k < std::min(numRest, fileNumRest); k++)
         {
-            if (!ply.GetProperty("f_rest_" + std::to_string(i), props.f_rest[i]))
+            if (!ply.GetProperty("f_rest_" + std::to_string(c * fileNumRest + k), props.f_rest[c][k]))
             {
                 Log::E("Error parsing ply file \"%s\", missing f_rest property\n", plyFilename.c_str());
             }
         }
+    }
+
+    if (!ply.GetProperty("opacity", props.opacity))
+    {
+        Log::E("Error parsing ply file \"%s\", missing opacity property\n", plyFilename.c_str());
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!ply.GetProperty("scale_" + std::to_string(i), props.scale[i]))
+        {
+            Log::E("Error parsing ply file \"%s\", missing scale property\n", plyFilename.c_str());
+        }
+    }
 
-        if (!ply.GetProperty("opacity", props.opacity))
+    for (int i = 0; i < 4; i++)
+    {
+        if (!ply.GetProperty("rot_" + std::to_string(i), props.rot[i]))
         {
-            Log::E("Error parsing ply file \"%s\", missing opacity property\n", plyFilename.c_str());
+            Log::E("Error parsing ply file \"%s\", missing rot property\n", plyFilename.c_str());
         }
+    }
+}
 
-        for (int i = 0; i < 3; i++)
+// generic path, handles any property order or additional properties, decodes vertices [0, count).
+// only the first numRest f_rest coeffs of each channel are read, the rest are zero.
+static bool DecodeGaussians(const Ply& ply, const std::string& plyFilename, uint32_t numRest, uint32_t fileSHDegree,
+                            size_t count, GaussianCloud::Gaussian* out, uint32_t numThreads)
+{
+    GaussianProps props;
+    LookupProps(ply, plyFilename, numRest, fileSHDegree, props);
+
+    // each range decodes into its own disjoint slice of out, so no locking is needed.
+    const size_t MIN_RANGE_SIZE = 4096;
+    ParallelFor(count, MIN_RANGE_SIZE, [&ply, &props, out](size_t begin, size_t end)
+    {
+        GaussianCloud::Gaussian* g = out + begin;
+        ply.ForEachVertexRange(begin, end, [&g, &props](const uint8_t* data, size_t size)
+        {
+            g->position[0] = props.x.Get<float>(data);
+            g->position[1] = props.y.Get<float>(data);
+            g->position[2] = props.z.Get<float>(data);
+            for (int j = 0; j < 3; j++)
+            {
+                g->f_dc[j] = props.f_dc[j].Get<float>(data);
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                for (int k = 0; k < 15; k++)
+                {
+                    g->f_rest[c * 15 + k] = props.f_rest[c][k].Get<float>(data);
+                }
+            }
+            g->opacity = props.opacity.Get<float>(data);
+            for (int j = 0; j < 3; j++)
+            {
+                g->scale[j] = props.scale[j].Get<float>(data);
+            }
+            for (int j = 0; j < 4; j++)
+            {
+                g->rot[j] = props.rot[j].Get<float>(data);
+            }
+            g++;
+        });
+    }, numThreads);
+
+    return true;
+}
+
+// same as CopyRecords, but into structure of arrays storage, starting at splat offset.
+// each canonical record is copied out of the file whole, and split into the arrays without any property lookups.
+static void CopyRecordsSoA(const Ply& ply, size_t count, GaussianCloud::SoA& soa, size_t offset, uint32_t numThreads)
+{
+    assert(ply.GetVertexSize() == sizeof(GaussianCloud::Gaussian));
+
+    const size_t MIN_RANGE_SIZE = 16384;
+    ParallelFor(count, MIN_RANGE_SIZE, [&ply, &soa, offset](size_t begin, size_t end)
+    {
+        const uint32_t numRest = soa.numRestPerChannel;
+        const uint8_t* data = ply.GetVertexData(begin);
+        GaussianCloud::Gaussian g;
+        for (size_t j = begin; j < end; j++)
         {
-            if (!ply.GetProperty("scale_" + std::to_string(i), props.scale[i]))
+            // the mapped records aren't necessarily aligned
+            memcpy(&g, data, sizeof(g));
+            data += sizeof(g);
+
+            const size_t i = offset + j;
+            soa.positionVec[i] = glm::vec3(g.position[0], g.position[1], g.position[2]);
+            soa.f_dcVec[i] = glm::vec3(g.f_dc[0], g.f_dc[1], g.f_dc[2]);
+            float* rest = soa.f_restVec.data() + i * 3 * numRest;
+            for (uint32_t c = 0; c < 3; c++)
             {
-                Log::E("Error parsing ply file \"%s\", missing scale property\n", plyFilename.c_str());
+                memcpy(rest + c * numRest, g.f_rest + c * 15, numRest * sizeof(float));
             }
+            soa.opacityVec[i] = g.opacity;
+            soa.scaleVec[i] = glm::vec3(g.scale[0], g.scale[1], g.scale[2]);
+            soa.rotVec[i] = glm::vec4(g.rot[0], g.rot[1], g.rot[2], g.rot[3]);
         }
+    }, numThreads);
+}
 
-        for (int i = 0; i < 4; i++)
+// same as DecodeGaussians, but into structure of arrays storage, starting at splat offset.
+static bool DecodeGaussiansSoA(const Ply& ply, const std::string& plyFilename, uint32_t fileSHDegree, size_t count,
+                               GaussianCloud::SoA& soa, size_t offset, uint32_t numThreads)
+{
+    const uint32_t numRest = soa.numRestPerChannel;
+    GaussianProps props;
+    LookupProps(ply, plyFilename, numRest, fileSHDegree, props);
+
+    const size_t MIN_RANGE_SIZE = 4096;
+    ParallelFor(count, MIN_RANGE_SIZE, [&ply, &props, &soa, offset, numRest](size_t begin, size_t end)
+    {
+        size_t i = offset + begin;
+        ply.ForEachVertexRange(begin, end, [&i, &props, &soa, numRest](const uint8_t* data, size_t size)
         {
-            if (!ply.GetProperty("rot_" + std::to_string(i), props.rot[i]))
+            soa.positionVec[i] = glm::vec3(props.x.Get<float>(data), props.y.Get<float>(data), props.z.Get<float>(data));
+            soa.f_dcVec[i] = glm::vec3(props.f_dc[0].Get<float>(data), props.f_dc[1].Get<float>(data), props.f_dc[2].Get<float>(data));
+            float* rest = soa.f_restVec.data() + i * 3 * numRest;
+            for (uint32_t c = 0; c < 3; c++)
             {
-                Log::E("Error parsing ply file \"%s\", missing rot property\n", plyFilename.c_str());
+                for (uint32_t k = 0; k < numRest; k++)
+                {
+                    rest[c * numRest + k] = props.f_rest[c][k].Get<float>(data);
+                }
             }
+            soa.opacityVec[i] = props.opacity.Get<float>(data);
+            soa.scaleVec[i] = glm::vec3(props.scale[0].Get<float>(data), props.scale[1].Get<float>(data), props.scale[2].Get<float>(data));
+            soa.rotVec[i] = glm::vec4(props.rot[0].Get<float>(data), props.rot[1].Get<float>(data),
+                                      props.rot[2].Get<float>(data), props.rot[3].Get<float>(data));
+            i++;
+        });
+    }, numThreads);
+
+    return true;
+}
+
+bool GaussianCloud::ImportPly(const std::vector<std::string>& plyFilenames)
+{
+    return ImportPly(plyFilenames, ImportOptions());
+}
+
+// a rigid transform with optional uniform scale.
+// non-uniform scale can't be represented by a single gaussian, so the average (cube root of the determinant) is used.
+// NOTE: the view dependent spherical harmonics are not rotated.
+struct SplatTransform
+{
+    SplatTransform(const glm::mat4& xformIn) : xform(xformIn)
+    {
+        glm::mat3 m(xform);
+        float s = cbrtf(glm::determinant(m));
+        logS = logf(fabsf(s));
+        r = glm::normalize(glm::quat_cast(m / s));
+    }
+
+    // rot is (real, i, j, k), scale is log(scale)
+    void Apply(float* position, float* rot, float* scale) const
+    {
+        glm::vec3 p = glm::vec3(xform * glm::vec4(position[0], position[1], position[2], 1.0f));
+        position[0] = p.x;
+        position[1] = p.y;
+        position[2] = p.z;
+
+        glm::quat q = r * glm::normalize(glm::quat(rot[0], rot[1], rot[2], rot[3]));
+        rot[0] = q.w;
+        rot[1] = q.x;
+        rot[2] = q.y;
+        rot[3] = q.z;
+
+        for (int j = 0; j < 3; j++)
+        {
+            scale[j] += logS;
+        }
+    }
+
+    glm::mat4 xform;
+    glm::quat r;
+    float logS;
+};
+
+bool GaussianCloud::ImportPly(const std::vector<std::string>& plyFilenames, const ImportOptions& options)
+{
+    if (size() > 0 && isSoA != options.structureOfArrays)
+    {
+        Log::E("ImportPly: storage option does not match the existing splats\n");
+        return false;
+    }
+
+    if (!options.transforms.empty() && options.transforms.size() != plyFilenames.size())
+    {
+        Log::E("ImportPly: expected %d transforms, got %d\n", (int)plyFilenames.size(), (int)options.transforms.size());
+        return false;
+    }
+
+    // parse every header concurrently, the vertex data stays mapped until the end of this function.
+    const size_t numFiles = plyFilenames.size();
+    std::vector<std::unique_ptr<Ply>> plyVec(numFiles);
+    std::vector<uint8_t> okVec(numFiles, 0);
+    ParallelFor(numFiles, 1, [&plyFilenames, &plyVec, &okVec](size_t begin, size_t end)
+    {
+        for (size_t f = begin; f < end; f++)
+        {
+            plyVec[f] = std::make_unique<Ply>();
+            okVec[f] = plyVec[f]->ParseMapped(plyFilenames[f]) ? 1 : 0;
         }
-        size_t oldSize = gaussianVec.size();
-        gaussianVec.resize(oldSize + ply.GetVertexCount());
-        //gaussianVec.resize(ply.GetVertexCount());
+    }, options.numThreads);
 
-        int i = 0;
-        ply.ForEachVertex([this, &i, &props](const uint8_t* data, size_t size)
+    // each file is given its own range of the cloud, so files can be decoded in parallel without locking.
+    std::vector<size_t> offsetVec(numFiles);
+    const size_t oldSize = size();
+    size_t totalSize = oldSize;
+    std::vector<uint32_t> fileSHDegreeVec(numFiles);
+    uint32_t fileSHDegree = 0;
+    for (size_t f = 0; f < numFiles; f++)
+    {
+        if (!okVec[f])
         {
-            gaussianVec[i].position[0] = props.x.Get<float>(data);
-            gaussianVec[i].position[1] = props.y.Get<float>(data);
-            gaussianVec[i].position[2] = props.z.Get<float>(data);
-            for (int j = 0; j < 3; j++)
+            Log::E("Error parsing ply file \"%s\"\n", plyFilenames[f].c_str());
+            return false;
+        }
+        offsetVec[f] = totalSize;
+        totalSize += plyVec[f]->GetVertexCount();
+        fileSHDegreeVec[f] = DetectSHDegree(*plyVec[f], plyFilenames[f]);
+        fileSHDegree = std::max(fileSHDegree, fileSHDegreeVec[f]);
+    }
+
+    // only the bands that are present and requested are decoded, files with fewer bands are padded with zeros.
+    uint32_t newSHDegree = std::min(fileSHDegree, std::min(options.maxSHDegree, 3u));
+    if (oldSize > 0)
+    {
+        // soa storage can't change the number of coeffs per splat after the fact.
+        newSHDegree = isSoA ? shDegree : std::max(shDegree, newSHDegree);
+    }
+    shDegree = newSHDegree;
+    const uint32_t numRest = NUM_REST_PER_DEGREE[shDegree];
+    Log::D("ImportPly: sh degree %u\n", shDegree);
+
+    isSoA = options.structureOfArrays;
+    if (isSoA)
+    {
+        soa.numRestPerChannel = numRest;
+        soa.positionVec.resize(totalSize);
+        soa.opacityVec.resize(totalSize);
+        soa.scaleVec.resize(totalSize);
+        soa.rotVec.resize(totalSize);
+        soa.f_dcVec.resize(totalSize);
+        soa.f_restVec.resize(totalSize * 3 * numRest);
+    }
+    else
+    {
+        gaussianVec.resize(totalSize);
+    }
+
+    // split the threads between the files, when there are more threads than files each file is decoded in parallel as well.
+    uint32_t numThreads = options.numThreads ? options.numThreads : GetDefaultNumThreads();
+    uint32_t numThreadsPerFile = numFiles > 0 ? std::max(1u, numThreads / (uint32_t)numFiles) : 1;
+    ParallelFor(numFiles, 1, [this, &options, &plyFilenames, &plyVec, &okVec, &offsetVec, &fileSHDegreeVec, numRest, numThreadsPerFile](size_t begin, size_t end)
+    {
+        for (size_t f = begin; f < end; f++)
+        {
+            const Ply& ply = *plyVec[f];
+            const size_t count = ply.GetVertexCount();
+            const bool canonical = ply.HasExactLayout(GetCanonicalPropertyNames(), Ply::Type::Float);
+            bool ok = true;
+            if (isSoA && canonical)
             {
-                gaussianVec[i].f_dc[j] = props.f_dc[j].Get<float>(data);
+                Log::D("\"%s\" has canonical layout, using fast path\n", plyFilenames[f].c_str());
+                CopyRecordsSoA(ply, count, soa, offsetVec[f], numThreadsPerFile);
             }
-            for (int j = 0; j < 45; j++)
+            else if (isSoA)
             {
-                gaussianVec[i].f_rest[j] = props.f_rest[j].Get<float>(data);
+                ok = DecodeGaussiansSoA(ply, plyFilenames[f], fileSHDegreeVec[f], count, soa, offsetVec[f], numThreadsPerFile);
             }
-            gaussianVec[i].opacity = props.opacity.Get<float>(data);
-            for (int j = 0; j < 3; j++)
+            else if (canonical)
             {
-                gaussianVec[i].scale[j] = props.scale[j].Get<float>(data);
+                static_assert(sizeof(Gaussian) == 62 * sizeof(float), "Gaussian must match the canonical ply layout");
+                Log::D("\"%s\" has canonical layout, using fast path\n", plyFilenames[f].c_str());
+                Gaussian* out = gaussianVec.data() + offsetVec[f];
+                CopyRecords(ply, count, out, numThreadsPerFile);
+
+                // zero the bands that were not requested
+                for (size_t i = 0; numRest < 15 && i < count; i++)
+                {
+                    for (uint32_t c = 0; c < 3; c++)
+                    {
+                        memset(out[i].f_rest + c * 15 + numRest, 0, (15 - numRest) * sizeof(float));
+                    }
+                }
             }
-            for (int j = 0; j < 4; j++)
+            else
             {
-                gaussianVec[i].rot[j] = props.rot[j].Get<float>(data);
+                ok = DecodeGaussians(ply, plyFilenames[f], numRest, fileSHDegreeVec[f], count, gaussianVec.data() + offsetVec[f], numThreadsPerFile);
             }
-            i++;
-        });
+
+            if (!ok)
+            {
+                okVec[f] = 0;
+                continue;
+            }
+
+            if (!options.transforms.empty())
+            {
+                SplatTransform xform(options.transforms[f]);
+                for (size_t i = offsetVec[f]; i < offsetVec[f] + count; i++)
+                {
+                    if (isSoA)
+                    {
+                        xform.Apply(&soa.positionVec[i].x, &soa.rotVec[i].x, &soa.scaleVec[i].x);
+                    }
+                    else
+                    {
+                        xform.Apply(gaussianVec[i].position, gaussianVec[i].rot, gaussianVec[i].scale);
+                    }
+                }
+            }
+        }
+    }, numThreads);
+
+    for (size_t f = 0; f < numFiles; f++)
+    {
+        if (!okVec[f])
+        {
+            Log::E("Error decoding ply file \"%s\"\n", plyFilenames[f].c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool GaussianCloud::StreamPly(const std::string& plyFilename, const StreamOptions& options, const ChunkCallback& cb,
+                              StreamStats* statsOut)
+{
+    StreamStats localStats;
+    StreamStats& stats = statsOut ? *statsOut : localStats;
+    stats = StreamStats();
+
+    std::ifstream plyFile(plyFilename, std::ios::binary);
+    if (!plyFile.is_open())
+    {
+        Log::E("failed to open \"%s\"\n", plyFilename.c_str());
+        return false;
+    }
+
+    Ply ply;
+    if (!ply.ParseChunked(plyFile))
+    {
+        Log::E("Error parsing ply file \"%s\"\n", plyFilename.c_str());
+        return false;
+    }
+
+    // canonical chunks are handed to the consumer in place, otherwise a second buffer holds the decoded splats.
+    const bool canonical = ply.HasExactLayout(GetCanonicalPropertyNames(), Ply::Type::Float);
+    const size_t bytesPerVertex = canonical ? ply.GetVertexSize() : ply.GetVertexSize() + sizeof(Gaussian);
+    const size_t maxChunkVertices = options.maxMemory / bytesPerVertex;
+    if (maxChunkVertices == 0)
+    {
+        Log::E("StreamPly: memory limit of %zu bytes is too small for a single vertex\n", options.maxMemory);
+        return false;
     }
+
+    const uint32_t fileSHDegree = canonical ? 3 : DetectSHDegree(ply, plyFilename);
+    std::vector<Gaussian> chunkVec;
+    size_t firstIndex = 0;
+    while (true)
+    {
+        size_t numVertices = 0;
+        if (!ply.ReadChunk(plyFile, maxChunkVertices, numVertices))
+        {
+            Log::E("Error reading ply file \"%s\"\n", plyFilename.c_str());
+            return false;
+        }
+        if (numVertices == 0)
+        {
+            break;
+        }
+
+        const Gaussian* chunk = nullptr;
+        if (canonical)
+        {
+            chunk = reinterpret_cast<const Gaussian*>(ply.GetVertexData(0));
+        }
+        else
+        {
+            chunkVec.resize(numVertices);
+            if (!DecodeGaussians(ply, plyFilename, 15, fileSHDegree, numVertices, chunkVec.data(), options.numThreads))
+            {
+                return false;
+            }
+            chunk = chunkVec.data();
+        }
+
+        stats.numChunks++;
+        stats.peakBufferBytes = std::max(stats.peakBufferBytes, ply.GetDataCapacity() + chunkVec.capacity() * sizeof(Gaussian));
+
+        if (!cb(chunk, firstIndex, numVertices))
+        {
+            break;
+        }
+        firstIndex += numVertices;
+    }
+
     return true;
 }
+
 bool GaussianCloud::ExportPly(const std::string& plyFilename) const
 {
     std::ofstream plyFile(plyFilename, std::ios::binary);
@@ -233,85 +654,454 @@ bool GaussianCloud::ExportPly(const std::string& plyFilename) const
     // ply files have unix line endings.
     plyFile << "ply\n";
     plyFile << "format binary_little_endian 1.0\n";
-    plyFile << "element vertex " << gaussianVec.size() << "\n";
-    plyFile << "property float x\n";
-    plyFile << "property float y\n";
-    plyFile << "property float z\n";
-    plyFile << "property float nx\n";
-    plyFile << "property float ny\n";
-    plyFile << "property float nz\n";
-    plyFile << "property float f_dc_0\n";
-    plyFile << "property float f_dc_1\n";
-    plyFile << "property float f_dc_2\n";
-    plyFile << "property float f_rest_0\n";
-    plyFile << "property float f_rest_1\n";
-    plyFile << "property float f_rest_2\n";
-    plyFile << "property float f_rest_3\n";
-    plyFile << "property float f_rest_4\n";
-    plyFile << "property float f_rest_5\n";
-    plyFile << "property float f_rest_6\n";
-    plyFile << "property float f_rest_7\n";
-    plyFile << "property float f_rest_8\n";
-    plyFile << "property float f_rest_9\n";
-    plyFile << "property float f_rest_10\n";
-    plyFile << "property float f_rest_11\n";
-    plyFile << "property float f_rest_12\n";
-    plyFile << "property float f_rest_13\n";
-    plyFile << "property float f_rest_14\n";
-    plyFile << "property float f_rest_15\n";
-    plyFile << "property float f_rest_16\n";
-    plyFile << "property float f_rest_17\n";
-    plyFile << "property float f_rest_18\n";
-    plyFile << "property float f_rest_19\n";
-    plyFile << "property float f_rest_20\n";
-    plyFile << "property float f_rest_21\n";
-    plyFile << "property float f_rest_22\n";
-    plyFile << "property float f_rest_23\n";
-    plyFile << "property float f_rest_24\n";
-    plyFile << "property float f_rest_25\n";
-    plyFile << "property float f_rest_26\n";
-    plyFile << "property float f_rest_27\n";
-    plyFile << "property float f_rest_28\n";
-    plyFile << "property float f_rest_29\n";
-    plyFile << "property float f_rest_30\n";
-    plyFile << "property float f_rest_31\n";
-    plyFile << "property float f_rest_32\n";
-    plyFile << "property float f_rest_33\n";
-    plyFile << "property float f_rest_34\n";
-    plyFile << "property float f_rest_35\n";
-    plyFile << "property float f_rest_36\n";
-    plyFile << "property float f_rest_37\n";
-    plyFile << "property float f_rest_38\n";
-    plyFile << "property float f_rest_39\n";
-    plyFile << "property float f_rest_40\n";
-    plyFile << "property float f_rest_41\n";
-    plyFile << "property float f_rest_42\n";
-    plyFile << "property float f_rest_43\n";
-    plyFile << "property float f_rest_44\n";
-    plyFile << "property float opacity\n";
-    plyFile << "property float scale_0\n";
-    plyFile << "property float scale_1\n";
-    plyFile << "property float scale_2\n";
-    plyFile << "property float rot_0\n";
-    plyFile << "property float rot_1\n";
-    plyFile << "property float rot_2\n";
-    plyFile << "property float rot_3\n";
+    plyFile << "element vertex " << size() << "\n";
+    for (auto&& name : GetCanonicalPropertyNames())
+    {
+        plyFile << "property float " << name << "\n";
+    }
     plyFile << "end_header\n";
 
     const size_t GAUSSIAN_SIZE = 62 * sizeof(float);
     static_assert(sizeof(Gaussian) >= GAUSSIAN_SIZE);
 
-    for (auto&& g : gaussianVec)
+    if (!isSoA)
+    {
+        for (auto&& g : gaussianVec)
+        {
+            plyFile.write((char*)&g, GAUSSIAN_SIZE);
+        }
+    }
+    else
+    {
+        Gaussian g;
+        for (size_t i = 0; i < size(); i++)
+        {
+            GetGaussian(i, g);
+            plyFile.write((char*)&g, GAUSSIAN_SIZE);
+        }
+    }
+
+    return true;
+}
+
+// compact file layout, all values are little endian.
+//     CompactHeader
+//     CompactChunk[numChunks]
+//     CompactSplat[numSplats]
+// each chunk stores the bounds used to quantize the COMPACT_CHUNK_SIZE splats that belong to it.
+static const uint32_t COMPACT_MAGIC = 0x5a4c5053;  // 'SPLZ'
+static const uint32_t COMPACT_VERSION = 1;
+static const uint32_t COMPACT_CHUNK_SIZE = 256;
+
+struct CompactHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numSplats;
+    uint32_t chunkSize;
+    uint32_t numChunks;
+};
+
+struct CompactChunk
+{
+    float posMin[3];
+    float posMax[3];
+    float scaleMin, scaleMax;  // log scale
+    float dcMin, dcMax;
+    float restMin, restMax;
+};
+
+// only byte arrays, so there is no padding.
+struct CompactSplat
+{
+    uint8_t rot[4];  // smallest three, 2 bit index of the largest component, then 3 x 10 bits
+    uint8_t position[6];  // 3 x 16 bit, relative to the chunk bounds
+    uint8_t scale[3];
+    uint8_t alpha;
+    uint8_t f_dc[3];
+    uint8_t f_rest[45];
+};
+static_assert(sizeof(CompactSplat) == 62, "CompactSplat must be tightly packed");
+
+static uint32_t Quantize(float value, float minValue, float maxValue, uint32_t maxQ)
+{
+    if (maxValue <= minValue)
+    {
+        return 0;
+    }
+    float t = glm::clamp((value - minValue) / (maxValue - minValue), 0.0f, 1.0f);
+    return (uint32_t)(t * (float)maxQ + 0.5f);
+}
+
+static float Dequantize(uint32_t q, float minValue, float maxValue, uint32_t maxQ)
+{
+    return minValue + (maxValue - minValue) * ((float)q / (float)maxQ);
+}
+
+static uint32_t PackRotation(const float* rot)
+{
+    glm::vec4 q = glm::vec4(rot[0], rot[1], rot[2], rot[3]);
+    float len = glm::length(q);
+    q = len > 0.0f ? q / len : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (fabsf(q[i]) > fabsf(q[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, so make the dropped component positive.
+    if (q[largest] < 0.0f)
+    {
+        q = -q;
+    }
+
+    // the remaining components are within +/- 1/sqrt(2)
+    const float RANGE = 0.70710678f;
+    uint32_t packed = (uint32_t)largest << 30;
+    int shift = 20;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            packed |= Quantize(q[i], -RANGE, RANGE, 1023) << shift;
+            shift -= 10;
+        }
+    }
+    return packed;
+}
+
+static void UnpackRotation(uint32_t packed, float* rot)
+{
+    const float RANGE = 0.70710678f;
+    int largest = (int)(packed >> 30);
+    float sumSq = 0.0f;
+    int shift = 20;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i != largest)
+        {
+            rot[i] = Dequantize((packed >> shift) & 1023, -RANGE, RANGE, 1023);
+            sumSq += rot[i] * rot[i];
+            shift -= 10;
+        }
+    }
+    rot[largest] = sqrtf(std::max(0.0f, 1.0f - sumSq));
+}
+
+static void EncodeChunk(const GaussianCloud::Gaussian* g, size_t count, CompactChunk& chunk, CompactSplat* out)
+{
+    const float FLT_BIG = std::numeric_limits<float>::max();
+    for (int j = 0; j < 3; j++)
+    {
+        chunk.posMin[j] = FLT_BIG;
+        chunk.posMax[j] = -FLT_BIG;
+    }
+    chunk.scaleMin = chunk.dcMin = chunk.restMin = FLT_BIG;
+    chunk.scaleMax = chunk.dcMax = chunk.restMax = -FLT_BIG;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            chunk.posMin[j] = std::min(chunk.posMin[j], g[i].position[j]);
+            chunk.posMax[j] = std::max(chunk.posMax[j], g[i].position[j]);
+            chunk.scaleMin = std::min(chunk.scaleMin, g[i].scale[j]);
+            chunk.scaleMax = std::max(chunk.scaleMax, g[i].scale[j]);
+            chunk.dcMin = std::min(chunk.dcMin, g[i].f_dc[j]);
+            chunk.dcMax = std::max(chunk.dcMax, g[i].f_dc[j]);
+        }
+        for (int j = 0; j < 45; j++)
+        {
+            chunk.restMin = std::min(chunk.restMin, g[i].f_rest[j]);
+            chunk.restMax = std::max(chunk.restMax, g[i].f_rest[j]);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CompactSplat& s = out[i];
+        uint32_t rot = PackRotation(g[i].rot);
+        for (int j = 0; j < 4; j++)
+        {
+            s.rot[j] = (uint8_t)(rot >> (j * 8));
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            uint32_t p = Quantize(g[i].position[j], chunk.posMin[j], chunk.posMax[j], 65535);
+            s.position[j * 2] = (uint8_t)p;
+            s.position[j * 2 + 1] = (uint8_t)(p >> 8);
+            s.scale[j] = (uint8_t)Quantize(g[i].scale[j], chunk.scaleMin, chunk.scaleMax, 255);
+            s.f_dc[j] = (uint8_t)Quantize(g[i].f_dc[j], chunk.dcMin, chunk.dcMax, 255);
+        }
+        float alpha = 1.0f / (1.0f + expf(-g[i].opacity));
+        s.alpha = (uint8_t)Quantize(alpha, 0.0f, 1.0f, 255);
+        for (int j = 0; j < 45; j++)
+        {
+            s.f_rest[j] = (uint8_t)Quantize(g[i].f_rest[j], chunk.restMin, chunk.restMax, 255);
+        }
+    }
+}
+
+static void DecodeChunk(const CompactChunk& chunk, const CompactSplat* in, size_t count, GaussianCloud::Gaussian* g)
+{
+    // per chunk step sizes, so the inner loops are a multiply add per value.
+    glm::vec3 posStep;
+    for (int j = 0; j < 3; j++)
+    {
+        posStep[j] = (chunk.posMax[j] - chunk.posMin[j]) / 65535.0f;
+    }
+    const float scaleStep = (chunk.scaleMax - chunk.scaleMin) / 255.0f;
+    const float dcStep = (chunk.dcMax - chunk.dcMin) / 255.0f;
+    const float restStep = (chunk.restMax - chunk.restMin) / 255.0f;
+
+    // inverse sigmoid of each quantized alpha, clamped so that alpha of 0 or 1 stays finite.
+    static const std::vector<float> opacityTable = []()
+    {
+        const float EPSILON = 1.0f / 512.0f;
+        std::vector<float> table(256);
+        for (int i = 0; i < 256; i++)
+        {
+            float alpha = glm::clamp(i / 255.0f, EPSILON, 1.0f - EPSILON);
+            table[i] = logf(alpha / (1.0f - alpha));
+        }
+        return table;
+    }();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const CompactSplat& s = in[i];
+        uint32_t rot = (uint32_t)s.rot[0] | ((uint32_t)s.rot[1] << 8) | ((uint32_t)s.rot[2] << 16) | ((uint32_t)s.rot[3] << 24);
+        UnpackRotation(rot, g[i].rot);
+        for (int j = 0; j < 3; j++)
+        {
+            uint32_t p = (uint32_t)s.position[j * 2] | ((uint32_t)s.position[j * 2 + 1] << 8);
+            g[i].position[j] = chunk.posMin[j] + posStep[j] * (float)p;
+            g[i].normal[j] = 0.0f;
+            g[i].scale[j] = chunk.scaleMin + scaleStep * (float)s.scale[j];
+            g[i].f_dc[j] = chunk.dcMin + dcStep * (float)s.f_dc[j];
+        }
+        g[i].opacity = opacityTable[s.alpha];
+        for (int j = 0; j < 45; j++)
+        {
+            g[i].f_rest[j] = chunk.restMin + restStep * (float)s.f_rest[j];
+        }
+    }
+}
+
+bool GaussianCloud::ImportCompact(const std::string& filename)
+{
+    if (isSoA)
+    {
+        Log::E("ImportCompact: cloud must be in array of structures storage\n");
+        return false;
+    }
+
+    MappedFile mappedFile;
+    if (!mappedFile.Open(filename))
+    {
+        return false;
+    }
+
+    CompactHeader header;
+    if (mappedFile.GetSize() < sizeof(CompactHeader))
+    {
+        Log::E("Invalid compact file \"%s\", too small\n", filename.c_str());
+        return false;
+    }
+    memcpy(&header, mappedFile.GetData(), sizeof(CompactHeader));
+    if (header.magic != COMPACT_MAGIC || header.version != COMPACT_VERSION || header.chunkSize == 0)
+    {
+        Log::E("Invalid compact file \"%s\", bad header\n", filename.c_str());
+        return false;
+    }
+
+    // numSplats comes straight from the file, so it's bounded by the file size before anything is multiplied by it.
+    const size_t payloadSize = mappedFile.GetSize() - sizeof(CompactHeader);
+    if (header.numSplats > payloadSize / sizeof(CompactSplat))
+    {
+        Log::E("Invalid compact file \"%s\", too many splats for its size\n", filename.c_str());
+        return false;
+    }
+
+    const size_t numSplats = (size_t)header.numSplats;
+    const size_t numChunks = (numSplats + header.chunkSize - 1) / header.chunkSize;
+    const size_t chunksOffset = sizeof(CompactHeader);
+    const size_t splatsOffset = chunksOffset + numChunks * sizeof(CompactChunk);
+    if (numChunks != header.numChunks || payloadSize != numChunks * sizeof(CompactChunk) + numSplats * sizeof(CompactSplat))
+    {
+        Log::E("Invalid compact file \"%s\", unexpected size\n", filename.c_str());
+        return false;
+    }
+
+    mappedFile.AdviseSequential(chunksOffset, mappedFile.GetSize() - chunksOffset);
+    const uint8_t* chunkData = mappedFile.GetData() + chunksOffset;
+    const CompactSplat* splats = reinterpret_cast<const CompactSplat*>(mappedFile.GetData() + splatsOffset);
+
+    size_t oldSize = gaussianVec.size();
+    gaussianVec.resize(oldSize + numSplats);
+    shDegree = 3;
+    Gaussian* out = gaussianVec.data() + oldSize;
+    const size_t chunkSize = header.chunkSize;
+    ParallelFor(numChunks, 1, [chunkData, splats, out, chunkSize, numSplats](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
+        {
+            // the chunk table isn't necessarily aligned, so copy each entry out.
+            CompactChunk chunk;
+            memcpy(&chunk, chunkData + c * sizeof(CompactChunk), sizeof(CompactChunk));
+            size_t first = c * chunkSize;
+            DecodeChunk(chunk, splats + first, std::min(chunkSize, numSplats - first), out + first);
+        }
+    });
+
+    return true;
+}
+
+bool GaussianCloud::ExportCompact(const std::string& filename) const
+{
+    std::ofstream compactFile(filename, std::ios::binary);
+    if (!compactFile.is_open())
+    {
+        Log::E("failed to open %s\n", filename.c_str());
+        return false;
+    }
+
+    const size_t numSplats = size();
+    const size_t numChunks = (numSplats + COMPACT_CHUNK_SIZE - 1) / COMPACT_CHUNK_SIZE;
+    CompactHeader header;
+    header.magic = COMPACT_MAGIC;
+    header.version = COMPACT_VERSION;
+    header.numSplats = numSplats;
+    header.chunkSize = COMPACT_CHUNK_SIZE;
+    header.numChunks = (uint32_t)numChunks;
+
+    std::vector<CompactChunk> chunkVec(numChunks);
+    std::vector<CompactSplat> splatVec(numSplats);
+    ParallelFor(numChunks, 1, [this, numSplats, &chunkVec, &splatVec](size_t begin, size_t end)
+    {
+        std::vector<Gaussian> tempVec;
+        for (size_t c = begin; c < end; c++)
+        {
+            size_t first = c * COMPACT_CHUNK_SIZE;
+            size_t count = std::min((size_t)COMPACT_CHUNK_SIZE, numSplats - first);
+            const Gaussian* chunk = nullptr;
+            if (isSoA)
+            {
+                tempVec.resize(count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    GetGaussian(first + i, tempVec[i]);
+                }
+                chunk = tempVec.data();
+            }
+            else
+            {
+                chunk = gaussianVec.data() + first;
+            }
+            EncodeChunk(chunk, count, chunkVec[c], splatVec.data() + first);
+        }
+    });
+
+    compactFile.write((const char*)&header, sizeof(CompactHeader));
+    compactFile.write((const char*)chunkVec.data(), chunkVec.size() * sizeof(CompactChunk));
+    compactFile.write((const char*)splatVec.data(), splatVec.size() * sizeof(CompactSplat));
+    if (!compactFile)
+    {
+        Log::E("failed to write %s\n", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void AccumulateError(GaussianCloud::AttributeError& error, float value)
+{
+    error.max = std::max(error.max, value);
+    error.mean += value;
+}
+
+bool GaussianCloud::ComputeError(const GaussianCloud& a, const GaussianCloud& b, ErrorReport& reportOut)
+{
+    if (a.size() != b.size())
     {
-        plyFile.write((char*)&g, GAUSSIAN_SIZE);
+        Log::E("ComputeError: clouds have different sizes, %zu and %zu\n", a.size(), b.size());
+        return false;
+    }
+
+    reportOut = ErrorReport();
+    Gaussian ga, gb;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        a.GetGaussian(i, ga);
+        b.GetGaussian(i, gb);
+
+        glm::vec3 pa(ga.position[0], ga.position[1], ga.position[2]);
+        glm::vec3 pb(gb.position[0], gb.position[1], gb.position[2]);
+        AccumulateError(reportOut.position, glm::distance(pa, pb));
+
+        glm::vec4 qa = glm::normalize(glm::vec4(ga.rot[0], ga.rot[1], ga.rot[2], ga.rot[3]));
+        glm::vec4 qb = glm::normalize(glm::vec4(gb.rot[0], gb.rot[1], gb.rot[2], gb.rot[3]));
+        float cosHalfAngle = glm::clamp(fabsf(glm::dot(qa, qb)), 0.0f, 1.0f);
+        AccumulateError(reportOut.rotation, glm::degrees(2.0f * acosf(cosHalfAngle)));
+
+        float alphaA = 1.0f / (1.0f + expf(-ga.opacity));
+        float alphaB = 1.0f / (1.0f + expf(-gb.opacity));
+        AccumulateError(reportOut.alpha, fabsf(alphaA - alphaB));
+
+        float scaleError = 0.0f, dcError = 0.0f;
+        for (int j = 0; j < 3; j++)
+        {
+            scaleError = std::max(scaleError, fabsf(ga.scale[j] - gb.scale[j]));
+            dcError = std::max(dcError, fabsf(ga.f_dc[j] - gb.f_dc[j]));
+        }
+        AccumulateError(reportOut.scale, scaleError);
+        AccumulateError(reportOut.f_dc, dcError);
+
+        float restError = 0.0f;
+        for (int j = 0; j < 45; j++)
+        {
+            restError = std::max(restError, fabsf(ga.f_rest[j] - gb.f_rest[j]));
+        }
+        AccumulateError(reportOut.f_rest, restError);
     }
 
+    if (a.size() > 0)
+    {
+        const float n = (float)a.size();
+        reportOut.position.mean /= n;
+        reportOut.scale.mean /= n;
+        reportOut.rotation.mean /= n;
+        reportOut.alpha.mean /= n;
+        reportOut.f_dc.mean /= n;
+        reportOut.f_rest.mean /= n;
+    }
     return true;
 }
 
+void GaussianCloud::PrintErrorReport(const ErrorReport& report)
+{
+    fprintf(stdout, "    attribute       max          mean\n");
+    fprintf(stdout, "    position        %-12g %g\n", report.position.max, report.position.mean);
+    fprintf(stdout, "    log(scale)      %-12g %g\n", report.scale.max, report.scale.mean);
+    fprintf(stdout, "    rotation (deg)  %-12g %g\n", report.rotation.max, report.rotation.mean);
+    fprintf(stdout, "    alpha           %-12g %g\n", report.alpha.max, report.alpha.mean);
+    fprintf(stdout, "    f_dc            %-12g %g\n", report.f_dc.max, report.f_dc.mean);
+    fprintf(stdout, "    f_rest          %-12g %g\n", report.f_rest.max, report.f_rest.mean);
+}
+
 void GaussianCloud::InitDebugCloud()
 {
     gaussianVec.clear();
+    soa = SoA();
+    soa.numRestPerChannel = 0;
+    isSoA = false;
+
+    // the debug cloud has no view dependent color
+    shDegree = 0;
 
     //
     // make an debug GaussianClound, that contain red, green and blue axes.
@@ -386,18 +1176,17 @@ void GaussianCloud::InitDebugCloud()
 // only keep the nearest splats
 void GaussianCloud::PruneSplats(const glm::vec3& origin, uint32_t numSplats)
 {
-    if (static_cast<size_t>(numSplats) >= gaussianVec.size())
+    if (static_cast<size_t>(numSplats) >= size())
     {
         return;
     }
 
     using IndexDistPair = std::pair<uint32_t, float>;
     std::vector<IndexDistPair> indexDistVec;
-    indexDistVec.reserve(gaussianVec.size());
-    for (uint32_t i = 0; i < gaussianVec.size(); i++)
+    indexDistVec.reserve(size());
+    for (uint32_t i = 0; i < size(); i++)
     {
-        glm::vec3 pos(gaussianVec[i].position[0], gaussianVec[i].position[1], gaussianVec[i].position[2]);
-        indexDistVec.push_back(IndexDistPair(i, glm::distance(origin, pos)));
+        indexDistVec.push_back(IndexDistPair(i, glm::distance(origin, GetPosition(i))));
     }
 
     std::sort(indexDistVec.begin(), indexDistVec.end(), [](const IndexDistPair& a, const IndexDistPair& b)
@@ -405,12 +1194,234 @@ void GaussianCloud::PruneSplats(const glm::vec3& origin, uint32_t numSplats)
         return a.second < b.second;
     });
 
-    std::vector<Gaussian> newGaussianVec;
-    newGaussianVec.reserve(numSplats);
+    std::vector<uint32_t> indexVec;
+    indexVec.reserve(numSplats);
     for (uint32_t i = 0; i < numSplats; i++)
     {
-        newGaussianVec.push_back(gaussianVec[indexDistVec[i].first]);
+        indexVec.push_back(indexDistVec[i].first);
+    }
+    KeepSplats(indexVec);
+}
+
+// spreads the low 10 bits of x out to every third bit
+static uint32_t ExpandBits10(uint32_t x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+bool GaussianCloud::SortByMortonOrder()
+{
+    const size_t numSplats = size();
+    if (numSplats == 0)
+    {
+        return false;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // bounds of each partition, then of the whole cloud
+    const size_t MIN_RANGE_SIZE = 16384;
+    const size_t numPartitions = std::max((size_t)1, std::min((numSplats + MIN_RANGE_SIZE - 1) / MIN_RANGE_SIZE, (size_t)GetDefaultNumThreads()));
+    const size_t partitionSize = (numSplats + numPartitions - 1) / numPartitions;
+    std::vector<glm::vec3> minVec(numPartitions, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> maxVec(numPartitions, glm::vec3(-std::numeric_limits<float>::max()));
+    ParallelFor(numPartitions, 1, [&](size_t partBegin, size_t partEnd)
+    {
+        for (size_t p = partBegin; p < partEnd; p++)
+        {
+            const size_t end = std::min(numSplats, (p + 1) * partitionSize);
+            for (size_t i = p * partitionSize; i < end; i++)
+            {
+                glm::vec3 pos = GetPosition(i);
+                minVec[p] = glm::min(minVec[p], pos);
+                maxVec[p] = glm::max(maxVec[p], pos);
+            }
+        }
+    });
+    glm::vec3 boundsMin = minVec[0];
+    glm::vec3 boundsMax = maxVec[0];
+    for (size_t p = 1; p < numPartitions; p++)
+    {
+        boundsMin = glm::min(boundsMin, minVec[p]);
+        boundsMax = glm::max(boundsMax, maxVec[p]);
+    }
+
+    // 10 bits per axis
+    glm::vec3 scale = 1023.0f / glm::max(boundsMax - boundsMin, glm::vec3(std::numeric_limits<float>::min()));
+    std::vector<uint32_t> keyVec(numSplats);
+    ParallelFor(numSplats, MIN_RANGE_SIZE, [this, &keyVec, &boundsMin, &scale](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            glm::vec3 q = (GetPosition(i) - boundsMin) * scale;
+            keyVec[i] = (ExpandBits10((uint32_t)q.x) << 2) | (ExpandBits10((uint32_t)q.y) << 1) | ExpandBits10((uint32_t)q.z);
+        }
+    });
+
+    // a file that was saved in morton order, see --export-morton, is left as it is
+    if (std::is_sorted(keyVec.begin(), keyVec.end()))
+    {
+        return false;
+    }
+
+    // same parallel radix sort as the cpu depth sort, it's stable, so sorting the result again changes nothing.
+    CpuSorter sorter;
+    sorter.SetKeys(keyVec.data(), numSplats);
+    sorter.Sort(30);
+    KeepSplats(sorter.GetIndexVec());
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    Log::I("GaussianCloud: sorted %d splats into morton order in %.3f sec\n", (int)numSplats, elapsed.count());
+
+    return true;
+}
+
+void GaussianCloud::ConvertToSoA(uint32_t shDegreeIn)
+{
+    if (isSoA)
+    {
+        ConvertToAoS();
+    }
+
+    // the Gaussian record stores the higher order sh coeffs channel by channel, 15 per channel.
+    shDegree = std::min(shDegree, std::min(shDegreeIn, 3u));
+    const uint32_t numRest = NUM_REST_PER_DEGREE[shDegree];
+    const size_t numSplats = gaussianVec.size();
+
+    soa.numRestPerChannel = numRest;
+    soa.positionVec.resize(numSplats);
+    soa.opacityVec.resize(numSplats);
+    soa.scaleVec.resize(numSplats);
+    soa.rotVec.resize(numSplats);
+    soa.f_dcVec.resize(numSplats);
+    soa.f_restVec.resize(numSplats * 3 * numRest);
+
+    const size_t MIN_RANGE_SIZE = 4096;
+    ParallelFor(numSplats, MIN_RANGE_SIZE, [this, numRest](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const Gaussian& g = gaussianVec[i];
+            soa.positionVec[i] = glm::vec3(g.position[0], g.position[1], g.position[2]);
+            soa.opacityVec[i] = g.opacity;
+            soa.scaleVec[i] = glm::vec3(g.scale[0], g.scale[1], g.scale[2]);
+            soa.rotVec[i] = glm::vec4(g.rot[0], g.rot[1], g.rot[2], g.rot[3]);
+            soa.f_dcVec[i] = glm::vec3(g.f_dc[0], g.f_dc[1], g.f_dc[2]);
+            float* rest = soa.f_restVec.data() + i * 3 * numRest;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                for (uint32_t k = 0; k < numRest; k++)
+                {
+                    rest[c * numRest + k] = g.f_rest[c * 15 + k];
+                }
+            }
+        }
+    });
+
+    // release the memory
+    std::vector<Gaussian>().swap(gaussianVec);
+    isSoA = true;
+}
+
+void GaussianCloud::ConvertToAoS()
+{
+    if (!isSoA)
+    {
+        return;
+    }
+
+    const size_t numSplats = size();
+    gaussianVec.resize(numSplats);
+    const size_t MIN_RANGE_SIZE = 4096;
+    ParallelFor(numSplats, MIN_RANGE_SIZE, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            GetGaussian(i, gaussianVec[i]);
+        }
+    });
+
+    soa = SoA();
+    soa.numRestPerChannel = 0;
+    isSoA = false;
+}
+
+glm::vec3 GaussianCloud::GetPosition(size_t i) const
+{
+    if (isSoA)
+    {
+        return soa.positionVec[i];
     }
+    const Gaussian& g = gaussianVec[i];
+    return glm::vec3(g.position[0], g.position[1], g.position[2]);
+}
+
+void GaussianCloud::GetGaussian(size_t i, Gaussian& gaussianOut) const
+{
+    if (!isSoA)
+    {
+        gaussianOut = gaussianVec[i];
+        return;
+    }
+
+    Gaussian& g = gaussianOut;
+    const uint32_t numRest = soa.numRestPerChannel;
+    for (int j = 0; j < 3; j++)
+    {
+        g.position[j] = soa.positionVec[i][j];
+        g.normal[j] = 0.0f;
+        g.f_dc[j] = soa.f_dcVec[i][j];
+        g.scale[j] = soa.scaleVec[i][j];
+    }
+    const float* rest = soa.f_restVec.data() + i * 3 * numRest;
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        for (uint32_t k = 0; k < 15; k++)
+        {
+            g.f_rest[c * 15 + k] = k < numRest ? rest[c * numRest + k] : 0.0f;
+        }
+    }
+    g.opacity = soa.opacityVec[i];
+    for (int j = 0; j < 4; j++)
+    {
+        g.rot[j] = soa.rotVec[i][j];
+    }
+}
+
+template <typename T>
+static void KeepElements(std::vector<T>& vec, const std::vector<uint32_t>& indexVec, size_t stride)
+{
+    std::vector<T> newVec(indexVec.size() * stride);
+    const size_t MIN_RANGE_SIZE = 16384;
+    ParallelFor(indexVec.size(), MIN_RANGE_SIZE, [&vec, &indexVec, &newVec, stride](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            std::copy(vec.begin() + indexVec[i] * stride, vec.begin() + (indexVec[i] + 1) * stride, newVec.begin() + i * stride);
+        }
+    });
+    vec.swap(newVec);
+}
 
-    gaussianVec.swap(newGaussianVec);
+// replaces the cloud with the splats at indexVec, in that order.
+void GaussianCloud::KeepSplats(const std::vector<uint32_t>& indexVec)
+{
+    if (!isSoA)
+    {
+        KeepElements(gaussianVec, indexVec, 1);
+    }
+    else
+    {
+        KeepElements(soa.positionVec, indexVec, 1);
+        KeepElements(soa.opacityVec, indexVec, 1);
+        KeepElements(soa.scaleVec, indexVec, 1);
+        KeepElements(soa.rotVec, indexVec, 1);
+        KeepElements(soa.f_dcVec, indexVec, 1);
+        KeepElements(soa.f_restVec, indexVec, 3 * soa.numRestPerChannel);
+    }
 }
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <cassert>
+#include <functional>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <string>
@@ -15,15 +17,66 @@ class GaussianCloud
 public:
     GaussianCloud();
 
+    struct ImportOptions
+    {
+        // number of threads used to decode vertices, 0 uses all hardware threads.
+        uint32_t numThreads = 0;
+
+        // optional, one transform per ply file, applied to the position, rotation and scale of each splat.
+        // useful for stitching together separately captured tiles.
+        std::vector<glm::mat4> transforms;
+
+        // only sh bands up to this degree are decoded and stored. the degree of each file is detected
+        // from its number of f_rest properties, the cloud uses the highest degree found, up to this limit.
+        uint32_t maxSHDegree = 3;
+
+        // decode directly into structure of arrays storage, see ConvertToSoA().
+        // unlike the Gaussian record, this only allocates memory for the sh bands that are actually used.
+        bool structureOfArrays = false;
+    };
+
     //bool ImportPly(const std::string& plyFilename);
+    // multiple files are loaded concurrently and appended in order.
     bool ImportPly(const std::vector<std::string>& plyFilenames);
+    bool ImportPly(const std::vector<std::string>& plyFilenames, const ImportOptions& options);
     bool ExportPly(const std::string& plyFilename) const;
 
+    // compact quantized format, each splat is 62 bytes instead of 248.
+    // positions, scales and sh coefficients are quantized relative to the bounds of chunks of 256 splats,
+    // rotations use smallest-three packing. normals are not stored.
+    bool ImportCompact(const std::string& filename);
+    bool ExportCompact(const std::string& filename) const;
+
+    struct AttributeError
+    {
+        float max = 0.0f;
+        float mean = 0.0f;
+    };
+
+    // per attribute error between two clouds with the same number of splats, e.g. before and after a compact round trip.
+    struct ErrorReport
+    {
+        AttributeError position;  // distance in world units
+        AttributeError scale;  // difference of log(scale)
+        AttributeError rotation;  // angle in degrees
+        AttributeError alpha;  // difference of 1 / (1 + exp(-opacity))
+        AttributeError f_dc;
+        AttributeError f_rest;
+    };
+    static bool ComputeError(const GaussianCloud& a, const GaussianCloud& b, ErrorReport& reportOut);
+    static void PrintErrorReport(const ErrorReport& report);
+
     void InitDebugCloud();
 
     // only keep the nearest splats
     void PruneSplats(const glm::vec3& origin, uint32_t numSplats);
 
+    // reorders the splats along a morton curve through their bounds, so splats that are near each other in space
+    // are near each other in memory, and every run of consecutive splats covers a small region, see SplatCache::ComputeChunks().
+    // splats drawn next to each other then mostly read neighbouring attributes. the keys are computed and radix sorted
+    // on all threads. returns false if the splats were already in order.
+    bool SortByMortonOrder();
+
     struct Gaussian
     {
         float position[3];  // in world space
@@ -47,11 +100,70 @@ public:
         }
     };
 
-    const std::vector<Gaussian>& GetGaussianVec() const { return gaussianVec; }
-    std::vector<Gaussian>& GetGaussianVec() { return gaussianVec; }
-    size_t size() const { return gaussianVec.size(); }
+    struct StreamOptions
+    {
+        // upper bound on the memory used for the chunk buffers, in bytes.
+        size_t maxMemory = 64 * 1024 * 1024;
+
+        // number of threads used to decode each chunk, 0 uses all hardware threads.
+        uint32_t numThreads = 0;
+    };
+
+    // called once per chunk of decoded splats, firstIndex is the index of chunk[0] within the file.
+    // the chunk is only valid during the callback. return false to stop reading.
+    using ChunkCallback = std::function<bool(const Gaussian* chunk, size_t firstIndex, size_t count)>;
+
+    struct StreamStats
+    {
+        size_t numChunks = 0;
+        // largest total capacity of the read and decode buffers, in bytes. stays within StreamOptions::maxMemory.
+        size_t peakBufferBytes = 0;
+    };
+
+    // decodes a ply in fixed size chunks, so the whole file never has to fit in memory.
+    // useful for feeding a gpu upload, converter or pruner directly from disk.
+    static bool StreamPly(const std::string& plyFilename, const StreamOptions& options, const ChunkCallback& cb,
+                          StreamStats* statsOut = nullptr);
+
+    // only valid in array of structures storage, i.e. !IsSoA()
+    const std::vector<Gaussian>& GetGaussianVec() const { assert(!isSoA); return gaussianVec; }
+    std::vector<Gaussian>& GetGaussianVec() { assert(!isSoA); return gaussianVec; }
+    size_t size() const { return isSoA ? soa.positionVec.size() : gaussianVec.size(); }
+
+    // By default each splat is stored as a 248 byte Gaussian record.
+    // Structure of arrays storage keeps each attribute in its own array instead, so passes that only touch
+    // positions (pruning, bounds, culling, sort prep) don't pull the sh coefficients through the cache.
+    // shDegree (0 - 3) drops the higher sh bands, which saves 36 floats per splat at degree 0.
+    // NOTE: ImportCompact only works on array of structures storage.
+    void ConvertToSoA(uint32_t shDegreeIn);
+    void ConvertToAoS();
+    bool IsSoA() const { return isSoA; }
+
+    // highest sh degree (0 - 3) stored in the cloud, coeffs for higher bands are zero or not stored at all.
+    uint32_t GetSHDegree() const { return shDegree; }
+
+    // accessors, valid for either storage
+    glm::vec3 GetPosition(size_t i) const;
+    void GetGaussian(size_t i, Gaussian& gaussianOut) const;  // dropped sh bands are zero
+
+    // only valid in structure of arrays storage
+    struct SoA
+    {
+        std::vector<glm::vec3> positionVec;
+        std::vector<float> opacityVec;
+        std::vector<glm::vec3> scaleVec;
+        std::vector<glm::vec4> rotVec;  // (real, i, j, k)
+        std::vector<glm::vec3> f_dcVec;
+        std::vector<float> f_restVec;  // 3 * numRestPerChannel floats per splat, r coeffs first then g then b
+        uint32_t numRestPerChannel;  // 0, 3, 8 or 15
+    };
+    const SoA& GetSoA() const { assert(isSoA); return soa; }
 
 protected:
+    void KeepSplats(const std::vector<uint32_t>& indexVec);
 
     std::vector<Gaussian> gaussianVec;
+    SoA soa;
+    uint32_t shDegree;
+    bool isSoA;
 };
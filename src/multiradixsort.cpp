@@ -0,0 +1,138 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "multiradixsort.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "core/log.h"
+#include "core/program.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+// must match multi_radixsort.glsl
+static const uint32_t WORKGROUP_SIZE = 256;
+static const uint32_t RADIX_SORT_BINS = 256;
+
+// layout of the indirect buffer, see sort_args_compute.glsl
+static const size_t DISPATCH_INDIRECT_OFFSET = 0;
+
+MultiRadixSorter::MultiRadixSorter() : maxCount(0), numBlocksPerWorkgroup(1), histogramSize(0)
+{
+}
+
+bool MultiRadixSorter::Init(size_t maxCountIn, uint32_t numBlocksPerWorkgroupIn)
+{
+    GL_ERROR_CHECK("MultiRadixSorter::Init() begin");
+
+    maxCount = maxCountIn;
+
+    sortProg = std::make_shared<Program>();
+    if (!sortProg->LoadCompute("shader/multi_radixsort.glsl"))
+    {
+        Log::E("Error loading sort compute shader!\n");
+        return false;
+    }
+
+    histogramProg = std::make_shared<Program>();
+    if (!histogramProg->LoadCompute("shader/multi_radixsort_histograms.glsl"))
+    {
+        Log::E("Error loading histogram compute shader!\n");
+        return false;
+    }
+
+    SetNumBlocksPerWorkgroup(numBlocksPerWorkgroupIn);
+
+    GL_ERROR_CHECK("MultiRadixSorter::Init() end");
+
+    return true;
+}
+
+bool MultiRadixSorter::IsSupported()
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return GLEW_KHR_shader_subgroup;
+#endif
+}
+
+void MultiRadixSorter::SetNumBlocksPerWorkgroup(uint32_t numBlocksPerWorkgroupIn)
+{
+    numBlocksPerWorkgroup = std::max(numBlocksPerWorkgroupIn, 1u);
+
+    // one histogram per workgroup
+    const size_t numWorkgroups = std::max((maxCount + GetElementsPerWorkgroup() - 1) / GetElementsPerWorkgroup(), (size_t)1);
+    if (numWorkgroups * RADIX_SORT_BINS > histogramSize)
+    {
+        histogramSize = numWorkgroups * RADIX_SORT_BINS;
+        std::vector<uint32_t> histogramVec(histogramSize, 0);
+        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+    }
+}
+
+uint32_t MultiRadixSorter::GetElementsPerWorkgroup() const
+{
+    return numBlocksPerWorkgroup * WORKGROUP_SIZE;
+}
+
+void MultiRadixSorter::Sort(uint32_t keyBuffer, uint32_t keyBuffer2, uint32_t valBuffer, uint32_t valBuffer2,
+                            uint32_t valOutBuffer, uint32_t indirectBuffer, uint32_t numBits)
+{
+    GL_ERROR_CHECK("MultiRadixSorter::Sort() begin");
+
+    const uint32_t numPasses = (std::min(numBits, 32u) + 7) / 8;
+
+    sortProg->Bind();
+    sortProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+
+    histogramProg->Bind();
+    histogramProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, indirectBuffer);
+
+    for (uint32_t i = 0; i < numPasses; i++)
+    {
+        bool even = (i % 2) == 0;
+
+        histogramProg->Bind();
+        histogramProg->SetUniform("g_shift", 8 * i);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, even ? keyBuffer : keyBuffer2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+
+        glDispatchComputeIndirect(DISPATCH_INDIRECT_OFFSET);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        sortProg->Bind();
+        sortProg->SetUniform("g_shift", 8 * i);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, even ? keyBuffer : keyBuffer2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, even ? keyBuffer2 : keyBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, even ? valBuffer : valBuffer2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, (i == numPasses - 1) ? valOutBuffer : (even ? valBuffer2 : valBuffer));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+
+        glDispatchComputeIndirect(DISPATCH_INDIRECT_OFFSET);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    GL_ERROR_CHECK("MultiRadixSorter::Sort() end");
+}
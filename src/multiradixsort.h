@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+
+class BufferObject;
+class Program;
+
+// GPU LSD radix sort of 32 bit keys and values, 8 bits per pass, see multi_radixsort_histograms.glsl and multi_radixsort.glsl.
+// Each pass is a histogram dispatch and a scatter dispatch, and each workgroup handles numBlocksPerWorkgroup blocks of 256 keys.
+// The element count and the dispatch size are read from an indirect buffer laid out like sort_args_compute.glsl's,
+// which must be dispatched with GetElementsPerWorkgroup().
+class MultiRadixSorter
+{
+public:
+    MultiRadixSorter();
+
+    // loads the shaders and allocates histograms for up to maxCountIn keys.
+    bool Init(size_t maxCountIn, uint32_t numBlocksPerWorkgroupIn);
+
+    // needs KHR_shader_subgroup
+    static bool IsSupported();
+
+    // may be changed between sorts, the histograms are reallocated if they have to grow.
+    void SetNumBlocksPerWorkgroup(uint32_t numBlocksPerWorkgroupIn);
+    uint32_t GetNumBlocksPerWorkgroup() const { return numBlocksPerWorkgroup; }
+    uint32_t GetElementsPerWorkgroup() const;
+
+    // sorts the low numBits bits of the keys in keyBuffer and moves the values in valBuffer along with them.
+    // keyBuffer2 and valBuffer2 are scratch, the sorted values are written to valOutBuffer.
+    void Sort(uint32_t keyBuffer, uint32_t keyBuffer2, uint32_t valBuffer, uint32_t valBuffer2,
+              uint32_t valOutBuffer, uint32_t indirectBuffer, uint32_t numBits);
+
+protected:
+    size_t maxCount;
+    uint32_t numBlocksPerWorkgroup;
+    size_t histogramSize;  // in uint32_t
+    std::shared_ptr<Program> histogramProg;
+    std::shared_ptr<Program> sortProg;
+    std::shared_ptr<BufferObject> histogramBuffer;
+};
@@ -0,0 +1,259 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "onesweepsort.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "core/log.h"
+#include "core/program.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+#include "cpusort.h"
+
+// must match onesweep_histogram.glsl and onesweep_scatter.glsl
+static const uint32_t WORKGROUP_SIZE = 256;
+static const uint32_t ITEMS_PER_THREAD = 8;
+static const uint32_t TILE_SIZE = WORKGROUP_SIZE * ITEMS_PER_THREAD;
+static const uint32_t RADIX_BINS = 256;
+static const uint32_t MAX_PASSES = 4;
+
+// layout of the indirect buffer, see sort_args_compute.glsl
+static const size_t DISPATCH_INDIRECT_OFFSET = 0;
+static const size_t INDIRECT_BUFFER_SIZE = 8;  // in uint32_t
+
+// larger inputs are only validated up to this many keys.
+static const size_t MAX_VALIDATE_COUNT = 1 << 20;
+
+// the quick check, see Validate()
+static const size_t QUICK_VALIDATE_COUNT = 64 * TILE_SIZE + 7;
+
+OnesweepSorter::OnesweepSorter() : maxCount(0)
+{
+}
+
+bool OnesweepSorter::Init(size_t maxCountIn)
+{
+    GL_ERROR_CHECK("OnesweepSorter::Init() begin");
+
+    maxCount = maxCountIn;
+
+    histogramProg = std::make_shared<Program>();
+    if (!histogramProg->LoadCompute("shader/onesweep_histogram.glsl"))
+    {
+        Log::E("Error loading onesweep histogram compute shader!\n");
+        return false;
+    }
+
+    scatterProg = std::make_shared<Program>();
+    if (!scatterProg->LoadCompute("shader/onesweep_scatter.glsl"))
+    {
+        Log::E("Error loading onesweep scatter compute shader!\n");
+        return false;
+    }
+
+    const size_t maxTiles = std::max((maxCount + TILE_SIZE - 1) / TILE_SIZE, (size_t)1);
+    zeroHistogramVec.assign(MAX_PASSES * RADIX_BINS, 0);
+    zeroCounterVec.assign(MAX_PASSES, 0);
+    histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroHistogramVec, GL_DYNAMIC_STORAGE_BIT);
+    counterBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroCounterVec, GL_DYNAMIC_STORAGE_BIT);
+    std::vector<uint32_t> statusVec(MAX_PASSES * maxTiles * RADIX_BINS, 0);
+    statusBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, statusVec, 0);
+
+    GL_ERROR_CHECK("OnesweepSorter::Init() end");
+
+    return true;
+}
+
+bool OnesweepSorter::IsSupported()
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return GLEW_VERSION_4_3;
+#endif
+}
+
+uint32_t OnesweepSorter::GetTileSize()
+{
+    return TILE_SIZE;
+}
+
+void OnesweepSorter::Sort(uint32_t keyBuffer, uint32_t keyBuffer2, uint32_t valBuffer, uint32_t valBuffer2,
+                          uint32_t valOutBuffer, uint32_t indirectBuffer, uint32_t numBits)
+{
+    GL_ERROR_CHECK("OnesweepSorter::Sort() begin");
+
+    const uint32_t numPasses = (std::min(numBits, 32u) + 7) / 8;
+
+    histogramBuffer->Update(zeroHistogramVec);
+    counterBuffer->Update(zeroCounterVec);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, indirectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, statusBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, counterBuffer->GetObj());
+
+    histogramProg->Bind();
+    histogramProg->SetUniform("g_num_passes", numPasses);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer);
+    glDispatchComputeIndirect(DISPATCH_INDIRECT_OFFSET);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    GL_ERROR_CHECK("OnesweepSorter::Sort() histogram");
+
+    scatterProg->Bind();
+    for (uint32_t i = 0; i < numPasses; i++)
+    {
+        scatterProg->SetUniform("g_shift", 8 * i);
+        scatterProg->SetUniform("g_pass", i);
+
+        bool even = (i % 2) == 0;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, even ? keyBuffer : keyBuffer2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, even ? keyBuffer2 : keyBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, even ? valBuffer : valBuffer2);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, (i == numPasses - 1) ? valOutBuffer : (even ? valBuffer2 : valBuffer));
+
+        glDispatchComputeIndirect(DISPATCH_INDIRECT_OFFSET);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    GL_ERROR_CHECK("OnesweepSorter::Sort() scatter");
+}
+
+bool OnesweepSorter::Validate(bool thorough)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const size_t largeCount = std::min(maxCount, thorough ? MAX_VALIDATE_COUNT : QUICK_VALIDATE_COUNT);
+    // partial tiles, a single tile, and enough tiles that most of them have to look back.
+    std::vector<size_t> countVec = {1, TILE_SIZE - 1, TILE_SIZE + 1, 10 * TILE_SIZE + 7, largeCount};
+    if (!thorough)
+    {
+        countVec = {largeCount};
+    }
+
+    enum Distribution { Random, AllEqual, Ascending, Descending, FewValues, HighByteOnly, HalfCulled, NumDistributions };
+    const char* DISTRIBUTION_NAMES[] = {"random", "all equal", "ascending", "descending", "few values", "high byte only", "half culled"};
+
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> keyVec(largeCount);
+    std::vector<uint32_t> valVec(largeCount);
+    for (size_t i = 0; i < largeCount; i++)
+    {
+        valVec[i] = (uint32_t)i;
+    }
+
+    // the sort reads the count from here, the buffers are allocated once at the largest size.
+    std::vector<uint32_t> indirectVec(INDIRECT_BUFFER_SIZE, 0);
+    auto indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT);
+    auto keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+    auto keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valOutBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    CpuSorter cpuSorter;
+    std::vector<uint32_t> sortedVec(largeCount);
+    int numSorts = 0;
+
+    auto check = [&](Distribution dist, size_t count, uint32_t numBits)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t r = rng();
+            switch (dist)
+            {
+            case Random: keyVec[i] = r; break;
+            case AllEqual: keyVec[i] = 0x12345678; break;
+            case Ascending: keyVec[i] = (uint32_t)i; break;
+            case Descending: keyVec[i] = (uint32_t)(count - i); break;
+            case FewValues: keyVec[i] = (r % 4) * 0x01010101; break;
+            case HighByteOnly: keyVec[i] = r & 0xff000000; break;
+            case HalfCulled: keyVec[i] = (r & 1) ? 0xffffffff : (r >> 1); break;
+            default: break;
+            }
+        }
+
+        // only the first count keys are sorted, the rest of the buffer is left as is.
+        keyBuffer->Update(keyVec);
+        valBuffer->Update(valVec);
+        const uint32_t numTiles = ((uint32_t)count + TILE_SIZE - 1) / TILE_SIZE;
+        indirectVec = {numTiles, 1, 1, (uint32_t)count, 1, 0, 0, 0};
+        indirectBuffer->Update(indirectVec);
+
+        Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+             valOutBuffer->GetObj(), indirectBuffer->GetObj(), numBits);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        valOutBuffer->Read(sortedVec);
+        numSorts++;
+
+        cpuSorter.SetKeys(keyVec.data(), count);
+        cpuSorter.Sort(numBits);
+        const std::vector<uint32_t>& refVec = cpuSorter.GetIndexVec();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (sortedVec[i] != refVec[i])
+            {
+                Log::W("OnesweepSorter: validation failed, %s keys, count = %d, numBits = %d, first mismatch at %d\n",
+                       DISTRIBUTION_NAMES[dist], (int)count, (int)numBits, (int)i);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    GL_ERROR_CHECK("OnesweepSorter::Validate() begin");
+
+    for (size_t count : countVec)
+    {
+        if (count == 0 || count > largeCount)
+        {
+            continue;
+        }
+        if (!thorough)
+        {
+            if (!check(Random, count, 32))
+            {
+                return false;
+            }
+            continue;
+        }
+        for (int dist = 0; dist < NumDistributions; dist++)
+        {
+            if (!check((Distribution)dist, count, 32))
+            {
+                return false;
+            }
+        }
+        // fewer passes, the high bits must be ignored
+        if (!check(Random, count, 16) || !check(Random, count, 24))
+        {
+            return false;
+        }
+    }
+
+    GL_ERROR_CHECK("OnesweepSorter::Validate() end");
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    Log::I("OnesweepSorter: validated %d sorts of up to %d keys in %.3f sec\n", numSorts, (int)largeCount, elapsed.count());
+
+    return true;
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+class BufferObject;
+class Program;
+
+// GPU LSD radix sort of 32 bit keys and values, 8 bits per pass, see onesweep_histogram.glsl and onesweep_scatter.glsl.
+// The digit counts of every pass are taken in a single read of the keys up front, after that each pass is one dispatch,
+// which finds where its tiles go with a decoupled look-back, instead of a histogram and a scatter dispatch per pass.
+// The element count and the dispatch size are read from an indirect buffer laid out like sort_args_compute.glsl's,
+// which must be dispatched with GetTileSize() keys per workgroup.
+class OnesweepSorter
+{
+public:
+    OnesweepSorter();
+
+    // loads the shaders and allocates scratch for up to maxCountIn keys.
+    bool Init(size_t maxCountIn);
+
+    // needs compute shaders and shader storage buffers, but not subgroups.
+    // always false on android, the look-back hasn't been tried on mobile gpus.
+    static bool IsSupported();
+
+    // keys per workgroup
+    static uint32_t GetTileSize();
+
+    // sorts the low numBits bits of the keys in keyBuffer and moves the values in valBuffer along with them.
+    // keyBuffer2 and valBuffer2 are scratch, the sorted values are written to valOutBuffer.
+    void Sort(uint32_t keyBuffer, uint32_t keyBuffer2, uint32_t valBuffer, uint32_t valBuffer2,
+              uint32_t valOutBuffer, uint32_t indirectBuffer, uint32_t numBits);
+
+    // sorts random and adversarial keys and compares the results with CpuSorter, which is also stable,
+    // so both must produce exactly the same order. the look-back depends on the driver scheduling earlier workgroups
+    // before later ones, this checks that it does. returns false on the first mismatch.
+    // the full check takes a while, it's run by sortbench and SortTuner, whose result is kept in the sort profile.
+    // with thorough false, only one sort of random keys over enough tiles to need the look-back is checked,
+    // which is cheap enough for startup.
+    bool Validate(bool thorough = true);
+
+protected:
+    size_t maxCount;
+    std::shared_ptr<Program> histogramProg;
+    std::shared_ptr<Program> scatterProg;
+    std::shared_ptr<BufferObject> histogramBuffer;
+    std::shared_ptr<BufferObject> statusBuffer;
+    std::shared_ptr<BufferObject> counterBuffer;
+    std::vector<uint32_t> zeroHistogramVec;
+    std::vector<uint32_t> zeroCounterVec;
+};
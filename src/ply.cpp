@@ -5,6 +5,7 @@
 
 #include "ply.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -30,7 +31,11 @@ static bool GetNextPlyLine(std::ifstream& plyFile, std::string& lineOut)
     return false;
 }
 
-bool Ply::Parse(std::ifstream& plyFile)
+Ply::Ply() : vertexData(nullptr), vertexCount(0), vertexSize(0), chunkCursor(0)
+{
+}
+
+bool Ply::ParseHeader(std::ifstream& plyFile)
 {
     // validate start of header
     std::string token1, token2, token3;
@@ -152,13 +157,98 @@ bool Ply::Parse(std::ifstream& plyFile)
 
     vertexSize = offset;
 
+    return true;
+}
+
+bool Ply::Parse(std::ifstream& plyFile)
+{
+    if (!ParseHeader(plyFile))
+    {
+        return false;
+    }
+
     // read rest of file into dataVec
     dataVec.resize(vertexSize * vertexCount);
     plyFile.read((char*)dataVec.data(), vertexSize * vertexCount);
+    vertexData = dataVec.data();
+
+    return true;
+}
+
+bool Ply::ParseMapped(const std::string& plyFilename)
+{
+    size_t headerSize = 0;
+    {
+        std::ifstream plyFile(plyFilename, std::ios::binary);
+        if (!plyFile.is_open())
+        {
+            Log::E("failed to open \"%s\"\n", plyFilename.c_str());
+            return false;
+        }
+
+        if (!ParseHeader(plyFile))
+        {
+            return false;
+        }
+        headerSize = (size_t)plyFile.tellg();
+    }
+
+    if (!mappedFile.Open(plyFilename))
+    {
+        return false;
+    }
+
+    const size_t dataSize = vertexSize * vertexCount;
+    if (mappedFile.GetSize() < headerSize + dataSize)
+    {
+        Log::E("Invalid ply file, expected %zu bytes of vertex data, found %zu\n", dataSize,
+               mappedFile.GetSize() - headerSize);
+        mappedFile.Close();
+        return false;
+    }
+
+    mappedFile.AdviseSequential(headerSize, dataSize);
+    vertexData = mappedFile.GetData() + headerSize;
 
     return true;
 }
 
+bool Ply::ParseChunked(std::ifstream& plyFile)
+{
+    if (!ParseHeader(plyFile))
+    {
+        return false;
+    }
+
+    vertexData = nullptr;
+    chunkCursor = 0;
+    return true;
+}
+
+bool Ply::ReadChunk(std::ifstream& plyFile, size_t maxVertices, size_t& numVerticesOut)
+{
+    assert(maxVertices > 0);
+    numVerticesOut = std::min(maxVertices, vertexCount - chunkCursor);
+    if (numVerticesOut == 0)
+    {
+        return true;
+    }
+
+    // resize never shrinks the capacity, so after the first chunk no more allocations occur.
+    dataVec.resize(numVerticesOut * vertexSize);
+    plyFile.read((char*)dataVec.data(), numVerticesOut * vertexSize);
+    if ((size_t)plyFile.gcount() != numVerticesOut * vertexSize)
+    {
+        Log::E("Invalid ply file, unexpected end of file after vertex %zu\n", chunkCursor);
+        numVerticesOut = 0;
+        return false;
+    }
+
+    vertexData = dataVec.data();
+    chunkCursor += numVerticesOut;
+    return true;
+}
+
 bool Ply::GetProperty(const std::string& key, Ply::Property& propertyOut) const
 {
     auto iter = propertyMap.find(key);
@@ -170,10 +260,36 @@ bool Ply::GetProperty(const std::string& key, Ply::Property& propertyOut) const
     return false;
 }
 
-void Ply::ForEachVertex(const VertexCallback& cb)
+bool Ply::HasExactLayout(const std::vector<std::string>& propertyNames, Type type) const
+{
+    if (propertyNames.size() != propertyMap.size())
+    {
+        return false;
+    }
+
+    size_t offset = 0;
+    for (auto&& name : propertyNames)
+    {
+        auto iter = propertyMap.find(name);
+        if (iter == propertyMap.end() || iter->second.type != type || iter->second.offset != offset)
+        {
+            return false;
+        }
+        offset += iter->second.size;
+    }
+    return offset == vertexSize;
+}
+
+void Ply::ForEachVertex(const VertexCallback& cb) const
+{
+    ForEachVertexRange(0, vertexCount, cb);
+}
+
+void Ply::ForEachVertexRange(size_t begin, size_t end, const VertexCallback& cb) const
 {
-    const uint8_t* vertexPtr = dataVec.data();
-    for (size_t i = 0; i < vertexCount; i++)
+    assert(begin <= end && end <= vertexCount);
+    const uint8_t* vertexPtr = vertexData + begin * vertexSize;
+    for (size_t i = begin; i < end; i++)
     {
         cb(vertexPtr, vertexSize);
         vertexPtr += vertexSize;
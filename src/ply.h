@@ -11,11 +11,29 @@
 #include <unordered_map>
 #include <vector>
 
+#include "core/mappedfile.h"
+
 class Ply
 {
 public:
+    Ply();
+
+    // reads the header and copies the entire vertex payload into memory.
     bool Parse(std::ifstream& plyFile);
 
+    // reads the header, then memory maps the file, vertex data is never copied.
+    // ForEachVertex walks the mapped file directly, so the Ply must outlive any use of the vertex data.
+    bool ParseMapped(const std::string& plyFilename);
+
+    // streaming alternative to Parse, for files that don't fit in memory.
+    // reads only the header, the vertex payload is then pulled in with ReadChunk.
+    bool ParseChunked(std::ifstream& plyFile);
+
+    // reads up to maxVertices of the next vertices into an internal buffer, which is reused by every call.
+    // afterwards ForEachVertexRange() and GetVertexData() index into this chunk, starting at 0.
+    // numVerticesOut is set to 0 once all vertices have been read. returns false on a short read.
+    bool ReadChunk(std::ifstream& plyFile, size_t maxVertices, size_t& numVerticesOut);
+
     enum class Type
     {
         Unknown,
@@ -55,14 +73,34 @@ public:
 
     bool GetProperty(const std::string& key, Property& propertyOut) const;
 
+    // returns true if each vertex consists of exactly these properties, in this order, all of the given type.
+    // in that case vertices are tightly packed records, that can be copied directly into a matching struct.
+    bool HasExactLayout(const std::vector<std::string>& propertyNames, Type type) const;
+
     using VertexCallback = std::function<void(const uint8_t*, size_t)>;
-    void ForEachVertex(const VertexCallback& cb);
+    void ForEachVertex(const VertexCallback& cb) const;
+
+    // only visits vertices in the range [begin, end).
+    // does not modify the Ply, so it is safe to call concurrently on disjoint ranges from multiple threads.
+    void ForEachVertexRange(size_t begin, size_t end, const VertexCallback& cb) const;
 
     size_t GetVertexCount() const { return vertexCount; }
+    size_t GetVertexSize() const { return vertexSize; }
+
+    // pointer to the first byte of vertex i, vertices are GetVertexSize() bytes apart.
+    const uint8_t* GetVertexData(size_t i) const { return vertexData + i * vertexSize; }
+
+    // bytes allocated for the vertex data copied by Parse or ReadChunk, none when memory mapped.
+    size_t GetDataCapacity() const { return dataVec.capacity(); }
 
 protected:
+    bool ParseHeader(std::ifstream& plyFile);
+
     std::unordered_map<std::string, Property> propertyMap;
     std::vector<uint8_t> dataVec;
+    MappedFile mappedFile;
+    const uint8_t* vertexData;
     size_t vertexCount;
     size_t vertexSize;
+    size_t chunkCursor;
 };
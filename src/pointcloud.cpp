@@ -12,6 +12,7 @@
 #include <string>
 
 #include "core/log.h"
+#include "core/parallelfor.h"
 #include "ply.h"
 
 PointCloud::PointCloud()
@@ -89,15 +90,8 @@ bool PointCloud::ImportPly(const std::vector<std::string>& plyFilenames)
 {
     for (const auto& plyFilename : plyFilenames)
     {
-        std::ifstream plyFile(plyFilename, std::ios::binary);
-        if (!plyFile.is_open())
-        {
-            Log::E("failed to open \"%s\"\n", plyFilename.c_str());
-            return false;
-        }
-
         Ply ply;
-        if (!ply.Parse(plyFile))
+        if (!ply.ParseMapped(plyFilename))
         {
             Log::E("Error parsing ply file \"%s\"\n", plyFilename.c_str());
             return false;
@@ -124,20 +118,38 @@ bool PointCloud::ImportPly(const std::vector<std::string>& plyFilenames)
         size_t oldSize = pointVec.size();
         pointVec.resize(oldSize + ply.GetVertexCount());
 
-        if (useDoubles)
+        // each range decodes into its own disjoint slice of pointVec, so no locking is needed.
+        const size_t MIN_RANGE_SIZE = 16384;
+        ParallelFor(ply.GetVertexCount(), MIN_RANGE_SIZE, [this, &ply, &props, oldSize, useDoubles](size_t begin, size_t end)
         {
-            int i = oldSize;
-            ply.ForEachVertex([this, &i, &props](const uint8_t* data, size_t size)
+            size_t i = oldSize + begin;
+            if (useDoubles)
             {
-                pointVec[i].position[0] = (float)props.x.Get<double>(data);
-                pointVec[i].position[1] = (float)props.y.Get<double>(data);
-                pointVec[i].position[2] = (float)props.z.Get<double>(data);
-                pointVec[i].color[0] = props.red.Get<uint8_t>(data);
-                pointVec[i].color[1] = props.green.Get<uint8_t>(data);
-                pointVec[i].color[2] = props.blue.Get<uint8_t>(data);
-                i++;
-            });
-        }
+                ply.ForEachVertexRange(begin, end, [this, &i, &props](const uint8_t* data, size_t size)
+                {
+                    pointVec[i].position[0] = (float)props.x.Get<double>(data);
+                    pointVec[i].position[1] = (float)props.y.Get<double>(data);
+                    pointVec[i].position[2] = (float)props.z.Get<double>(data);
+                    pointVec[i].color[0] = props.red.Get<uint8_t>(data);
+                    pointVec[i].color[1] = props.green.Get<uint8_t>(data);
+                    pointVec[i].color[2] = props.blue.Get<uint8_t>(data);
+                    i++;
+                });
+            }
+            else
+            {
+                ply.ForEachVertexRange(begin, end, [this, &i, &props](const uint8_t* data, size_t size)
+                {
+                    pointVec[i].position[0] = props.x.Get<float>(data);
+                    pointVec[i].position[1] = props.y.Get<float>(data);
+                    pointVec[i].position[2] = props.z.Get<float>(data);
+                    pointVec[i].color[0] = props.red.Get<uint8_t>(data);
+                    pointVec[i].color[1] = props.green.Get<uint8_t>(data);
+                    pointVec[i].color[2] = props.blue.Get<uint8_t>(data);
+                    i++;
+                });
+            }
+        });
     }
 
     return true;
@@ -31,6 +31,10 @@
 
 #include "radix_sort.hpp"
 
+// layout of indirectBuffer, see sort_args_compute.glsl
+static const size_t DRAW_INDIRECT_OFFSET = 3 * sizeof(uint32_t);
+static const size_t INDIRECT_BUFFER_SIZE = 12;  // in uint32_t
+
 PointRenderer::PointRenderer()
 {
 }
@@ -64,22 +68,33 @@ bool PointRenderer::Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebuf
     }
 
     preSortProg = std::make_shared<Program>();
+    // rgc::radix_sort needs the number of elements on the cpu, so it sorts every point, with the culled ones last.
+    preSortProg->AddMacro("DEFINES", "#define KEEP_CULLED\n");
     if (!preSortProg->LoadCompute("./shader/presort_compute.glsl"))
     {
         Log::E("Error loading point pre-sort compute shader!\n");
         return false;
     }
 
+    sortArgsProg = std::make_shared<Program>();
+    if (!sortArgsProg->LoadCompute("./shader/sort_args_compute.glsl"))
+    {
+        Log::E("Error loading point sort args compute shader!\n");
+        return false;
+    }
+
     BuildVertexArrayObject(pointCloud);
 
     depthVec.resize(pointCloud->size());
     keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-    valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
     posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
     sorter = std::make_shared<rgc::radix_sort::sorter>(pointCloud->size());
 
     atomicCounterVec.resize(1, 0);
-    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT);
+
+    std::vector<uint32_t> indirectVec(INDIRECT_BUFFER_SIZE, 0);
+    indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT);
 
     GL_ERROR_CHECK("PointRenderer::Init() end");
 
@@ -96,11 +111,17 @@ void PointRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
     const size_t numPoints = posVec.size();
     glm::mat4 modelViewMat = glm::inverse(cameraMat);
 
+    // the sorted indices are written straight into the element buffer, so they don't have to be copied afterwards.
+    GLuint elementBuffer = pointVao->GetElementBuffer()->GetObj();
+
     {
         ZoneScopedNC("pre-sort", tracy::Color::Red4);
 
         preSortProg->Bind();
         preSortProg->SetUniform("modelViewProj", projMat * modelViewMat);
+        preSortProg->SetUniform("depthRange", glm::vec2(0.0f, 1.0f / nearFar.y));
+        // with KEEP_CULLED the max key is reserved for culled points
+        preSortProg->SetUniform("keyMax", std::numeric_limits<uint32_t>::max() - 1);
 
         glm::mat4 modelViewProjMat = projMat * modelViewMat;
 
@@ -110,7 +131,7 @@ void PointRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, elementBuffer);
         glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
 
         const int LOCAL_SIZE = 256;
@@ -120,36 +141,33 @@ void PointRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
         GL_ERROR_CHECK("PointRenderer::Render() pre-sort");
     }
 
-    uint32_t sortCount = 0;
     {
-        ZoneScopedNC("get-count", tracy::Color::Green);
+        // the visible count stays on the gpu, it's turned into the indirect draw command used below.
+        // reading it back here would stall until the pre-sort has finished.
+        ZoneScopedNC("sort-args", tracy::Color::Green);
 
-        atomicCounterBuffer->Read(atomicCounterVec);
-        sortCount = atomicCounterVec[0];
+        sortArgsProg->Bind();
+        sortArgsProg->SetUniform("numElementsPerWorkgroup", 1u);
+        sortArgsProg->SetUniform("maxCount", (uint32_t)numPoints);
 
-        assert(sortCount <= (uint32_t)numPoints);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomicCounterBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer->GetObj());  // writeonly
 
-        GL_ERROR_CHECK("PointRenderer::Render() get-count");
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        GL_ERROR_CHECK("PointRenderer::Render() sort-args");
     }
 
     {
         ZoneScopedNC("sort", tracy::Color::Red4);
 
-        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), sortCount);
+        sorter->sort(keyBuffer->GetObj(), elementBuffer, numPoints);
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT);
 
         GL_ERROR_CHECK("PointRenderer::Render() sort");
     }
 
-    {
-        ZoneScopedNC("copy-sorted", tracy::Color::DarkGreen);
-
-        glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
-        glBindBuffer(GL_COPY_WRITE_BUFFER, pointVao->GetElementBuffer()->GetObj());
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sortCount * sizeof(uint32_t));
-
-        GL_ERROR_CHECK("PointRenderer::Render() copy-sorted");
-    }
-
     {
         ZoneScopedNC("draw", tracy::Color::Red4);
 
@@ -169,7 +187,9 @@ void PointRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
         pointProg->SetUniform("colorTex", 0);
 
         pointVao->Bind();
-        glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->GetObj());
+        glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, (const void*)DRAW_INDIRECT_OFFSET);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
         pointVao->Unbind();
 
         GL_ERROR_CHECK("PointRenderer::Render() draw");
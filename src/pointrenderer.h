@@ -38,6 +38,7 @@ protected:
     std::shared_ptr<Texture> pointTex;
     std::shared_ptr<Program> pointProg;
     std::shared_ptr<Program> preSortProg;
+    std::shared_ptr<Program> sortArgsProg;
     std::shared_ptr<VertexArrayObject> pointVao;
 
     std::vector<uint32_t> indexVec;
@@ -46,9 +47,9 @@ protected:
     std::vector<uint32_t> atomicCounterVec;
 
     std::shared_ptr<BufferObject> keyBuffer;
-    std::shared_ptr<BufferObject> valBuffer;
     std::shared_ptr<BufferObject> posBuffer;
     std::shared_ptr<BufferObject> atomicCounterBuffer;
+    std::shared_ptr<BufferObject> indirectBuffer;  // draw command, see sort_args_compute.glsl
 
     std::shared_ptr<rgc::radix_sort::sorter> sorter;
     bool isFramebufferSRGBEnabled;
@@ -0,0 +1,138 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "shcolorcache.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef __ANDROID__
+//#include <tracy/Tracy.hpp>
+#include <Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include "core/log.h"
+#include "core/program.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+// must match sh_color_compute.glsl
+static const uint32_t LOCAL_SIZE = 256;
+
+SHColorCache::SHColorCache() : numSplats(0), recomputeAll(true), phase(0), recomputeFraction(0.0f), countFence(nullptr)
+{
+}
+
+SHColorCache::~SHColorCache()
+{
+    if (countFence)
+    {
+        glDeleteSync((GLsync)countFence);
+    }
+}
+
+bool SHColorCache::Init(size_t numSplatsIn, const std::string& defines, const std::string& shEval)
+{
+    GL_ERROR_CHECK("SHColorCache::Init() begin");
+
+    numSplats = numSplatsIn;
+    recomputeAll = true;
+    phase = 0;
+
+    colorProg = std::make_shared<Program>();
+    colorProg->AddMacro("DEFINES", defines);
+    colorProg->AddMacro("SH_EVAL", shEval);
+    if (!colorProg->LoadCompute("./shader/sh_color_compute.glsl"))
+    {
+        Log::E("Error loading sh color compute shader!\n");
+        return false;
+    }
+
+    std::vector<uint32_t> zeroVec(numSplats * 2, 0);
+    colorBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+    zeroVec.resize(numSplats);
+    dirBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+
+    countVec.resize(1, 0);
+    countBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, countVec, GL_DYNAMIC_STORAGE_BIT);
+    readbackBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, countVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    GL_ERROR_CHECK("SHColorCache::Init() end");
+
+    return true;
+}
+
+void SHColorCache::Update(uint32_t splatBuffer, const glm::vec3& eye)
+{
+    ZoneScopedNC("sh-colors", tracy::Color::Red4);
+
+    ReadRecomputeCount();
+
+    uint32_t phases = std::max(numPhases, 1u);
+    phase = (phase + 1) % phases;
+
+    countVec[0] = 0;
+    countBuffer->Update(countVec);
+
+    colorProg->Bind();
+    colorProg->SetUniform("eye", eye);
+    colorProg->SetUniform("cosTolerance", cosf(angularTolerance));
+    colorProg->SetUniform("numPhases", phases);
+    colorProg->SetUniform("phase", phase);
+    colorProg->SetUniform("recomputeAll", (int32_t)recomputeAll);
+    recomputeAll = false;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer);  // readonly
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, colorBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, dirBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, countBuffer->GetObj());
+
+    glDispatchCompute(((GLuint)numSplats + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // keep a copy of the count, which is read back once this update is done, see ReadRecomputeCount()
+    if (!countFence)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, countBuffer->GetObj());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer->GetObj());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GL_ERROR_CHECK("SHColorCache::Update()");
+}
+
+uint32_t SHColorCache::GetColorBuffer() const
+{
+    return colorBuffer->GetObj();
+}
+
+void SHColorCache::ReadRecomputeCount()
+{
+    if (!countFence || glClientWaitSync((GLsync)countFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        return;
+    }
+    glDeleteSync((GLsync)countFence);
+    countFence = nullptr;
+
+    readbackBuffer->Read(countVec);
+    recomputeFraction = numSplats ? (float)countVec[0] / (float)numSplats : 0.0f;
+}
@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class BufferObject;
+class Program;
+
+// The view dependent color of every splat, evaluated from its SH coefficients by sh_color_compute.glsl,
+// so the render shaders read 8 bytes per splat instead of up to 48 coefficients, and skip the SH math.
+// The color only depends on the direction from the eye to the splat, so turning the camera never changes it,
+// and a color is only evaluated again once that direction has turned by more than angularTolerance.
+// Moving the camera mostly refreshes the near splats, the distant ones barely turn.
+class SHColorCache
+{
+public:
+    SHColorCache();
+    ~SHColorCache();
+
+    // defines must give SH_DEGREE and the layout of the interleaved splat buffer, see sh_color_compute.glsl.
+    // shEval is the source of sh_eval.glsl.
+    bool Init(size_t numSplatsIn, const std::string& defines, const std::string& shEval);
+
+    // splatBuffer is the interleaved splat buffer. the first update after Init() evaluates every color.
+    void Update(uint32_t splatBuffer, const glm::vec3& eye);
+
+    // (r, g) and (b, 0) as pairs of halfs, one uvec2 per splat
+    uint32_t GetColorBuffer() const;
+
+    // colors evaluated by the most recent update that has been read back, over the number of splats
+    float GetRecomputeFraction() const { return recomputeFraction; }
+
+    float angularTolerance = 0.01f;  // radians, about half a degree
+
+    // with numPhases > 1 each update only checks every numPhases-th splat, so a change of view is caught up
+    // over numPhases updates, and the work of a sudden jump is spread over as many frames.
+    uint32_t numPhases = 1;
+
+protected:
+    void ReadRecomputeCount();
+
+    size_t numSplats;
+    bool recomputeAll;
+    uint32_t phase;
+    float recomputeFraction;
+
+    std::shared_ptr<Program> colorProg;
+    std::shared_ptr<BufferObject> colorBuffer;
+    std::shared_ptr<BufferObject> dirBuffer;
+    std::shared_ptr<BufferObject> countBuffer;
+    std::shared_ptr<BufferObject> readbackBuffer;  // copy of countBuffer, see ReadRecomputeCount()
+    std::vector<uint32_t> countVec;
+
+    // the count is read back once the update that wrote it has finished, instead of stalling.
+    void* countFence;  // GLsync
+};
@@ -0,0 +1,510 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+// sortbench, times every sort backend on synthetic keys and checks each result against std::sort.
+// runs headless, from a hidden window, and falls back to the cpu sorts when there is no gl context.
+// must be run from the root of the repo, so the shaders can be found.
+
+#include <algorithm>
+#include <chrono>
+#include <GL/glew.h>
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "core/log.h"
+#include "core/optionparser.h"
+#include "core/program.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+#include "cpusort.h"
+#include "multiradixsort.h"
+#include "onesweepsort.h"
+#include "radix_sort.hpp"
+
+enum optionIndex
+{
+    UNKNOWN,
+    CPU_ONLY,
+    MIN_COUNT,
+    MAX_COUNT,
+    REPEAT,
+    CSV,
+    HELP
+};
+
+const option::Descriptor usage[] =
+{
+    { UNKNOWN, 0, "", "", option::Arg::None, "USAGE: sortbench [options]\n\nOptions:" },
+    { HELP, 0, "h", "help", option::Arg::None, "  -h, --help  Print usage and exit." },
+    { CPU_ONLY, 0, "", "cpu-only", option::Arg::None, "  --cpu-only  Only run the cpu sorts, don't create a gl context." },
+    { MIN_COUNT, 0, "", "min-count", option::Arg::Optional, "  --min-count=N  Skip key counts below N. (default 10000)" },
+    { MAX_COUNT, 0, "", "max-count", option::Arg::Optional, "  --max-count=N  Skip key counts above N. (default 50000000)" },
+    { REPEAT, 0, "", "repeat", option::Arg::Optional, "  --repeat=N  Time each sort N times and report the median. (default 5)" },
+    { CSV, 0, "", "csv", option::Arg::Optional, "  --csv=FILE  Write the results to FILE. (default sortbench.csv)" },
+    { UNKNOWN, 0, "", "", option::Arg::None, "\nExamples:\n  sortbench\n  sortbench --cpu-only --max-count=1000000" },
+    { 0, 0, 0, 0, 0, 0}
+};
+
+static const size_t KEY_COUNTS[] = {10000, 100000, 1000000, 10000000, 50000000};
+
+// single_radixsort.glsl sorts with one workgroup, beyond this it takes seconds.
+static const size_t MAX_SINGLE_RADIX_COUNT = 4000000;
+
+enum Distribution
+{
+    Uniform,  // every bit random
+    Clustered,  // a few tight clumps, like the depths of splats grouped into objects
+    NearlySorted,  // ascending, with 1% of keys swapped with a close neighbor, like last frame's order
+    NumDistributions
+};
+
+static const char* DISTRIBUTION_NAMES[] = {"uniform", "clustered", "nearly_sorted"};
+
+static void GenerateKeys(Distribution dist, size_t count, std::mt19937& rng, std::vector<uint32_t>& keyVec)
+{
+    keyVec.resize(count);
+    switch (dist)
+    {
+    case Uniform:
+        for (size_t i = 0; i < count; i++)
+        {
+            keyVec[i] = rng();
+        }
+        break;
+    case Clustered:
+    {
+        const int NUM_CLUSTERS = 16;
+        uint32_t centers[NUM_CLUSTERS];
+        for (int i = 0; i < NUM_CLUSTERS; i++)
+        {
+            centers[i] = rng();
+        }
+        std::normal_distribution<double> spread(0.0, 65536.0);
+        for (size_t i = 0; i < count; i++)
+        {
+            double key = (double)centers[rng() % NUM_CLUSTERS] + spread(rng);
+            keyVec[i] = (uint32_t)std::clamp(key, 0.0, (double)0xffffffff);
+        }
+        break;
+    }
+    case NearlySorted:
+    {
+        const uint64_t step = std::max((uint64_t)0xffffffff / count, (uint64_t)1);
+        for (size_t i = 0; i < count; i++)
+        {
+            keyVec[i] = (uint32_t)(i * step);
+        }
+        const size_t MAX_SWAP_DISTANCE = 16;
+        for (size_t i = 0; i < count / 100; i++)
+        {
+            size_t a = rng() % count;
+            size_t b = std::min(a + 1 + rng() % MAX_SWAP_DISTANCE, count - 1);
+            std::swap(keyVec[a], keyVec[b]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// keys on the gpu, and the scratch the gpu sorts need.
+struct GpuBuffers
+{
+    GpuBuffers(const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+    {
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+        valOutBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        std::vector<uint32_t> indirectVec(8, 0);
+        indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    // DispatchIndirectCommand followed by DrawElementsIndirectCommand, like sort_args_compute.glsl writes
+    void SetCount(size_t count, uint32_t numElementsPerWorkgroup)
+    {
+        uint32_t numGroups = (uint32_t)((count + numElementsPerWorkgroup - 1) / numElementsPerWorkgroup);
+        std::vector<uint32_t> indirectVec = {numGroups, 1, 1, (uint32_t)count, 1, 0, 0, 0};
+        indirectBuffer->Update(indirectVec);
+    }
+
+    std::shared_ptr<BufferObject> keyBuffer;
+    std::shared_ptr<BufferObject> keyBuffer2;
+    std::shared_ptr<BufferObject> valBuffer;
+    std::shared_ptr<BufferObject> valBuffer2;
+    std::shared_ptr<BufferObject> valOutBuffer;
+    std::shared_ptr<BufferObject> indirectBuffer;
+};
+
+struct Backend
+{
+    std::string name;
+    size_t maxCount;  // larger inputs are skipped
+
+    // called before each timed run, untimed. uploads or copies the unsorted keys.
+    std::function<void(const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)> setup;
+    // the timed part, must not return before the sort has finished.
+    std::function<void()> sort;
+    // copies out the sorted values.
+    std::function<void(std::vector<uint32_t>& sortedVec)> result;
+};
+
+struct Check
+{
+    bool correct;  // keys are in order and the values are a permutation
+    bool stable;  // equal keys kept their input order
+};
+
+static Check CheckResult(const std::vector<uint32_t>& keyVec, const std::vector<uint64_t>& refVec,
+                         const std::vector<uint32_t>& sortedVec)
+{
+    Check check = {true, true};
+    std::vector<uint8_t> seenVec(keyVec.size(), 0);
+    for (size_t i = 0; i < keyVec.size(); i++)
+    {
+        uint32_t val = sortedVec[i];
+        if (val >= keyVec.size() || seenVec[val] || keyVec[val] != (uint32_t)(refVec[i] >> 32))
+        {
+            return {false, false};
+        }
+        seenVec[val] = 1;
+        check.stable = check.stable && val == (uint32_t)refVec[i];
+    }
+    return check;
+}
+
+static std::vector<Backend> MakeBackends(bool useGpu, size_t maxCount, std::shared_ptr<GpuBuffers>& gpuBuffers)
+{
+    std::vector<Backend> backendVec;
+
+    // reference, sorts key and index pairs so the order is the stable one
+    auto stdSortVec = std::make_shared<std::vector<uint64_t>>();
+    backendVec.push_back({"std::sort", 0,
+        [stdSortVec](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+        {
+            stdSortVec->resize(keyVec.size());
+            for (size_t i = 0; i < keyVec.size(); i++)
+            {
+                (*stdSortVec)[i] = ((uint64_t)keyVec[i] << 32) | valVec[i];
+            }
+        },
+        [stdSortVec]() { std::sort(stdSortVec->begin(), stdSortVec->end()); },
+        [stdSortVec](std::vector<uint32_t>& sortedVec)
+        {
+            for (size_t i = 0; i < stdSortVec->size(); i++)
+            {
+                sortedVec[i] = (uint32_t)(*stdSortVec)[i];
+            }
+        }});
+
+    auto cpuSorter = std::make_shared<CpuSorter>();
+    backendVec.push_back({"CpuSorter", 0,
+        [cpuSorter](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+        {
+            cpuSorter->SetKeys(keyVec.data(), keyVec.size());
+        },
+        [cpuSorter]() { cpuSorter->Sort(32); },
+        [cpuSorter](std::vector<uint32_t>& sortedVec) { sortedVec = cpuSorter->GetIndexVec(); }});
+
+    if (!useGpu)
+    {
+        return backendVec;
+    }
+
+    // all the gpu sorts share one set of buffers, see main()
+    auto upload = [&gpuBuffers](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+    {
+        gpuBuffers->keyBuffer->Update(keyVec);
+        gpuBuffers->valBuffer->Update(valVec);
+    };
+    auto readVals = [&gpuBuffers](std::vector<uint32_t>& sortedVec)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        gpuBuffers->valBuffer->Read(sortedVec);
+    };
+    auto readValsOut = [&gpuBuffers](std::vector<uint32_t>& sortedVec)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        gpuBuffers->valOutBuffer->Read(sortedVec);
+    };
+
+    auto rgcSorter = std::make_shared<std::shared_ptr<rgc::radix_sort::sorter>>();
+    auto rgcCount = std::make_shared<size_t>(0);
+    backendVec.push_back({"rgc::radix_sort", 0,
+        [upload, rgcSorter, rgcCount](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+        {
+            upload(keyVec, valVec);
+            if (*rgcCount != keyVec.size())
+            {
+                *rgcCount = keyVec.size();
+                *rgcSorter = std::make_shared<rgc::radix_sort::sorter>(keyVec.size());
+            }
+        },
+        [&gpuBuffers, rgcSorter, rgcCount]()
+        {
+            (*rgcSorter)->sort(gpuBuffers->keyBuffer->GetObj(), gpuBuffers->valBuffer->GetObj(), *rgcCount);
+            glFinish();
+        },
+        readVals});
+
+    if (MultiRadixSorter::IsSupported())
+    {
+        auto multiRadixSorter = std::make_shared<MultiRadixSorter>();
+        const uint32_t NUM_BLOCKS_PER_WORKGROUP = 32;
+        if (multiRadixSorter->Init(maxCount, NUM_BLOCKS_PER_WORKGROUP))
+        {
+            backendVec.push_back({"multi_radixsort", 0,
+                [upload, &gpuBuffers, multiRadixSorter](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+                {
+                    upload(keyVec, valVec);
+                    gpuBuffers->SetCount(keyVec.size(), multiRadixSorter->GetElementsPerWorkgroup());
+                },
+                [&gpuBuffers, multiRadixSorter]()
+                {
+                    GpuBuffers& b = *gpuBuffers;
+                    multiRadixSorter->Sort(b.keyBuffer->GetObj(), b.keyBuffer2->GetObj(), b.valBuffer->GetObj(), b.valBuffer2->GetObj(),
+                                           b.valOutBuffer->GetObj(), b.indirectBuffer->GetObj(), 32);
+                    glFinish();
+                },
+                readValsOut});
+        }
+
+        // one workgroup sorts everything, all 4 passes in a single dispatch
+        auto singleRadixProg = std::make_shared<Program>();
+        if (singleRadixProg->LoadCompute("shader/single_radixsort.glsl"))
+        {
+            auto singleCount = std::make_shared<size_t>(0);
+            backendVec.push_back({"single_radixsort", MAX_SINGLE_RADIX_COUNT,
+                [upload, singleCount](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+                {
+                    upload(keyVec, valVec);
+                    *singleCount = keyVec.size();
+                },
+                [&gpuBuffers, singleRadixProg, singleCount]()
+                {
+                    singleRadixProg->Bind();
+                    singleRadixProg->SetUniform("g_num_elements", (uint32_t)*singleCount);
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gpuBuffers->keyBuffer->GetObj());
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gpuBuffers->keyBuffer2->GetObj());
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, gpuBuffers->valBuffer->GetObj());
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, gpuBuffers->valBuffer2->GetObj());
+                    glDispatchCompute(1, 1, 1);
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                    glFinish();
+                },
+                readVals});  // an even number of passes ends up back in the input buffers
+        }
+    }
+
+    if (OnesweepSorter::IsSupported())
+    {
+        auto onesweepSorter = std::make_shared<OnesweepSorter>();
+        if (onesweepSorter->Init(maxCount))
+        {
+            backendVec.push_back({"onesweep", 0,
+                [upload, &gpuBuffers](const std::vector<uint32_t>& keyVec, const std::vector<uint32_t>& valVec)
+                {
+                    upload(keyVec, valVec);
+                    gpuBuffers->SetCount(keyVec.size(), OnesweepSorter::GetTileSize());
+                },
+                [&gpuBuffers, onesweepSorter]()
+                {
+                    GpuBuffers& b = *gpuBuffers;
+                    onesweepSorter->Sort(b.keyBuffer->GetObj(), b.keyBuffer2->GetObj(), b.valBuffer->GetObj(), b.valBuffer2->GetObj(),
+                                         b.valOutBuffer->GetObj(), b.indirectBuffer->GetObj(), 32);
+                    glFinish();
+                },
+                readValsOut});
+        }
+    }
+
+    return backendVec;
+}
+
+int main(int argc, char *argv[])
+{
+    Log::SetAppName("sortbench");
+
+    // skip program name
+    argc = argc > 0 ? argc - 1 : 0;
+    const char** args = (const char**)argv + (argc > 0 ? 1 : 0);
+
+    option::Stats stats(usage, argc, args);
+    std::vector<option::Option> options(stats.options_max);
+    std::vector<option::Option> buffer(stats.buffer_max);
+    option::Parser parse(usage, argc, args, options.data(), buffer.data());
+    if (parse.error())
+    {
+        return 1;
+    }
+    if (options[HELP])
+    {
+        option::printUsage(std::cout, usage);
+        return 0;
+    }
+    for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next())
+    {
+        std::cout << "Unknown option: " << std::string(opt->name, opt->namelen) << "\n";
+        return 1;
+    }
+
+    bool useGpu = !options[CPU_ONLY];
+    size_t minCount = options[MIN_COUNT].arg ? (size_t)atoll(options[MIN_COUNT].arg) : 10000;
+    size_t maxCount = options[MAX_COUNT].arg ? (size_t)atoll(options[MAX_COUNT].arg) : 50000000;
+    int repeat = std::max(options[REPEAT].arg ? atoi(options[REPEAT].arg) : 5, 1);
+    std::string csvFilename = options[CSV].arg ? options[CSV].arg : "sortbench.csv";
+
+    std::vector<size_t> countVec;
+    for (size_t count : KEY_COUNTS)
+    {
+        if (count >= minCount && count <= maxCount)
+        {
+            countVec.push_back(count);
+        }
+    }
+    if (countVec.empty())
+    {
+        std::cout << "no key counts between --min-count and --max-count\n";
+        return 1;
+    }
+
+    // a hidden window is enough for a context, nothing is ever drawn.
+    SDL_Window* window = nullptr;
+    SDL_GLContext glContext = nullptr;
+    if (useGpu)
+    {
+        if (SDL_Init(SDL_INIT_VIDEO) == 0)
+        {
+            window = SDL_CreateWindow("sortbench", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64,
+                                      SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+            glContext = window ? SDL_GL_CreateContext(window) : nullptr;
+        }
+        if (!glContext || glewInit() != GLEW_OK)
+        {
+            Log::W("no gl context (%s), only running the cpu sorts\n", SDL_GetError());
+            useGpu = false;
+        }
+        else
+        {
+            Log::I("GL_RENDERER = %s\n", (const char*)glGetString(GL_RENDERER));
+        }
+    }
+
+    std::ofstream csv(csvFilename);
+    if (!csv)
+    {
+        Log::E("Error opening \"%s\"\n", csvFilename.c_str());
+        return 1;
+    }
+    csv << "backend,distribution,count,ms,mkeys_per_sec,correct,stable\n";
+
+    // allocated once at the largest count, the gpu sorts read the actual count from the indirect buffer.
+    std::shared_ptr<GpuBuffers> gpuBuffers;
+    std::vector<Backend> backendVec = MakeBackends(useGpu, countVec.back(), gpuBuffers);
+
+    std::mt19937 rng(12345);
+    bool allCorrect = true;
+
+    // the adversarial keys the app doesn't check at startup, see OnesweepSorter::Validate()
+    if (useGpu && OnesweepSorter::IsSupported())
+    {
+        OnesweepSorter validateSorter;
+        if (validateSorter.Init(countVec.back()) && !validateSorter.Validate())
+        {
+            allCorrect = false;
+        }
+    }
+    std::vector<uint32_t> keyVec;
+    std::vector<uint32_t> valVec;
+    std::vector<uint32_t> sortedVec;
+    std::vector<uint64_t> refVec;
+    for (size_t count : countVec)
+    {
+        valVec.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            valVec[i] = (uint32_t)i;
+        }
+        if (useGpu)
+        {
+            // BufferObject::Read() reads the whole buffer, so they are sized to the count.
+            gpuBuffers.reset();
+            gpuBuffers = std::make_shared<GpuBuffers>(valVec, valVec);
+        }
+
+        for (int dist = 0; dist < NumDistributions; dist++)
+        {
+            GenerateKeys((Distribution)dist, count, rng, keyVec);
+
+            refVec.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                refVec[i] = ((uint64_t)keyVec[i] << 32) | i;
+            }
+            std::sort(refVec.begin(), refVec.end());
+
+            for (auto&& backend : backendVec)
+            {
+                if (backend.maxCount && count > backend.maxCount)
+                {
+                    continue;
+                }
+
+                std::vector<double> msVec;
+                for (int i = 0; i < repeat; i++)
+                {
+                    backend.setup(keyVec, valVec);
+                    if (useGpu)
+                    {
+                        glFinish();
+                    }
+                    auto start = std::chrono::high_resolution_clock::now();
+                    backend.sort();
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+                    msVec.push_back(elapsed.count());
+                }
+                std::sort(msVec.begin(), msVec.end());
+                double ms = msVec[msVec.size() / 2];
+
+                sortedVec.resize(count);
+                backend.result(sortedVec);
+                Check check = CheckResult(keyVec, refVec, sortedVec);
+                allCorrect = allCorrect && check.correct;
+
+                double mkeysPerSec = (double)count / (ms * 1000.0);
+                csv << backend.name << "," << DISTRIBUTION_NAMES[dist] << "," << count << "," << ms << "," << mkeysPerSec << ","
+                    << (check.correct ? 1 : 0) << "," << (check.stable ? 1 : 0) << "\n";
+                Log::I("%-16s %-14s %9d keys %10.3f ms %9.1f Mkeys/s %s%s\n", backend.name.c_str(), DISTRIBUTION_NAMES[dist],
+                       (int)count, ms, mkeysPerSec, check.correct ? "ok" : "WRONG", check.correct && !check.stable ? " (unstable)" : "");
+            }
+        }
+    }
+
+    backendVec.clear();
+    gpuBuffers.reset();
+    if (glContext)
+    {
+        SDL_GL_DeleteContext(glContext);
+    }
+    if (window)
+    {
+        SDL_DestroyWindow(window);
+    }
+    SDL_Quit();
+
+    Log::I("results written to %s\n", csvFilename.c_str());
+    return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,270 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "sorttuner.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <vector>
+
+#include "core/log.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+#include "multiradixsort.h"
+#include "onesweepsort.h"
+#include "radix_sort.hpp"
+
+// each setting is timed this many times after a warm up run, and the median is kept.
+static const int NUM_TIMED_RUNS = 5;
+
+static const uint32_t BLOCK_SIZES[] = {8, 16, 32, 64, 128, 256, 512, 1024};
+
+bool SortProfile::ImportJson(const std::string& jsonFilename)
+{
+    std::ifstream f(jsonFilename);
+    if (f.fail())
+    {
+        return false;
+    }
+
+    try
+    {
+        nlohmann::json obj = nlohmann::json::parse(f);
+        rendererMap.clear();
+        for (auto& [renderer, sizes] : obj.items())
+        {
+            for (auto& [size, jentry] : sizes.items())
+            {
+                Entry entry;
+                entry.sortMethod = jentry["sortMethod"].template get<std::string>();
+                entry.numBlocksPerWorkgroup = jentry["numBlocksPerWorkgroup"].template get<uint32_t>();
+                entry.ms = jentry["ms"].template get<float>();
+                rendererMap[renderer][std::stoull(size)] = entry;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::string s = e.what();
+        Log::E("SortProfile::ImportJson exception: %s\n", s.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool SortProfile::ExportJson(const std::string& jsonFilename) const
+{
+    std::ofstream f(jsonFilename);
+    if (f.fail())
+    {
+        return false;
+    }
+
+    nlohmann::json obj = nlohmann::json::object();
+    for (auto&& [renderer, sizeMap] : rendererMap)
+    {
+        for (auto&& [size, entry] : sizeMap)
+        {
+            obj[renderer][std::to_string(size)] = {
+                {"sortMethod", entry.sortMethod},
+                {"numBlocksPerWorkgroup", entry.numBlocksPerWorkgroup},
+                {"ms", entry.ms}
+            };
+        }
+    }
+    f << obj.dump(4) << std::endl;
+
+    return true;
+}
+
+bool SortProfile::Find(const std::string& renderer, size_t numSplats, Entry& entryOut) const
+{
+    auto rendererIter = rendererMap.find(renderer);
+    if (rendererIter == rendererMap.end())
+    {
+        return false;
+    }
+    auto sizeIter = rendererIter->second.find(GetSizeBucket(numSplats));
+    if (sizeIter == rendererIter->second.end())
+    {
+        return false;
+    }
+    entryOut = sizeIter->second;
+    return true;
+}
+
+void SortProfile::Set(const std::string& renderer, size_t numSplats, const Entry& entry)
+{
+    rendererMap[renderer][GetSizeBucket(numSplats)] = entry;
+}
+
+std::string SortProfile::GetRenderer()
+{
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    return renderer ? renderer : "unknown";
+}
+
+uint64_t SortProfile::GetSizeBucket(size_t numSplats)
+{
+    uint64_t bucket = 1;
+    while (bucket < numSplats)
+    {
+        bucket <<= 1;
+    }
+    return bucket;
+}
+
+bool SortTuner::Tune(size_t numSplats, SortProfile::Entry& bestOut)
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    auto start = std::chrono::high_resolution_clock::now();
+
+    GL_ERROR_CHECK("SortTuner::Tune() begin");
+
+    const size_t count = std::max(numSplats, (size_t)1);
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> keyVec(count);
+    std::vector<uint32_t> valVec(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keyVec[i] = rng();
+        valVec[i] = (uint32_t)i;
+    }
+
+    auto keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+    auto keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, keyVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+    auto valOutBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, valVec, GL_DYNAMIC_STORAGE_BIT);
+    std::vector<uint32_t> indirectVec(8, 0);
+    auto indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT);
+
+    // same layout as sort_args_compute.glsl
+    auto setIndirect = [&indirectVec, &indirectBuffer, count](uint32_t numElementsPerWorkgroup)
+    {
+        indirectVec = {(uint32_t)((count + numElementsPerWorkgroup - 1) / numElementsPerWorkgroup), 1, 1, (uint32_t)count, 1, 0, 0, 0};
+        indirectBuffer->Update(indirectVec);
+    };
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    // the keys are re-uploaded before every run, outside the query, because the sorts overwrite them.
+    auto time = [&](const std::function<void()>& sort)
+    {
+        std::vector<float> msVec;
+        for (int i = 0; i < NUM_TIMED_RUNS + 1; i++)
+        {
+            keyBuffer->Update(keyVec);
+            valBuffer->Update(valVec);
+
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            sort();
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            if (i > 0)
+            {
+                msVec.push_back((float)ns / 1000000.0f);
+            }
+        }
+        std::sort(msVec.begin(), msVec.end());
+        return msVec[msVec.size() / 2];
+    };
+
+    SortProfile::Entry best;
+    best.ms = std::numeric_limits<float>::max();
+    auto consider = [&best](const SortProfile::Entry& entry)
+    {
+        Log::D("SortTuner: %s, numBlocksPerWorkgroup = %u, %.3f ms\n", entry.sortMethod.c_str(), entry.numBlocksPerWorkgroup, entry.ms);
+        if (entry.ms < best.ms)
+        {
+            best = entry;
+        }
+    };
+
+    {
+        rgc::radix_sort::sorter sorter(count);
+        SortProfile::Entry entry;
+        entry.sortMethod = "rgc";
+        entry.ms = time([&]() { sorter.sort(keyBuffer->GetObj(), valBuffer->GetObj(), count); });
+        consider(entry);
+    }
+
+    if (MultiRadixSorter::IsSupported())
+    {
+        MultiRadixSorter sorter;
+        if (sorter.Init(count, BLOCK_SIZES[0]))
+        {
+            for (uint32_t numBlocks : BLOCK_SIZES)
+            {
+                sorter.SetNumBlocksPerWorkgroup(numBlocks);
+                setIndirect(sorter.GetElementsPerWorkgroup());
+
+                SortProfile::Entry entry;
+                entry.sortMethod = "multi_radix";
+                entry.numBlocksPerWorkgroup = numBlocks;
+                entry.ms = time([&]()
+                {
+                    sorter.Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                                valOutBuffer->GetObj(), indirectBuffer->GetObj(), 32);
+                });
+                consider(entry);
+            }
+        }
+    }
+
+    // only if it sorts correctly on this driver
+    if (OnesweepSorter::IsSupported())
+    {
+        OnesweepSorter sorter;
+        if (sorter.Init(count) && sorter.Validate())
+        {
+            setIndirect(OnesweepSorter::GetTileSize());
+
+            SortProfile::Entry entry;
+            entry.sortMethod = "onesweep";
+            entry.ms = time([&]()
+            {
+                sorter.Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                            valOutBuffer->GetObj(), indirectBuffer->GetObj(), 32);
+            });
+            consider(entry);
+        }
+    }
+
+    glDeleteQueries(1, &query);
+
+    GL_ERROR_CHECK("SortTuner::Tune() end");
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    Log::I("SortTuner: fastest sort of %d keys is %s, numBlocksPerWorkgroup = %u, %.3f ms, tuned in %.3f sec\n",
+           (int)count, best.sortMethod.c_str(), best.numBlocksPerWorkgroup, best.ms, elapsed.count());
+
+    bestOut = best;
+    return !best.sortMethod.empty();
+#endif
+}
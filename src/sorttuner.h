@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+// The fastest sort settings measured on each gpu, for each scene size, see SortTuner.
+// Entries are keyed by the GL_RENDERER string and the number of splats rounded up to a power of 2.
+class SortProfile
+{
+public:
+    struct Entry
+    {
+        std::string sortMethod;  // "rgc", "multi_radix" or "onesweep"
+        uint32_t numBlocksPerWorkgroup = 0;  // multi_radix only
+        float ms = 0.0f;  // median sort time of all the splats with 32 bit keys
+    };
+
+    bool ImportJson(const std::string& jsonFilename);
+    bool ExportJson(const std::string& jsonFilename) const;
+
+    bool Find(const std::string& renderer, size_t numSplats, Entry& entryOut) const;
+    void Set(const std::string& renderer, size_t numSplats, const Entry& entry);
+
+    // GL_RENDERER of the current context
+    static std::string GetRenderer();
+
+protected:
+    static uint64_t GetSizeBucket(size_t numSplats);
+
+    std::map<std::string, std::map<uint64_t, Entry>> rendererMap;
+};
+
+// Times each gpu sort on random keys with gl timer queries, and for the multi radix sort each numBlocksPerWorkgroup,
+// so SplatRenderer can use whichever is fastest on this gpu. Takes a second or two, so the result is kept in a SortProfile.
+class SortTuner
+{
+public:
+    // returns false if nothing could be timed, e.g. on gles, which has no timer queries.
+    static bool Tune(size_t numSplats, SortProfile::Entry& bestOut);
+};
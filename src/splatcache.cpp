@@ -0,0 +1,307 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "splatcache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <limits>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "core/log.h"
+#include "core/parallelfor.h"
+
+#include "gaussiancloud.h"
+
+// 'SPLC'
+static const uint32_t SPLAT_CACHE_MAGIC = 0x434c5053;
+
+// bump this whenever the layout of the arrays changes, so stale caches are rebuilt.
+// 3: splats are in morton order
+static const uint32_t SPLAT_CACHE_VERSION = 3;
+
+static bool GetFileStats(const std::string& filename, uint64_t& sizeOut, int64_t& modTimeOut)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    sizeOut = (uint64_t)st.st_size;
+    modTimeOut = (int64_t)st.st_mtime;
+    return true;
+}
+
+SplatCache::SplatCache() : numSplats(0), shDegree(3), data(nullptr)
+{
+}
+
+int SplatCache::GetElementSize(Array array, uint32_t shDegreeIn)
+{
+    switch (array)
+    {
+    case Position:
+        return 4;
+    case R_SH0: case G_SH0: case B_SH0:
+        return shDegreeIn == 0 ? 1 : 4;
+    case R_SH1: case G_SH1: case B_SH1:
+    case R_SH2: case G_SH2: case B_SH2:
+        return shDegreeIn >= 2 ? 4 : 0;
+    case R_SH3: case G_SH3: case B_SH3:
+        return shDegreeIn >= 3 ? 4 : 0;
+    default:
+        return 3;
+    }
+}
+
+size_t SplatCache::ComputeLayout(size_t numSplatsIn, uint32_t shDegreeIn, uint64_t* arrayOffsetsOut)
+{
+    // each array starts on a 16 byte boundary
+    const size_t ALIGNMENT = 16;
+    size_t offset = sizeof(Header);
+    for (int i = 0; i < NumArrays; i++)
+    {
+        offset = (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        arrayOffsetsOut[i] = offset;
+        offset += numSplatsIn * GetElementSize((Array)i, shDegreeIn) * sizeof(float);
+    }
+    return offset;
+}
+
+void SplatCache::Build(const GaussianCloud& gaussianCloud)
+{
+    mappedFile.Close();
+
+    numSplats = gaussianCloud.size();
+    shDegree = gaussianCloud.GetSHDegree();
+    uint64_t arrayOffsets[NumArrays];
+    dataVec.resize(ComputeLayout(numSplats, shDegree, arrayOffsets));
+    data = dataVec.data();
+
+    float* arrays[NumArrays];
+    for (int i = 0; i < NumArrays; i++)
+    {
+        arrays[i] = reinterpret_cast<float*>(dataVec.data() + arrayOffsets[i]);
+    }
+
+    // writes the 4 floats (a, b, c, d) to element i of array, if that array is stored.
+    auto set4 = [this, &arrays](Array array, size_t i, float a, float b, float c, float d)
+    {
+        if (GetElementSize(array) == 4)
+        {
+            float* p = arrays[array] + i * 4;
+            p[0] = a; p[1] = b; p[2] = c; p[3] = d;
+        }
+    };
+
+    const size_t MIN_RANGE_SIZE = 4096;
+    ParallelFor(numSplats, MIN_RANGE_SIZE, [&](size_t begin, size_t end)
+    {
+        GaussianCloud::Gaussian g;
+        for (size_t i = begin; i < end; i++)
+        {
+            gaussianCloud.GetGaussian(i, g);
+
+            // stick alpha into position.w
+            float alpha = 1.0f / (1.0f + expf(-g.opacity));
+            set4(Position, i, g.position[0], g.position[1], g.position[2], alpha);
+
+            if (shDegree == 0)
+            {
+                arrays[R_SH0][i] = g.f_dc[0];
+                arrays[G_SH0][i] = g.f_dc[1];
+                arrays[B_SH0][i] = g.f_dc[2];
+            }
+            set4(R_SH0, i, g.f_dc[0], g.f_rest[0], g.f_rest[1], g.f_rest[2]);
+            set4(G_SH0, i, g.f_dc[1], g.f_rest[15], g.f_rest[16], g.f_rest[17]);
+            set4(B_SH0, i, g.f_dc[2], g.f_rest[30], g.f_rest[31], g.f_rest[32]);
+
+            set4(R_SH1, i, g.f_rest[3], g.f_rest[4], g.f_rest[5], g.f_rest[6]);
+            set4(R_SH2, i, g.f_rest[7], g.f_rest[8], g.f_rest[9], g.f_rest[10]);
+            set4(R_SH3, i, g.f_rest[11], g.f_rest[12], g.f_rest[13], g.f_rest[14]);
+            set4(G_SH1, i, g.f_rest[18], g.f_rest[19], g.f_rest[20], g.f_rest[21]);
+            set4(G_SH2, i, g.f_rest[22], g.f_rest[23], g.f_rest[24], g.f_rest[25]);
+            set4(G_SH3, i, g.f_rest[26], g.f_rest[27], g.f_rest[28], g.f_rest[29]);
+            set4(B_SH1, i, g.f_rest[33], g.f_rest[34], g.f_rest[35], g.f_rest[36]);
+            set4(B_SH2, i, g.f_rest[37], g.f_rest[38], g.f_rest[39], g.f_rest[40]);
+            set4(B_SH3, i, g.f_rest[41], g.f_rest[42], g.f_rest[43], g.f_rest[44]);
+
+            glm::mat3 V = g.ComputeCovMat();
+            for (int j = 0; j < 3; j++)
+            {
+                arrays[Cov3_Col0][i * 3 + j] = V[0][j];
+                arrays[Cov3_Col1][i * 3 + j] = V[1][j];
+                arrays[Cov3_Col2][i * 3 + j] = V[2][j];
+            }
+        }
+    });
+}
+
+std::vector<SplatCache::Chunk> SplatCache::ComputeChunks(uint32_t chunkSize) const
+{
+    const size_t numChunks = (numSplats + chunkSize - 1) / chunkSize;
+    std::vector<Chunk> chunkVec(numChunks);
+    const float* positions = GetArray(Position);
+    const float* cols[3] = {GetArray(Cov3_Col0), GetArray(Cov3_Col1), GetArray(Cov3_Col2)};
+
+    const size_t MIN_RANGE_SIZE = 64;
+    ParallelFor(numChunks, MIN_RANGE_SIZE, [&](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
+        {
+            glm::vec3 aabbMin(std::numeric_limits<float>::max());
+            glm::vec3 aabbMax(-std::numeric_limits<float>::max());
+            size_t last = std::min(numSplats, (c + 1) * chunkSize);
+            for (size_t i = c * chunkSize; i < last; i++)
+            {
+                glm::vec3 p(positions[i * 4], positions[i * 4 + 1], positions[i * 4 + 2]);
+
+                // the diagonal of the covariance is the variance along each axis
+                glm::vec3 extent(3.0f * sqrtf(cols[0][i * 3]), 3.0f * sqrtf(cols[1][i * 3 + 1]), 3.0f * sqrtf(cols[2][i * 3 + 2]));
+                aabbMin = glm::min(aabbMin, p - extent);
+                aabbMax = glm::max(aabbMax, p + extent);
+            }
+            chunkVec[c].aabbMin = aabbMin;
+            chunkVec[c].aabbMax = aabbMax;
+        }
+    });
+
+    return chunkVec;
+}
+
+bool SplatCache::Save(const std::string& filename, const std::string& sourceFilename, uint32_t maxSHDegree) const
+{
+    if (!data)
+    {
+        Log::E("SplatCache: nothing to save\n");
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    header.magic = SPLAT_CACHE_MAGIC;
+    header.version = SPLAT_CACHE_VERSION;
+    header.numSplats = numSplats;
+    header.shDegree = shDegree;
+    header.maxSHDegree = maxSHDegree;
+    if (!GetFileStats(sourceFilename, header.sourceSize, header.sourceModTime))
+    {
+        Log::E("SplatCache: could not stat \"%s\"\n", sourceFilename.c_str());
+        return false;
+    }
+    size_t fileSize = ComputeLayout(numSplats, shDegree, header.arrayOffsets);
+
+    std::ofstream cacheFile(filename, std::ios::binary);
+    if (!cacheFile.is_open())
+    {
+        Log::W("SplatCache: failed to open \"%s\" for writing\n", filename.c_str());
+        return false;
+    }
+
+    cacheFile.write((const char*)&header, sizeof(Header));
+    cacheFile.write((const char*)(data + sizeof(Header)), fileSize - sizeof(Header));
+    if (!cacheFile)
+    {
+        // a truncated file will fail the size check in Load, but don't leave it around.
+        cacheFile.close();
+        std::remove(filename.c_str());
+        Log::W("SplatCache: failed to write \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool SplatCache::Load(const std::string& filename, const std::string& sourceFilename, uint32_t maxSHDegree)
+{
+    dataVec.clear();
+    data = nullptr;
+    numSplats = 0;
+
+    uint64_t sourceSize = 0;
+    int64_t sourceModTime = 0;
+    if (!GetFileStats(sourceFilename, sourceSize, sourceModTime))
+    {
+        Log::E("SplatCache: could not stat \"%s\"\n", sourceFilename.c_str());
+        return false;
+    }
+
+    // a missing cache is expected on first run, so don't use MappedFile::Open's error.
+    uint64_t cacheSize = 0;
+    int64_t cacheModTime = 0;
+    if (!GetFileStats(filename, cacheSize, cacheModTime) || cacheSize < sizeof(Header))
+    {
+        Log::D("SplatCache: no cache found at \"%s\"\n", filename.c_str());
+        return false;
+    }
+
+    if (!mappedFile.Open(filename))
+    {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, mappedFile.GetData(), sizeof(Header));
+    if (header.magic != SPLAT_CACHE_MAGIC || header.version != SPLAT_CACHE_VERSION)
+    {
+        Log::I("SplatCache: \"%s\" is from a different version, ignoring\n", filename.c_str());
+        mappedFile.Close();
+        return false;
+    }
+
+    if (header.maxSHDegree < maxSHDegree || header.shDegree > 3)
+    {
+        Log::I("SplatCache: \"%s\" was written with fewer sh bands, ignoring\n", filename.c_str());
+        mappedFile.Close();
+        return false;
+    }
+
+    if (header.sourceSize != sourceSize || header.sourceModTime != sourceModTime)
+    {
+        Log::I("SplatCache: \"%s\" has changed since \"%s\" was written, ignoring\n", sourceFilename.c_str(), filename.c_str());
+        mappedFile.Close();
+        return false;
+    }
+
+    uint64_t arrayOffsets[NumArrays];
+    size_t expectedSize = ComputeLayout(header.numSplats, header.shDegree, arrayOffsets);
+    if (mappedFile.GetSize() != expectedSize || memcmp(arrayOffsets, header.arrayOffsets, sizeof(arrayOffsets)) != 0)
+    {
+        Log::W("SplatCache: \"%s\" is corrupt, ignoring\n", filename.c_str());
+        mappedFile.Close();
+        return false;
+    }
+
+    mappedFile.AdviseSequential(sizeof(Header), expectedSize - sizeof(Header));
+    numSplats = header.numSplats;
+    shDegree = header.shDegree;
+    data = mappedFile.GetData();
+    return true;
+}
+
+std::string SplatCache::GetCacheFilename(const std::string& sourceFilename)
+{
+    size_t dot = sourceFilename.find_last_of('.');
+    size_t slash = sourceFilename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return sourceFilename + ".splatcache";
+    }
+    return sourceFilename.substr(0, dot) + ".splatcache";
+}
+
+const float* SplatCache::GetArray(Array array) const
+{
+    assert(data && array < NumArrays);
+    uint64_t arrayOffsets[NumArrays];
+    ComputeLayout(numSplats, shDegree, arrayOffsets);
+    return reinterpret_cast<const float*>(data + arrayOffsets[array]);
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "core/mappedfile.h"
+
+class GaussianCloud;
+
+// The per splat vertex attributes exactly as SplatRenderer uploads them to the gpu.
+// i.e. alpha is already folded into position.w, the covariance matrix is precomputed and
+// the sh coefficients are shuffled into vec4s.
+//
+// It can be saved next to the source ply as a .splatcache file, which is memory mapped on later runs
+// and uploaded directly, without parsing the ply or doing any per splat work.
+class SplatCache
+{
+public:
+    SplatCache();
+
+    // only the sh arrays needed for the sh degree of the cloud are stored, the others are empty.
+    enum Array
+    {
+        Position = 0,  // vec4 (x, y, z, alpha)
+        R_SH0, G_SH0, B_SH0,  // vec4, or a single float (dc only) when the sh degree is 0
+        R_SH1, R_SH2, R_SH3,  // vec4, sh1 and sh2 need degree 2, sh3 needs degree 3
+        G_SH1, G_SH2, G_SH3,
+        B_SH1, B_SH2, B_SH3,
+        Cov3_Col0, Cov3_Col1, Cov3_Col2,  // vec3
+        NumArrays
+    };
+
+    // converts the cloud into gpu layout, in memory.
+    void Build(const GaussianCloud& gaussianCloud);
+
+    // sourceFilename is recorded so the cache can be invalidated when the source changes.
+    // maxSHDegree is the limit that was used to load the source, see GaussianCloud::ImportOptions.
+    bool Save(const std::string& filename, const std::string& sourceFilename, uint32_t maxSHDegree) const;
+
+    // memory maps a cache file, fails if it's from a different version, sourceFilename has changed since it was written,
+    // or it was written with a lower maxSHDegree.
+    bool Load(const std::string& filename, const std::string& sourceFilename, uint32_t maxSHDegree);
+
+    // "scene.ply" -> "scene.splatcache"
+    static std::string GetCacheFilename(const std::string& sourceFilename);
+
+    size_t GetNumSplats() const { return numSplats; }
+    uint32_t GetSHDegree() const { return shDegree; }
+
+    // number of floats per element, 0 if the array is not stored
+    int GetElementSize(Array array) const { return GetElementSize(array, shDegree); }
+    static int GetElementSize(Array array, uint32_t shDegreeIn);
+    const float* GetArray(Array array) const;
+
+    struct Chunk
+    {
+        glm::vec3 aabbMin;
+        glm::vec3 aabbMax;
+    };
+
+    // bounds of each run of chunkSize consecutive splats, including 3 sigma of every gaussian.
+    // they're only tight when the splats are in spatial order, see GaussianCloud::SortByMortonOrder().
+    std::vector<Chunk> ComputeChunks(uint32_t chunkSize) const;
+
+protected:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t numSplats;
+        uint32_t shDegree;
+        uint32_t maxSHDegree;
+        uint64_t sourceSize;
+        int64_t sourceModTime;
+        uint64_t arrayOffsets[NumArrays];  // in bytes, from the start of the file
+    };
+
+    static size_t ComputeLayout(size_t numSplatsIn, uint32_t shDegreeIn, uint64_t* arrayOffsetsOut);
+
+    size_t numSplats;
+    uint32_t shDegree;
+    const uint8_t* data;  // points to either dataVec or mappedFile
+    std::vector<uint8_t> dataVec;
+    MappedFile mappedFile;
+};
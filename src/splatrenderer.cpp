@@ -10,10 +10,15 @@
 #include <EGL/eglext.h>
 #include <GLES3/gl3.h>
 #include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
 #else
 #include <GL/glew.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
 #include <glm/gtc/matrix_transform.hpp>
 
 #ifndef __ANDROID__
@@ -26,6 +31,7 @@
 
 #include "core/image.h"
 #include "core/log.h"
+#include "core/parallelfor.h"
 #include "core/texture.h"
 #include "core/util.h"
 
@@ -33,16 +39,61 @@
 
 static const uint32_t NUM_BLOCKS_PER_WORKGROUP = 1024;
 
-SplatRenderer::SplatRenderer()
+// layout of indirectBuffer, see sort_args_compute.glsl
+static const size_t DISPATCH_INDIRECT_OFFSET = 0;
+static const size_t DRAW_INDIRECT_OFFSET = 3 * sizeof(uint32_t);
+static const size_t DRAW_INDIRECT_COUNT = 3;  // index of DrawElementsIndirectCommand.count
+static const size_t QUAD_DRAW_INDIRECT_OFFSET = 8 * sizeof(uint32_t);
+static const size_t INDIRECT_BUFFER_SIZE = 12;  // in uint32_t
+
+// layout of shLodStatsBuffer, see SH_LOD_STATS in preprocess_compute.glsl
+static const size_t SH_LOD_STATS_SIZE = 6;  // in uint32_t
+
+static bool IsVertexPullingSupported()
+{
+    GLint maxVertexStorageBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxVertexStorageBlocks);
+    return maxVertexStorageBlocks >= 2;
+}
+
+struct SplatAttrib
+{
+    const char* name;
+    SplatCache::Array array;
+    uint32_t minDegree;  // only uploaded if the shader's SH_DEGREE is at least this
+};
+
+static const SplatAttrib SPLAT_ATTRIBS[] = {
+    {"position", SplatCache::Position, 0},
+    {"r_sh0", SplatCache::R_SH0, 0}, {"g_sh0", SplatCache::G_SH0, 0}, {"b_sh0", SplatCache::B_SH0, 0},
+    {"r_sh1", SplatCache::R_SH1, 2}, {"g_sh1", SplatCache::G_SH1, 2}, {"b_sh1", SplatCache::B_SH1, 2},
+    {"r_sh2", SplatCache::R_SH2, 2}, {"g_sh2", SplatCache::G_SH2, 2}, {"b_sh2", SplatCache::B_SH2, 2},
+    {"r_sh3", SplatCache::R_SH3, 3}, {"g_sh3", SplatCache::G_SH3, 3}, {"b_sh3", SplatCache::B_SH3, 3},
+    {"cov3_col0", SplatCache::Cov3_Col0, 0}, {"cov3_col1", SplatCache::Cov3_Col1, 0}, {"cov3_col2", SplatCache::Cov3_Col2, 0}
+};
+
+SplatRenderer::SplatRenderer() : shLodFence(nullptr), isOnesweepProfiled(false)
 {
 }
 
 SplatRenderer::~SplatRenderer()
 {
+    if (shLodFence)
+    {
+        glDeleteSync((GLsync)shLodFence);
+    }
 }
 
 bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud, bool isFramebufferSRGBEnabledIn,
                          bool useFullSHIn, bool useRgcSortOverrideIn)
+{
+    auto splatCache = std::make_shared<SplatCache>();
+    splatCache->Build(*gaussianCloud);
+    return Init(splatCache, isFramebufferSRGBEnabledIn, useFullSHIn, useRgcSortOverrideIn);
+}
+
+bool SplatRenderer::Init(std::shared_ptr<SplatCache> splatCache, bool isFramebufferSRGBEnabledIn,
+                         bool useFullSHIn, bool useRgcSortOverrideIn)
 {
     GL_ERROR_CHECK("SplatRenderer::Init() begin");
 
@@ -50,86 +101,340 @@ bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud, bool isFr
     useFullSH = useFullSHIn;
     useRgcSortOverride = useRgcSortOverrideIn;
 
-    splatProg = std::make_shared<Program>();
-    if (isFramebufferSRGBEnabled || useFullSH)
+    // without full sh only the first order coeffs are used, which are packed into sh0 along with the dc color.
+    shDegree = std::min(splatCache->GetSHDegree(), useFullSH ? 3u : 1u);
+
+    std::string defines = "";
+    if (isFramebufferSRGBEnabled)
+    {
+        defines += "#define FRAMEBUFFER_SRGB\n";
+    }
+    defines += "#define SH_DEGREE " + std::to_string(shDegree) + "\n";
+
+    if (sortMethod == SortMethod::Auto && !useRgcSortOverride && !sortProfileFilename.empty())
+    {
+        ApplySortProfile(splatCache->GetNumSplats());
+    }
+
+    // the onesweep sort is only picked automatically if it sorts correctly on this driver, see OnesweepSorter::Validate().
+    // if the sort profile picked it, SortTuner has already done the full check on this gpu, otherwise only the quick one is done.
+    if ((sortMethod == SortMethod::Auto && !useRgcSortOverride && OnesweepSorter::IsSupported()) ||
+        sortMethod == SortMethod::Onesweep)
+    {
+        onesweepSorter = std::make_shared<OnesweepSorter>();
+        if (!onesweepSorter->Init(splatCache->GetNumSplats()))
+        {
+            Log::E("Error initializing onesweep sort!\n");
+            return false;
+        }
+
+        if (isOnesweepProfiled || onesweepSorter->Validate(false))
+        {
+            sortMethod = SortMethod::Onesweep;
+        }
+        else if (sortMethod == SortMethod::Onesweep)
+        {
+            Log::W("OnesweepSorter failed validation, splats may be drawn out of order\n");
+        }
+        else
+        {
+            onesweepSorter.reset();
+        }
+    }
+
+    if (sortMethod == SortMethod::Auto)
+    {
+        sortMethod = (MultiRadixSorter::IsSupported() && !useRgcSortOverride) ? SortMethod::MultiRadix : SortMethod::Rgc;
+    }
+    bool useMultiRadixSort = sortMethod == SortMethod::MultiRadix;
+    bool useOnesweepSort = sortMethod == SortMethod::Onesweep;
+
+    // the tile rasterizer sorts its own (tile, depth) keys with the same sort, so the global sort isn't set up.
+    bool useTileRender = false;
+    if (renderMethod == RenderMethod::Tile)
     {
-        std::string defines = "";
-        if (isFramebufferSRGBEnabled)
+        if (TileRasterizer::IsSupported() && (useMultiRadixSort || useOnesweepSort))
         {
-            defines += "#define FRAMEBUFFER_SRGB\n";
+            useTileRender = true;
+            useInterleavedAttribs = true;
+            onesweepSorter.reset();
         }
-        if (useFullSH)
+        else
         {
-            defines += "#define FULL_SH\n";
+            Log::W("tile rendering needs OpenGL 4.3 and the onesweep or multi radix sort, using instanced quads instead\n");
+            renderMethod = RenderMethod::Quad;
         }
-        splatProg->AddMacro("DEFINES", defines);
     }
-    if (!splatProg->LoadVertGeomFrag("./shader/splat_vert.glsl", "./shader/splat_geom.glsl", "./shader/splat_frag.glsl"))
+
+    if (renderMethod == RenderMethod::Quad && (!useInterleavedAttribs || !IsVertexPullingSupported()))
     {
-        Log::E("Error loading splat shaders!\n");
-        return false;
+        Log::I("instanced quads need the interleaved attribs and storage buffers in vertex shaders, using the geometry shader instead\n");
+        renderMethod = RenderMethod::GeometryShader;
+    }
+
+    // the cached colors are read from a storage buffer, like the interleaved splats, which the geometry shader doesn't do.
+    if (useSHColorCache && renderMethod == RenderMethod::GeometryShader)
+    {
+        Log::W("the sh color cache needs instanced quads or tile rendering, evaluating the sh every frame instead\n");
+        useSHColorCache = false;
+    }
+    if (useSHColorCache)
+    {
+        defines += "#define SH_COLOR_CACHE\n";
     }
 
-    preSortProg = std::make_shared<Program>();
-    if (!preSortProg->LoadCompute("./shader/presort_compute.glsl"))
+    // the cached colors are evaluated with the full sh, and the tile rasterizer doesn't pick a degree.
+    if (useSHLod && (renderMethod != RenderMethod::Quad || useSHColorCache))
     {
-        Log::E("Error loading pre-sort compute shader!\n");
+        Log::W("sh lod needs instanced quads without the sh color cache, evaluating the full sh instead\n");
+        useSHLod = false;
+    }
+    if (useSHLod)
+    {
+        defines += "#define SH_LOD\n";
+    }
+
+    // the SH evaluation is shared by every shader that computes splat colors, see sh_eval.glsl
+    std::string shEval;
+    if (!LoadFile("./shader/sh_eval.glsl", shEval))
+    {
+        Log::E("Error loading sh eval shader!\n");
         return false;
     }
 
-    bool useMultiRadixSort = GLEW_KHR_shader_subgroup && !useRgcSortOverride;
+    // with a gpu sort, the quads are drawn from the 2D records written by preprocess_compute.glsl, which replaces the pre-sort.
+    // the cpu sort only has the sorted indices, so its quads project the splats themselves.
+    bool useRecords = renderMethod == RenderMethod::Quad && sortMethod != SortMethod::Cpu;
+
+    if (renderMethod != RenderMethod::Tile)
+    {
+        splatProg = std::make_shared<Program>();
+        if (useRecords)
+        {
+            if (!splatProg->LoadVertFrag("./shader/splat_record_vert.glsl", "./shader/splat_frag.glsl"))
+            {
+                Log::E("Error loading splat shaders!\n");
+                return false;
+            }
+        }
+        else if (renderMethod == RenderMethod::Quad)
+        {
+            splatProg->AddMacro("DEFINES", defines + GetSplatLayoutDefines(*splatCache));
+            splatProg->AddMacro("SH_EVAL", shEval);
+            if (!splatProg->LoadVertFrag("./shader/splat_quad_vert.glsl", "./shader/splat_frag.glsl"))
+            {
+                Log::E("Error loading splat shaders!\n");
+                return false;
+            }
+        }
+        else
+        {
+            splatProg->AddMacro("DEFINES", defines);
+            splatProg->AddMacro("SH_EVAL", shEval);
+            if (!splatProg->LoadVertGeomFrag("./shader/splat_vert.glsl", "./shader/splat_geom.glsl", "./shader/splat_frag.glsl"))
+            {
+                Log::E("Error loading splat shaders!\n");
+                return false;
+            }
+        }
+    }
+
+    // rgc::radix_sort sorts every splat, so every key has to be written, see KEEP_CULLED in presort_compute.glsl,
+    // and the cpu sort and the tile rasterizer go over every splat themselves.
+    useChunkCulling = useChunkCulling && (useMultiRadixSort || useOnesweepSort) && !useTileRender;
+    std::string chunkDefines = useChunkCulling ? "#define VISIBLE_CHUNKS\n" : "";
 
-    if (useMultiRadixSort)
+    if (sortMethod != SortMethod::Cpu && !useTileRender)
     {
-        sortProg = std::make_shared<Program>();
-        if (!sortProg->LoadCompute("shader/multi_radixsort.glsl"))
+        // rgc::radix_sort needs the number of elements on the cpu, so it sorts every splat, with the culled ones last.
+        std::string preSortDefines = (sortMethod == SortMethod::Rgc) ? "#define KEEP_CULLED\n" : chunkDefines;
+        preSortProg = std::make_shared<Program>();
+        if (useRecords)
+        {
+            std::string layoutDefines = GetSplatLayoutDefines(*splatCache);
+            if (useSHLod && measureSHLod)
+            {
+                preSortDefines += "#define SH_LOD_STATS\n";
+            }
+            preSortProg->AddMacro("DEFINES", defines + layoutDefines + preSortDefines);
+            preSortProg->AddMacro("SH_EVAL", shEval);
+            if (!preSortProg->LoadCompute("./shader/preprocess_compute.glsl"))
+            {
+                Log::E("Error loading preprocess compute shader!\n");
+                return false;
+            }
+
+            // no SH_LOD_STATS, the stats only count the sorted view, not its reprojection for the other eye.
+            recordProg = std::make_shared<Program>();
+            recordProg->AddMacro("DEFINES", defines + layoutDefines + chunkDefines + "#define RECORDS_ONLY\n");
+            recordProg->AddMacro("SH_EVAL", shEval);
+            if (!recordProg->LoadCompute("./shader/preprocess_compute.glsl"))
+            {
+                Log::E("Error loading preprocess compute shader!\n");
+                return false;
+            }
+        }
+        else
         {
-            Log::E("Error loading sort compute shader!\n");
+            preSortProg->AddMacro("DEFINES", preSortDefines);
+            if (!preSortProg->LoadCompute("./shader/presort_compute.glsl"))
+            {
+                Log::E("Error loading pre-sort compute shader!\n");
+                return false;
+            }
+        }
+
+        sortArgsProg = std::make_shared<Program>();
+        if (!sortArgsProg->LoadCompute("./shader/sort_args_compute.glsl"))
+        {
+            Log::E("Error loading sort args compute shader!\n");
             return false;
         }
+    }
 
-        histogramProg = std::make_shared<Program>();
-        if (!histogramProg->LoadCompute("shader/multi_radixsort_histograms.glsl"))
+    if (useMultiRadixSort && !useTileRender)
+    {
+        multiRadixSorter = std::make_shared<MultiRadixSorter>();
+        if (!multiRadixSorter->Init(splatCache->GetNumSplats(), numBlocksPerWorkgroup))
         {
-            Log::E("Error loading histogram compute shader!\n");
+            Log::E("Error initializing multi radix sort!\n");
             return false;
         }
     }
 
-    BuildVertexArrayObject(gaussianCloud);
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (useInterleavedAttribs)
+        {
+            BuildInterleavedVertexArrayObject(*splatCache);
+        }
+        else
+        {
+            BuildVertexArrayObject(*splatCache);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        Log::I("SplatRenderer: built %s vertex buffers in %.3f sec\n", useInterleavedAttribs ? "interleaved" : "separate", elapsed.count());
+    }
 
-    depthVec.resize(gaussianCloud->size());
+    const glm::vec4* positions = reinterpret_cast<const glm::vec4*>(splatCache->GetArray(SplatCache::Position));
+    sceneMin = glm::vec3(std::numeric_limits<float>::max());
+    sceneMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < numSplats; i++)
+    {
+        sceneMin = glm::min(sceneMin, glm::vec3(positions[i]));
+        sceneMax = glm::max(sceneMax, glm::vec3(positions[i]));
+    }
 
-    if (useMultiRadixSort)
+    if (sortMethod == SortMethod::Cpu || measureSortError)
     {
-        Log::I("using multi_radixsort.glsl\n");
+        posVec.assign(positions, positions + numSplats);
+    }
+    sortStats = SortStats();
+    incrementalStatsBase = CpuSorter::IncrementalStats();
 
-        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
+    if (useSHColorCache)
+    {
+        shColorCache = std::make_shared<SHColorCache>();
+        shColorCache->angularTolerance = shColorTolerance;
+        shColorCache->numPhases = shColorPhases;
+        if (!shColorCache->Init(numSplats, defines + GetSplatLayoutDefines(*splatCache), shEval))
+        {
+            Log::E("Error initializing sh color cache!\n");
+            return false;
+        }
+    }
 
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(gaussianCloud->size());
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
-        const uint32_t RADIX_SORT_BINS = 256;
+    if (useTileRender)
+    {
+        Log::I("using TileRasterizer with %s\n", useOnesweepSort ? "OnesweepSorter" : "multi_radixsort.glsl");
+        tileRasterizer = std::make_shared<TileRasterizer>();
+        if (!tileRasterizer->Init(numSplats, defines + GetSplatLayoutDefines(*splatCache), shEval, useOnesweepSort, numBlocksPerWorkgroup))
+        {
+            Log::E("Error initializing tile rasterizer!\n");
+            return false;
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::Init() end");
+        return true;
+    }
 
-        std::vector<uint32_t> histogramVec(NUM_WORKGROUPS * RADIX_SORT_BINS, 0);
-        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+    if (sortMethod == SortMethod::Cpu)
+    {
+        Log::I("using CpuSorter\n");
+        if (useAsyncSort)
+        {
+            cpuSortWorker = std::make_shared<CpuSortWorker>(posVec.data(), numSplats, useIncrementalSort);
+        }
+        else
+        {
+            cpuSorter = std::make_shared<CpuSorter>();
+        }
+        sortCount = 0;
+        frameCount = 0;
+        hasSortedOrder = false;
+
+        GL_ERROR_CHECK("SplatRenderer::Init() end");
+        return true;
+    }
+
+    depthVec.resize(numSplats);
+
+    if (useOnesweepSort)
+    {
+        Log::I("using OnesweepSorter\n");
+
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
+        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
+        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, splatCache->GetArray(SplatCache::Position), 4, numSplats);
+    }
+    else if (useMultiRadixSort)
+    {
+        Log::I("using multi_radixsort.glsl\n");
 
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
+        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
         valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
         valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, splatCache->GetArray(SplatCache::Position), 4, numSplats);
     }
     else
     {
         Log::I("using rgc::radix_sort\n");
         keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, splatCache->GetArray(SplatCache::Position), 4, numSplats);
 
-        sorter = std::make_shared<rgc::radix_sort::sorter>(gaussianCloud->size());
+        sorter = std::make_shared<rgc::radix_sort::sorter>(numSplats);
     }
 
     atomicCounterVec.resize(1, 0);
-    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT);
+
+    if (recordProg)
+    {
+        std::vector<glm::vec4> recordVec(numSplats * 3, glm::vec4(0.0f, 0.0f, 0.0f, 0.0f));
+        recordBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, recordVec, GL_DYNAMIC_STORAGE_BIT);
+
+        if (useSHLod && measureSHLod)
+        {
+            shLodStatsVec.assign(SH_LOD_STATS_SIZE, 0);
+            shLodStatsBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, shLodStatsVec, GL_DYNAMIC_STORAGE_BIT);
+            shLodReadbackBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, shLodStatsVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        }
+    }
+
+    std::vector<uint32_t> indirectVec(INDIRECT_BUFFER_SIZE, 0);
+    indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    if (useChunkCulling)
+    {
+        chunkVec = splatCache->ComputeChunks(CHUNK_SIZE);
+        visibleChunkVec.resize(chunkVec.size());
+        std::iota(visibleChunkVec.begin(), visibleChunkVec.end(), 0);
+        visibleChunkBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, visibleChunkVec, GL_DYNAMIC_STORAGE_BIT);
+        Log::I("SplatRenderer: culling %d chunks of %u splats\n", (int)chunkVec.size(), CHUNK_SIZE);
+    }
 
     GL_ERROR_CHECK("SplatRenderer::Init() end");
 
@@ -141,162 +446,457 @@ void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
 {
     ZoneScoped;
 
+    // once per frame, like the sort, so in vr both eyes are drawn with the colors seen from the first one.
+    if (shColorCache)
+    {
+        UpdateSHColors(cameraMat);
+    }
+
+    // the tile rasterizer sorts each view in Render()
+    if (tileRasterizer)
+    {
+        return;
+    }
+
     GL_ERROR_CHECK("SplatRenderer::Sort() begin");
 
-    const size_t numPoints = posVec.size();
+    const size_t numPoints = numSplats;
     glm::mat4 modelViewMat = glm::inverse(cameraMat);
+    glm::mat4 modelViewProj = projMat * modelViewMat;
 
-    bool useMultiRadixSort = GLEW_KHR_shader_subgroup && !useRgcSortOverride;
+    bool useMultiRadixSort = sortMethod == SortMethod::MultiRadix;
+    bool useRgcSort = sortMethod == SortMethod::Rgc;
 
-    // 24 bit radix sort still has some artifacts on some datasets, so use 32 bit sort.
-    //const uint32_t NUM_BYTES = useMultiRadixSort ? 3 : 4;
-    //const uint32_t MAX_DEPTH = useMultiRadixSort ? 16777215 : std::numeric_limits<uint32_t>::max();
-    const uint32_t NUM_BYTES = 4;
-    const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
+    // keys only cover the depth range of the splats that can be visible in this view, instead of 0 .. nearFar.y,
+    // so usually 16 or 24 bits are enough and the multi radix sort can skip passes.
+    glm::vec2 depthRange = ComputeSceneDepthRange(modelViewProj);
+    if (useChunkCulling)
+    {
+        // the pre-sort keeps the splats whose center is within 1.5 of clip space, the records keep the ones whose 3 sigma
+        // bounds reach the padded viewport, plus 2 pixels for the low-pass filter, which grows every splat a little.
+        glm::vec2 clip(1.5f, 1.5f);
+        if (recordBuffer)
+        {
+            clip = glm::vec2(1.0f + 2.0f * cullPadding) + 4.0f / glm::vec2(viewport.z, viewport.w);
+        }
+        glm::vec2 chunkDepthRange = CullChunks(modelViewProj, clip);
+        sortStats.visibleChunkFraction = chunkVec.empty() ? 0.0f : (float)visibleChunkVec.size() / (float)chunkVec.size();
+        if (!visibleChunkVec.empty())
+        {
+            depthRange = chunkDepthRange;
+        }
+    }
+    SortKeyParams keyParams = ComputeSortKeyParams(depthRange, nearFar);
+    if (useRgcSort)
+    {
+        // always sorts all 32 bits
+        keyParams.numBits = 32;
+    }
+    sortStats.lastKeyBits = keyParams.numBits;
+
+    if (sortMethod == SortMethod::Cpu)
+    {
+        if (cpuSortWorker)
+        {
+            SortOnCpuAsync(cameraMat, modelViewProj, keyParams);
+        }
+        else
+        {
+            SortOnCpu(modelViewProj, keyParams);
+        }
+
+        if (measureSortError)
+        {
+            const std::vector<uint32_t>& indices = cpuSortWorker ? sortedIndexVec : cpuSorter->GetIndexVec();
+            UpdateOrderingError(CpuSorter::MeasureOrderingError(posVec.data(), indices.data(), indices.size(), modelViewProj));
+        }
+        return;
+    }
+
+    sortStats.numSorts++;
+
+    // with KEEP_CULLED the max key is reserved for culled splats
+    const uint32_t MAX_DEPTH = std::min(keyParams.GetKeyMax(), std::numeric_limits<uint32_t>::max() - (useRgcSort ? 1 : 0));
+
+    // the sorted indices are written straight into the element buffer, so they don't have to be copied afterwards.
+    GLuint elementBuffer = splatVao->GetElementBuffer()->GetObj();
 
     {
         ZoneScopedNC("pre-sort", tracy::Color::Red4);
 
         preSortProg->Bind();
-        preSortProg->SetUniform("modelViewProj", projMat * modelViewMat);
-        preSortProg->SetUniform("nearFar", nearFar);
+        preSortProg->SetUniform("depthRange", glm::vec2(keyParams.minDepth, 1.0f / (keyParams.maxDepth - keyParams.minDepth)));
         preSortProg->SetUniform("keyMax", MAX_DEPTH);
 
         // reset counter back to zero
         atomicCounterVec[0] = 0;
         atomicCounterBuffer->Update(atomicCounterVec);
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
+        if (recordBuffer)
+        {
+            // projects the splats, for Render(), as well as writing the keys
+            SetRecordUniforms(preSortProg, cameraMat, projMat, viewport, nearFar);
+            preSortProg->SetUniform("cullPadding", glm::vec2(viewport.z, viewport.w) * cullPadding);
+            recordCameraMat = cameraMat;
+            recordProjMat = projMat;
+            recordViewport = viewport;
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, recordBuffer->GetObj());  // writeonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, atomicCounterBuffer->GetObj());
+            if (shColorCache)
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, shColorCache->GetColorBuffer());  // readonly
+            }
+            if (shLodStatsBuffer)
+            {
+                ReadSHLodStats();
+                std::vector<uint32_t> zeroVec(SH_LOD_STATS_SIZE, 0);
+                shLodStatsBuffer->Update(zeroVec);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, shLodStatsBuffer->GetObj());
+            }
+        }
+        else
+        {
+            preSortProg->SetUniform("modelViewProj", modelViewProj);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
+            glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
+        }
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());  // writeonly
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());  // writeonly
-        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, useRgcSort ? elementBuffer : valBuffer->GetObj());  // writeonly
 
-        const int LOCAL_SIZE = 256;
-        glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1); // Assuming LOCAL_SIZE threads per group
+        if (useChunkCulling)
+        {
+            // one workgroup per visible chunk, culled above
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, visibleChunkBuffer->GetObj());  // readonly
+            glDispatchCompute((GLuint)visibleChunkVec.size(), 1, 1);
+        }
+        else
+        {
+            const int LOCAL_SIZE = 256;
+            glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1); // Assuming LOCAL_SIZE threads per group
+        }
         glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
 
+        // keep a copy of the sh lod stats, which is read back once this frame is done, see ReadSHLodStats()
+        if (shLodStatsBuffer && !shLodFence)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, shLodStatsBuffer->GetObj());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, shLodReadbackBuffer->GetObj());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, SH_LOD_STATS_SIZE * sizeof(uint32_t));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            shLodFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        if (shLodStatsBuffer)
+        {
+            // nothing else may count into this frame's stats
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, 0);
+        }
+
         GL_ERROR_CHECK("SplatRenderer::Sort() pre-sort");
     }
 
     {
-        ZoneScopedNC("get-count", tracy::Color::Green);
+        // the visible count stays on the gpu, it's turned into the indirect dispatch and draw commands used below.
+        // reading it back here would stall until the pre-sort has finished.
+        ZoneScopedNC("sort-args", tracy::Color::Green);
+
+        uint32_t numElementsPerWorkgroup = 1;
+        if (useMultiRadixSort)
+        {
+            multiRadixSorter->SetNumBlocksPerWorkgroup(numBlocksPerWorkgroup);
+            numElementsPerWorkgroup = multiRadixSorter->GetElementsPerWorkgroup();
+        }
+        else if (sortMethod == SortMethod::Onesweep)
+        {
+            numElementsPerWorkgroup = OnesweepSorter::GetTileSize();
+        }
+
+        sortArgsProg->Bind();
+        sortArgsProg->SetUniform("numElementsPerWorkgroup", numElementsPerWorkgroup);
+        sortArgsProg->SetUniform("maxCount", (uint32_t)numPoints);
 
-        atomicCounterBuffer->Read(atomicCounterVec);
-        sortCount = atomicCounterVec[0];
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atomicCounterBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer->GetObj());  // writeonly
 
-        assert(sortCount <= (uint32_t)numPoints);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
 
-        GL_ERROR_CHECK("SplatRenderer::Render() get-count");
+        GL_ERROR_CHECK("SplatRenderer::Sort() sort-args");
     }
 
-    if (useMultiRadixSort)
+    if (sortMethod == SortMethod::Onesweep)
+    {
+        ZoneScopedNC("sort", tracy::Color::Red4);
+        onesweepSorter->Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                             elementBuffer, indirectBuffer->GetObj(), keyParams.numBits);
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        GL_ERROR_CHECK("SplatRenderer::Sort() onesweep sort");
+    }
+    else if (useMultiRadixSort)
+    {
+        ZoneScopedNC("sort", tracy::Color::Red4);
+        multiRadixSorter->Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                               elementBuffer, indirectBuffer->GetObj(), keyParams.numBits);
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        GL_ERROR_CHECK("SplatRenderer::Sort() multi radix sort");
+    }
+    else
     {
         ZoneScopedNC("sort", tracy::Color::Red4);
+        sorter->sort(keyBuffer->GetObj(), elementBuffer, numPoints);
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        GL_ERROR_CHECK("SplatRenderer::Sort() rgc sort");
+    }
 
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(sortCount);
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
+    if (measureSortError)
+    {
+        ZoneScopedNC("measure-sort-error", tracy::Color::Yellow);
 
-        sortProg->Bind();
-        sortProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        sortProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        sortProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+        std::vector<uint32_t> indirectVec(INDIRECT_BUFFER_SIZE, 0);
+        indirectBuffer->Read(indirectVec);
+        std::vector<uint32_t> sortedVec(numSplats, 0);
+        splatVao->GetElementBuffer()->Read(sortedVec);
+        UpdateOrderingError(CpuSorter::MeasureOrderingError(posVec.data(), sortedVec.data(), indirectVec[DRAW_INDIRECT_COUNT], modelViewProj));
 
-        histogramProg->Bind();
-        histogramProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        //histogramProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        histogramProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+        GL_ERROR_CHECK("SplatRenderer::Sort() measure-sort-error");
+    }
+}
+
+void SplatRenderer::ApplySortProfile(size_t numSplatsIn)
+{
+    SortProfile profile;
+    profile.ImportJson(sortProfileFilename);
 
-        for (uint32_t i = 0; i < NUM_BYTES; i++)
+    std::string renderer = SortProfile::GetRenderer();
+    SortProfile::Entry entry;
+    if (retuneSort || !profile.Find(renderer, numSplatsIn, entry))
+    {
+        if (!SortTuner::Tune(numSplatsIn, entry))
+        {
+            return;
+        }
+        profile.Set(renderer, numSplatsIn, entry);
+        if (!profile.ExportJson(sortProfileFilename))
         {
-            histogramProg->Bind();
-            histogramProg->SetUniform("g_shift", 8 * i);
+            Log::W("Failed to write sort profile \"%s\"\n", sortProfileFilename.c_str());
+        }
+    }
 
-            if (i == 0 || i == 2)
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-            }
-            else
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-            }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+    Log::I("sort profile: %s, numBlocksPerWorkgroup = %u, %.3f ms\n", entry.sortMethod.c_str(), entry.numBlocksPerWorkgroup, entry.ms);
+    if (entry.sortMethod == "multi_radix" && MultiRadixSorter::IsSupported())
+    {
+        sortMethod = SortMethod::MultiRadix;
+        numBlocksPerWorkgroup = entry.numBlocksPerWorkgroup;
+    }
+    else if (entry.sortMethod == "rgc")
+    {
+        sortMethod = SortMethod::Rgc;
+    }
+    else if (entry.sortMethod == "onesweep")
+    {
+        // sortMethod stays Auto, which uses it without validating it again, SortTuner only keeps it if it passed.
+        isOnesweepProfiled = true;
+    }
+}
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+glm::vec2 SplatRenderer::ComputeSceneDepthRange(const glm::mat4& modelViewProj) const
+{
+    // depth is clip space w, which is affine in the position, so its range over the corners of the scene bounds
+    // is also its range over all the splats.
+    glm::vec2 depthRange(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 corner((i & 1) ? sceneMax.x : sceneMin.x, (i & 2) ? sceneMax.y : sceneMin.y, (i & 4) ? sceneMax.z : sceneMin.z, 1.0f);
+        float depth = (modelViewProj * corner).w;
+        depthRange.x = std::min(depthRange.x, depth);
+        depthRange.y = std::max(depthRange.y, depth);
+    }
+    return depthRange;
+}
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+SortKeyParams SplatRenderer::ComputeSortKeyParams(const glm::vec2& depthRange, const glm::vec2& nearFar) const
+{
+    SortKeyParams keyParams;
+    keyParams.minDepth = depthRange.x;
+    keyParams.maxDepth = depthRange.y;
 
-            sortProg->Bind();
-            sortProg->SetUniform("g_shift", 8 * i);
+    // splats nearer than the near plane are clipped anyway, so they can all share the largest key.
+    keyParams.minDepth = std::max(keyParams.minDepth, nearFar.x);
+    keyParams.maxDepth = std::max(keyParams.maxDepth, keyParams.minDepth + sortKeyPrecision);
 
-            if ((i % 2) == 0)  // even
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer2->GetObj());
-            }
-            else  // odd
+    keyParams.numBits = sortKeyBits;
+    if (keyParams.numBits == 0)
+    {
+        const uint32_t NUM_BITS[] = {16, 24, 32};
+        for (uint32_t numBits : NUM_BITS)
+        {
+            keyParams.numBits = numBits;
+            if (keyParams.GetResolution() <= sortKeyPrecision)
             {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer->GetObj());
+                break;
             }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+        }
+    }
+    return keyParams;
+}
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+void SplatRenderer::UpdateOrderingError(const CpuSorter::OrderingError& error)
+{
+    sortStats.orderingError.fraction = std::max(sortStats.orderingError.fraction, error.fraction);
+    sortStats.orderingError.maxInversion = std::max(sortStats.orderingError.maxInversion, error.maxInversion);
+}
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+void SplatRenderer::SortOnCpu(const glm::mat4& modelViewProj, const SortKeyParams& keyParams)
+{
+    {
+        ZoneScopedNC("cpu-pre-sort", tracy::Color::Red4);
+        if (useIncrementalSort)
+        {
+            sortCount = (uint32_t)cpuSorter->SortIncremental(posVec.data(), numSplats, modelViewProj, keyParams);
+        }
+        else
+        {
+            sortCount = (uint32_t)cpuSorter->ComputeKeys(posVec.data(), numSplats, modelViewProj, keyParams);
         }
+    }
 
-        GL_ERROR_CHECK("SplatRenderer::Sort() sort");
+    if (!useIncrementalSort)
+    {
+        ZoneScopedNC("cpu-sort", tracy::Color::Red4);
+        cpuSorter->Sort(keyParams.numBits);
+    }
 
-        // indicate if keys are sorted properly or not.
-        if (false)
+    {
+        ZoneScopedNC("upload-sorted", tracy::Color::DarkGreen);
+        splatVao->GetElementBuffer()->Update(cpuSorter->GetIndexVec());
+        sortStats.numSorts++;
+        GL_ERROR_CHECK("SplatRenderer::Sort() upload-sorted");
+    }
+}
+
+void SplatRenderer::SortOnCpuAsync(const glm::mat4& cameraMat, const glm::mat4& modelViewProj, const SortKeyParams& keyParams)
+{
+    frameCount++;
+
+    auto takeResult = [this]()
+    {
+        if (cpuSortWorker->TakeResult(sortedIndexVec))
         {
-            std::vector<uint32_t> sortedKeyVec(numPoints, 0);
-            keyBuffer->Read(sortedKeyVec);
+            ZoneScopedNC("upload-sorted", tracy::Color::DarkGreen);
+            sortCount = (uint32_t)sortedIndexVec.size();
+            splatVao->GetElementBuffer()->Update(sortedIndexVec);
+            sortedFrame = pendingFrame;
+            sortedCameraMat = pendingCameraMat;
+            hasSortedOrder = true;
+            sortStats.numSorts++;
+            GL_ERROR_CHECK("SplatRenderer::Sort() upload-sorted");
+        }
+    };
 
-            GL_ERROR_CHECK("SplatRenderer::Sort() READ buffer");
+    auto request = [this, &cameraMat, &modelViewProj, &keyParams]()
+    {
+        if (cpuSortWorker->Request(modelViewProj, keyParams))
+        {
+            pendingFrame = frameCount;
+            pendingCameraMat = cameraMat;
+        }
+    };
 
-            bool sorted = true;
-            for (uint32_t i = 1; i < sortCount; i++)
-            {
-                if (sortedKeyVec[i - 1] > sortedKeyVec[i])
-                {
-                    sorted = false;
-                    break;
-                }
-            }
+    // keep the worker busy, it will be sorting this frame's view, unless it's still on an older one.
+    takeResult();
+    request();
 
-            printf("%s", sorted ? "o" : "x");
+    if (IsSortStale(cameraMat))
+    {
+        ZoneScopedNC("wait-sort", tracy::Color::Red4);
+        sortStats.numWaits++;
+        cpuSortWorker->Wait();
+        takeResult();
+
+        // the sort that was in flight was for an older view, sort this one.
+        if (IsSortStale(cameraMat))
+        {
+            request();
+            cpuSortWorker->Wait();
+            takeResult();
         }
     }
-    else
+
+    if (sortedFrame != frameCount)
     {
-        ZoneScopedNC("sort", tracy::Color::Red4);
-        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), sortCount);
-        GL_ERROR_CHECK("SplatRenderer::Sort() rgc sort");
+        sortStats.numStaleFrames++;
     }
+}
 
+bool SplatRenderer::IsSortStale(const glm::mat4& cameraMat) const
+{
+    if (!hasSortedOrder || frameCount - sortedFrame > maxSortStaleness)
     {
-        ZoneScopedNC("copy-sorted", tracy::Color::DarkGreen);
+        return true;
+    }
+
+    float translation = glm::length(glm::vec3(cameraMat[3]) - glm::vec3(sortedCameraMat[3]));
+
+    // angle of the rotation between the two orientations, from the trace of R0^T * R1.
+    glm::mat3 r = glm::transpose(glm::mat3(sortedCameraMat)) * glm::mat3(cameraMat);
+    float c = glm::clamp((r[0][0] + r[1][1] + r[2][2] - 1.0f) * 0.5f, -1.0f, 1.0f);
+    float rotation = acosf(c);
 
-        if (useMultiRadixSort && (NUM_BYTES % 2) == 1)  // odd
+    return translation > maxSortTranslation || rotation > maxSortRotation;
+}
+
+SplatRenderer::SortStats SplatRenderer::GetSortStats() const
+{
+    SortStats stats = sortStats;
+    if (tileRasterizer)
+    {
+        stats.numTileInstances = tileRasterizer->GetNumInstances();
+    }
+    if (shColorCache)
+    {
+        stats.shRecomputeFraction = shColorCache->GetRecomputeFraction();
+    }
+    if (shLodStatsVec.size() == SH_LOD_STATS_SIZE)
+    {
+        uint32_t numVisible = shLodStatsVec[0] + shLodStatsVec[1] + shLodStatsVec[2] + shLodStatsVec[3];
+        float scale = numVisible ? 1.0f / (float)numVisible : 0.0f;
+        for (int i = 0; i < 4; i++)
         {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer2->GetObj());
+            stats.shLodFractions[i] = shLodStatsVec[i] * scale;
         }
-        else
+        stats.shLodChangedFraction = shLodStatsVec[4] * scale;
+        memcpy(&stats.shLodMaxError, &shLodStatsVec[5], sizeof(float));
+
+        // floats per channel up to each degree, see SplatCache::Array
+        const float SH_FLOATS[4] = {1.0f, 4.0f, 12.0f, 16.0f};
+        for (uint32_t i = 0; i < 4; i++)
         {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
+            stats.shLodBytes += stats.shLodFractions[i] * SH_FLOATS[i] * 3.0f * sizeof(float);
         }
-        glBindBuffer(GL_COPY_WRITE_BUFFER, splatVao->GetElementBuffer()->GetObj());
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sortCount * sizeof(uint32_t));
-
-        GL_ERROR_CHECK("SplatRenderer::Sort() copy-sorted");
+        stats.shFullBytes = SH_FLOATS[shDegree] * 3.0f * sizeof(float);
+    }
+    if (cpuSortWorker)
+    {
+        stats.incrementalStats = cpuSortWorker->GetIncrementalStats();
+    }
+    else if (cpuSorter)
+    {
+        stats.incrementalStats = cpuSorter->GetIncrementalStats();
     }
+    stats.incrementalStats.numIncremental -= incrementalStatsBase.numIncremental;
+    stats.incrementalStats.numFull -= incrementalStatsBase.numFull;
+    return stats;
 }
 
+void SplatRenderer::ResetSortStats()
+{
+    SortStats stats = GetSortStats();
+    incrementalStatsBase.numIncremental += stats.incrementalStats.numIncremental;
+    incrementalStatsBase.numFull += stats.incrementalStats.numFull;
+    sortStats = SortStats();
+}
 
 void SplatRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
                            const glm::vec4& viewport, const glm::vec2& nearFar)
@@ -305,146 +905,337 @@ void SplatRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
     GL_ERROR_CHECK("SplatRenderer::Render() begin");
 
+    if (tileRasterizer)
+    {
+        glm::mat4 modelViewProj = projMat * glm::inverse(cameraMat);
+        SortKeyParams keyParams = ComputeSortKeyParams(ComputeSceneDepthRange(modelViewProj), nearFar);
+        glm::vec2 depthRange(keyParams.minDepth, 1.0f / (keyParams.maxDepth - keyParams.minDepth));
+        tileRasterizer->Render(splatBuffer->GetObj(), shColorCache ? shColorCache->GetColorBuffer() : 0,
+                               cameraMat, projMat, viewport, nearFar, depthRange);
+        sortStats.numSorts++;
+        sortStats.lastKeyBits = 32;
+
+        GL_ERROR_CHECK("SplatRenderer::Render() tile");
+        return;
+    }
+
+    if (recordBuffer && (cameraMat != recordCameraMat || projMat != recordProjMat || viewport != recordViewport))
+    {
+        // another view of the sorted splats, e.g. the second eye in vr, so the records are projected again for it.
+        ZoneScopedNC("reproject", tracy::Color::Red4);
+
+        recordProg->Bind();
+        SetRecordUniforms(recordProg, cameraMat, projMat, viewport, nearFar);
+        recordProg->SetUniform("cullPadding", glm::vec2(0.0f, 0.0f));
+        recordCameraMat = cameraMat;
+        recordProjMat = projMat;
+        recordViewport = viewport;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, recordBuffer->GetObj());  // writeonly
+        if (shColorCache)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, shColorCache->GetColorBuffer());  // readonly
+        }
+
+        if (useChunkCulling)
+        {
+            // only the splats of the chunks that were visible to the sort can have been sorted
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, visibleChunkBuffer->GetObj());  // readonly
+            glDispatchCompute((GLuint)visibleChunkVec.size(), 1, 1);
+        }
+        else
+        {
+            const int LOCAL_SIZE = 256;
+            glDispatchCompute(((GLuint)numSplats + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::Render() reproject");
+    }
+
     {
         ZoneScopedNC("draw", tracy::Color::Red4);
-        float width = viewport.z;
-        float height = viewport.w;
-        float aspectRatio = width / height;
-        glm::mat4 viewMat = glm::inverse(cameraMat);
-        glm::vec3 eye = glm::vec3(cameraMat[3]);
 
         splatProg->Bind();
-        splatProg->SetUniform("viewMat", viewMat);
-        splatProg->SetUniform("projMat", projMat);
         splatProg->SetUniform("viewport", viewport);
-        splatProg->SetUniform("projParams", glm::vec4(0.0f, nearFar.x, nearFar.y, 0.0f));
-        splatProg->SetUniform("eye", eye);
+
+        bool useQuads = renderMethod == RenderMethod::Quad;
+        if (recordBuffer)
+        {
+            // everything else was done by preprocess_compute.glsl
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, splatVao->GetElementBuffer()->GetObj());  // readonly
+        }
+        else
+        {
+            splatProg->SetUniform("viewMat", glm::inverse(cameraMat));
+            splatProg->SetUniform("projMat", projMat);
+            splatProg->SetUniform("projParams", glm::vec4(0.0f, nearFar.x, nearFar.y, 0.0f));
+            if (useSHLod)
+            {
+                SetSHLodUniforms(splatProg);
+            }
+            if (shColorCache)
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, shColorCache->GetColorBuffer());  // readonly
+            }
+            else
+            {
+                splatProg->SetUniform("eye", glm::vec3(cameraMat[3]));
+            }
+        }
+
+        if (useQuads && !recordBuffer)
+        {
+            // one instance per splat, which reads its index from the sorted element buffer
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, splatVao->GetElementBuffer()->GetObj());  // readonly
+        }
 
         splatVao->Bind();
-        glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
+        if (sortMethod == SortMethod::Cpu)
+        {
+            if (useQuads)
+            {
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, sortCount);
+            }
+            else
+            {
+                glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
+            }
+        }
+        else
+        {
+            // the number of visible splats was written to indirectBuffer on the gpu by Sort()
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer->GetObj());
+            if (useQuads)
+            {
+                glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void*)QUAD_DRAW_INDIRECT_OFFSET);
+            }
+            else
+            {
+                glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, (const void*)DRAW_INDIRECT_OFFSET);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
         splatVao->Unbind();
 
         GL_ERROR_CHECK("SplatRenderer::Render() draw");
     }
 }
 
-void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud)
+void SplatRenderer::BuildVertexArrayObject(const SplatCache& splatCache)
 {
     splatVao = std::make_shared<VertexArrayObject>();
 
-    // convert gaussianCloud data into buffers
-    size_t numPoints = gaussianCloud->size();
-    posVec.reserve(numPoints);
+    // the cache is already in gpu layout, so each array is uploaded as is.
+    numSplats = splatCache.GetNumSplats();
+    auto makeBuffer = [&splatCache](SplatCache::Array array)
+    {
+        return std::make_shared<BufferObject>(GL_ARRAY_BUFFER, splatCache.GetArray(array),
+                                              splatCache.GetElementSize(array), splatCache.GetNumSplats());
+    };
 
-    // sh coeff
-    std::vector<glm::vec4> r_sh0Vec, g_sh0Vec, b_sh0Vec;
-    std::vector<glm::vec4> r_sh1Vec, r_sh2Vec, r_sh3Vec, r_sh4Vec;
-    std::vector<glm::vec4> g_sh1Vec, g_sh2Vec, g_sh3Vec, g_sh4Vec;
-    std::vector<glm::vec4> b_sh1Vec, b_sh2Vec, b_sh3Vec, b_sh4Vec;
+    // only upload the sh bands the shader uses.
+    std::vector<std::pair<const char*, std::shared_ptr<BufferObject>>> bufferVec;
+    for (auto&& attrib : SPLAT_ATTRIBS)
+    {
+        if (shDegree >= attrib.minDegree)
+        {
+            bufferVec.push_back(std::make_pair(attrib.name, makeBuffer(attrib.array)));
+        }
+    }
 
-    // 3x3 cov matrix
-    std::vector<glm::vec3> cov3_col0Vec, cov3_col1Vec, cov3_col2Vec;
+    // setup vertex array object with buffers
+    for (auto&& pair : bufferVec)
+    {
+        splatVao->SetAttribBuffer(splatProg->GetAttribLoc(pair.first), pair.second);
+    }
+    splatVao->SetElementBuffer(BuildIndexBuffer());
+}
 
-    r_sh0Vec.reserve(numPoints);
-    g_sh0Vec.reserve(numPoints);
-    b_sh0Vec.reserve(numPoints);
+void SplatRenderer::BuildInterleavedVertexArrayObject(const SplatCache& splatCache)
+{
+    splatVao = std::make_shared<VertexArrayObject>();
+    numSplats = splatCache.GetNumSplats();
 
-    if (useFullSH)
+    // lay out the attributes the shader uses back to back, in floats.
+    struct Slot
     {
-        r_sh1Vec.reserve(numPoints);
-        r_sh2Vec.reserve(numPoints);
-        r_sh3Vec.reserve(numPoints);
-        g_sh1Vec.reserve(numPoints);
-        g_sh2Vec.reserve(numPoints);
-        g_sh3Vec.reserve(numPoints);
-        b_sh1Vec.reserve(numPoints);
-        b_sh2Vec.reserve(numPoints);
-        b_sh3Vec.reserve(numPoints);
+        const SplatAttrib* attrib;
+        const float* src;
+        int elementSize;
+        size_t offset;
+    };
+    std::vector<Slot> slotVec;
+    size_t stride = 0;
+    for (auto&& attrib : SPLAT_ATTRIBS)
+    {
+        if (shDegree >= attrib.minDegree)
+        {
+            int elementSize = splatCache.GetElementSize(attrib.array);
+            slotVec.push_back({&attrib, splatCache.GetArray(attrib.array), elementSize, stride});
+            stride += elementSize;
+        }
     }
 
-    cov3_col0Vec.reserve(numPoints);
-    cov3_col1Vec.reserve(numPoints);
-    cov3_col2Vec.reserve(numPoints);
-
-    for (auto&& g : gaussianCloud->GetGaussianVec())
+    // each splat is written exactly once into the staging buffer, which is freed as soon as it's uploaded.
+    std::vector<float> stagingVec(numSplats * stride);
+    float* dst = stagingVec.data();
+    const size_t MIN_RANGE_SIZE = 16384;
+    ParallelFor(numSplats, MIN_RANGE_SIZE, [&slotVec, dst, stride](size_t begin, size_t end)
     {
-        // stick alpha into position.w
-        float alpha = 1.0f / (1.0f + expf(-g.opacity));
-        posVec.emplace_back(glm::vec4(g.position[0], g.position[1], g.position[2], alpha));
+        // write whole splats at a time, so the writes stay sequential.
+        // doing one attribute at a time instead touches every output cache line once per attribute and is ~3x slower.
+        float* out = dst + begin * stride;
+        for (size_t i = begin; i < end; i++)
+        {
+            for (auto&& slot : slotVec)
+            {
+                memcpy(out + slot.offset, slot.src + i * slot.elementSize, slot.elementSize * sizeof(float));
+            }
+            out += stride;
+        }
+    });
 
-        r_sh0Vec.emplace_back(glm::vec4(g.f_dc[0], g.f_rest[0], g.f_rest[1], g.f_rest[2]));
-        g_sh0Vec.emplace_back(glm::vec4(g.f_dc[1], g.f_rest[15], g.f_rest[16], g.f_rest[17]));
-        b_sh0Vec.emplace_back(glm::vec4(g.f_dc[2], g.f_rest[30], g.f_rest[31], g.f_rest[32]));
+    splatBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, stagingVec.data(), (int)stride, numSplats);
+    std::vector<float>().swap(stagingVec);
 
-        if (useFullSH)
+    // the other render methods pull the attributes from splatBuffer themselves, see GetSplatLayoutDefines()
+    if (renderMethod == RenderMethod::GeometryShader)
+    {
+        for (auto&& slot : slotVec)
         {
-            r_sh1Vec.emplace_back(glm::vec4(g.f_rest[3], g.f_rest[4], g.f_rest[5], g.f_rest[6]));
-            r_sh2Vec.emplace_back(glm::vec4(g.f_rest[7], g.f_rest[8], g.f_rest[9], g.f_rest[10]));
-            r_sh3Vec.emplace_back(glm::vec4(g.f_rest[11], g.f_rest[12], g.f_rest[13], g.f_rest[14]));
-            g_sh1Vec.emplace_back(glm::vec4(g.f_rest[18], g.f_rest[19], g.f_rest[20], g.f_rest[21]));
-            g_sh2Vec.emplace_back(glm::vec4(g.f_rest[22], g.f_rest[23], g.f_rest[24], g.f_rest[25]));
-            g_sh3Vec.emplace_back(glm::vec4(g.f_rest[26], g.f_rest[27], g.f_rest[28], g.f_rest[29]));
-            b_sh1Vec.emplace_back(glm::vec4(g.f_rest[33], g.f_rest[34], g.f_rest[35], g.f_rest[36]));
-            b_sh2Vec.emplace_back(glm::vec4(g.f_rest[37], g.f_rest[38], g.f_rest[39], g.f_rest[40]));
-            b_sh3Vec.emplace_back(glm::vec4(g.f_rest[41], g.f_rest[42], g.f_rest[43], g.f_rest[44]));
+            splatVao->SetAttribBuffer(splatProg->GetAttribLoc(slot.attrib->name), splatBuffer, slot.elementSize,
+                                      stride * sizeof(float), slot.offset * sizeof(float));
         }
+    }
+    splatVao->SetElementBuffer(BuildIndexBuffer());
+}
 
-        glm::mat3 V = g.ComputeCovMat();
-        cov3_col0Vec.push_back(V[0]);
-        cov3_col1Vec.push_back(V[1]);
-        cov3_col2Vec.push_back(V[2]);
+std::string SplatRenderer::GetSplatLayoutDefines(const SplatCache& splatCache) const
+{
+    // same layout as BuildInterleavedVertexArrayObject()
+    std::string defines = "";
+    size_t stride = 0;
+    for (auto&& attrib : SPLAT_ATTRIBS)
+    {
+        if (shDegree >= attrib.minDegree)
+        {
+            std::string name = attrib.name;
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            defines += "#define " + name + "_OFFSET " + std::to_string(stride) + "u\n";
+            stride += splatCache.GetElementSize(attrib.array);
+        }
     }
-    auto positionBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, posVec);
+    defines += "#define SPLAT_STRIDE " + std::to_string(stride) + "u\n";
+    return defines;
+}
 
-    auto r_sh0Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, r_sh0Vec);
-    auto g_sh0Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, g_sh0Vec);
-    auto b_sh0Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, b_sh0Vec);
+void SplatRenderer::UpdateSHColors(const glm::mat4& cameraMat)
+{
+    shColorCache->Update(splatBuffer->GetObj(), glm::vec3(cameraMat[3]));
+}
 
-    auto r_sh1Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, r_sh1Vec);
-    auto r_sh2Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, r_sh2Vec);
-    auto r_sh3Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, r_sh3Vec);
-    auto g_sh1Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, g_sh1Vec);
-    auto g_sh2Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, g_sh2Vec);
-    auto g_sh3Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, g_sh3Vec);
-    auto b_sh1Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, b_sh1Vec);
-    auto b_sh2Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, b_sh2Vec);
-    auto b_sh3Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, b_sh3Vec);
+void SplatRenderer::SetRecordUniforms(std::shared_ptr<Program> prog, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                      const glm::vec4& viewport, const glm::vec2& nearFar) const
+{
+    prog->SetUniform("viewMat", glm::inverse(cameraMat));
+    prog->SetUniform("projMat", projMat);
+    prog->SetUniform("viewport", viewport);
+    if (!shColorCache)
+    {
+        prog->SetUniform("eye", glm::vec3(cameraMat[3]));
+    }
+    prog->SetUniform("zNear", nearFar.x);
+    if (useSHLod)
+    {
+        SetSHLodUniforms(prog);
+    }
+}
 
-    auto cov3_col0Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, cov3_col0Vec);
-    auto cov3_col1Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, cov3_col1Vec);
-    auto cov3_col2Buffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, cov3_col2Vec);
+void SplatRenderer::SetSHLodUniforms(std::shared_ptr<Program> prog) const
+{
+    prog->SetUniform("shLodRadius", shLodRadius);
+    prog->SetUniform("shLodDistance", shLodDistance);
+}
 
-    // build element array
-    indexVec.reserve(numPoints);
-    assert(numPoints <= std::numeric_limits<uint32_t>::max());
-    for (uint32_t i = 0; i < (uint32_t)numPoints; i++)
+void SplatRenderer::ReadSHLodStats()
+{
+    if (!shLodFence || glClientWaitSync((GLsync)shLodFence, 0, 0) == GL_TIMEOUT_EXPIRED)
     {
-        indexVec.push_back(i);
+        return;
     }
-    auto indexBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-
-    // setup vertex array object with buffers
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("position"), positionBuffer);
+    glDeleteSync((GLsync)shLodFence);
+    shLodFence = nullptr;
 
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("r_sh0"), r_sh0Buffer);
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("g_sh0"), g_sh0Buffer);
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("b_sh0"), b_sh0Buffer);
+    shLodReadbackBuffer->Read(shLodStatsVec);
+}
 
-    if (useFullSH)
+glm::vec2 SplatRenderer::CullChunks(const glm::mat4& modelViewProj, const glm::vec2& clip)
+{
+    ZoneScopedNC("cull-chunks", tracy::Color::Red4);
+
+    // -clip.x * w <= x <= clip.x * w, the same for y, and w >= 0, as planes in world space.
+    // the far plane is left out, the sort keys are clamped to the depth range anyway.
+    glm::mat4 rows = glm::transpose(modelViewProj);
+    const glm::vec4 planes[5] = {
+        clip.x * rows[3] - rows[0], clip.x * rows[3] + rows[0],
+        clip.y * rows[3] - rows[1], clip.y * rows[3] + rows[1],
+        rows[3]
+    };
+
+    glm::vec2 depthRange(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    visibleChunkVec.clear();
+    for (uint32_t i = 0; i < (uint32_t)chunkVec.size(); i++)
     {
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("r_sh1"), r_sh1Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("r_sh2"), r_sh2Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("r_sh3"), r_sh3Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("g_sh1"), g_sh1Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("g_sh2"), g_sh2Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("g_sh3"), g_sh3Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("b_sh1"), b_sh1Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("b_sh2"), b_sh2Buffer);
-        splatVao->SetAttribBuffer(splatProg->GetAttribLoc("b_sh3"), b_sh3Buffer);
+        const SplatCache::Chunk& chunk = chunkVec[i];
+        bool visible = true;
+        for (auto&& plane : planes)
+        {
+            // the corner farthest along the normal, if it's behind the plane the whole box is
+            glm::vec3 corner(plane.x > 0.0f ? chunk.aabbMax.x : chunk.aabbMin.x,
+                             plane.y > 0.0f ? chunk.aabbMax.y : chunk.aabbMin.y,
+                             plane.z > 0.0f ? chunk.aabbMax.z : chunk.aabbMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+            {
+                visible = false;
+                break;
+            }
+        }
+        if (visible)
+        {
+            visibleChunkVec.push_back(i);
+
+            // depth is clip space w, the nearest and farthest corners along its gradient bound it over the chunk
+            const glm::vec4& w = planes[4];
+            glm::vec3 nearCorner(w.x > 0.0f ? chunk.aabbMin.x : chunk.aabbMax.x,
+                                 w.y > 0.0f ? chunk.aabbMin.y : chunk.aabbMax.y,
+                                 w.z > 0.0f ? chunk.aabbMin.z : chunk.aabbMax.z);
+            glm::vec3 farCorner(w.x > 0.0f ? chunk.aabbMax.x : chunk.aabbMin.x,
+                                w.y > 0.0f ? chunk.aabbMax.y : chunk.aabbMin.y,
+                                w.z > 0.0f ? chunk.aabbMax.z : chunk.aabbMin.z);
+            depthRange.x = std::min(depthRange.x, glm::dot(glm::vec3(w), nearCorner) + w.w);
+            depthRange.y = std::max(depthRange.y, glm::dot(glm::vec3(w), farCorner) + w.w);
+        }
     }
 
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("cov3_col0"), cov3_col0Buffer);
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("cov3_col1"), cov3_col1Buffer);
-    splatVao->SetAttribBuffer(splatProg->GetAttribLoc("cov3_col2"), cov3_col2Buffer);
-    splatVao->SetElementBuffer(indexBuffer);
+    visibleChunkBuffer->Update(visibleChunkVec);
+    return depthRange;
+}
+
+std::shared_ptr<BufferObject> SplatRenderer::BuildIndexBuffer()
+{
+    // build element array
+    size_t numPoints = numSplats;
+    indexVec.clear();
+    indexVec.reserve(numPoints);
+    assert(numPoints <= std::numeric_limits<uint32_t>::max());
+    for (uint32_t i = 0; i < (uint32_t)numPoints; i++)
+    {
+        indexVec.push_back(i);
+    }
+    // measureSortError reads the sorted indices back
+    return std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT | (measureSortError ? GL_MAP_READ_BIT : 0));
 }
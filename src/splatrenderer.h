@@ -6,14 +6,23 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <limits>
 #include <memory>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "core/program.h"
 #include "core/vertexbuffer.h"
 
+#include "cpusort.h"
 #include "gaussiancloud.h"
+#include "multiradixsort.h"
+#include "onesweepsort.h"
+#include "shcolorcache.h"
+#include "sorttuner.h"
+#include "splatcache.h"
+#include "tilerasterizer.h"
 
 namespace rgc::radix_sort
 {
@@ -29,6 +38,10 @@ public:
     bool Init(std::shared_ptr<GaussianCloud> gaussianCloud, bool isFramebufferSRGBEnabledIn,
               bool useFullSHIn, bool useRgcSortOverrideIn);
 
+    // same as above, but uploads attributes that have already been converted into gpu layout.
+    bool Init(std::shared_ptr<SplatCache> splatCache, bool isFramebufferSRGBEnabledIn,
+              bool useFullSHIn, bool useRgcSortOverrideIn);
+
     void Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
                  const glm::vec4& viewport, const glm::vec2& nearFar);
 
@@ -36,32 +49,196 @@ public:
     void Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
                 const glm::vec4& viewport, const glm::vec2& nearFar);
 public:
-    uint32_t numBlocksPerWorkgroup = 1024;
+    enum class SortMethod
+    {
+        Auto,  // Onesweep if it's supported and passes OnesweepSorter::Validate(), else MultiRadix if KHR_shader_subgroup is supported, otherwise Rgc
+        MultiRadix,  // multi_radixsort.glsl
+        Onesweep,  // OnesweepSorter
+        Rgc,  // rgc::radix_sort
+        Cpu  // CpuSorter, only the sorted indices are uploaded
+    };
+
+    // must be set before Init(), after Init() it holds the method that is actually used.
+    SortMethod sortMethod = SortMethod::Auto;
+
+    enum class RenderMethod
+    {
+        Quad,  // one global depth sort, then each splat is an instanced quad that pulls its attributes, see splat_quad_vert.glsl
+        GeometryShader,  // one global depth sort, then each splat is drawn as a point and expanded to a quad by splat_geom.glsl
+        Tile  // TileRasterizer, compute only, needs the onesweep or multi radix sort
+    };
+
+    // must be set before Init(), after Init() it holds the method that is actually used.
+    // Tile falls back to Quad, and Quad falls back to GeometryShader, which is also used with separate attribs.
+    RenderMethod renderMethod = RenderMethod::Quad;
+
+    // with SortMethod::Cpu, repair the previous frame's order instead of sorting from scratch when possible.
+    // see CpuSorter::SortIncremental()
+    bool useIncrementalSort = false;
+
+    // with SortMethod::Cpu, sort on a worker thread and draw with the most recently finished order.
+    // Sort() only waits for the worker when that order is more than maxSortStaleness frames old,
+    // or the camera has moved more than maxSortTranslation or turned more than maxSortRotation since it was sorted.
+    bool useAsyncSort = false;
+    uint32_t maxSortStaleness = 4;
+    float maxSortTranslation = 0.05f;
+    float maxSortRotation = 0.035f;  // radians, about 2 degrees
+
+    struct SortStats
+    {
+        uint64_t numSorts = 0;  // sorted orders that were uploaded, or sorted on the gpu
+        uint64_t numStaleFrames = 0;  // async only, frames drawn with an order sorted for an earlier frame
+        uint64_t numWaits = 0;  // async only, frames that had to wait for the worker
+        CpuSorter::IncrementalStats incrementalStats;  // SortMethod::Cpu only
+        uint32_t lastKeyBits = 0;  // key size of the last sort
+        CpuSorter::OrderingError orderingError;  // worst since the last reset, only with measureSortError
+        uint32_t numTileInstances = 0;  // RenderMethod::Tile only, (tile, splat) pairs in a recent frame, see TileRasterizer
+        float shRecomputeFraction = 0.0f;  // useSHColorCache only, fraction of the colors evaluated again in a recent frame
+        float visibleChunkFraction = 0.0f;  // useChunkCulling only, chunks that passed the frustum test in the last sort
+
+        // measureSHLod only, from a recent frame
+        float shLodFractions[4] = {};  // visible splats drawn with sh degree 0 - 3
+        float shLodChangedFraction = 0.0f;  // visible splats whose color differs from the full sh by more than 1/255
+        float shLodMaxError = 0.0f;  // largest difference of a color channel, 0 - 1
+        float shLodBytes = 0.0f;  // sh coefficients read per visible splat, on average
+        float shFullBytes = 0.0f;  // the same without the lod
+    };
+
+    // totals since Init() or the last ResetSortStats()
+    SortStats GetSortStats() const;
+    void ResetSortStats();
+
+    // sort keys are 16, 24 or 32 bits and the multi radix sort does one pass per 8 bits.
+    // 0 picks, every frame, the fewest bits that keep SortKeyParams::GetResolution() under sortKeyPrecision,
+    // for the depth range of the chunks that pass CullChunks() in that view, or of the whole scene without chunk culling.
+    // rgc::radix_sort always uses 32 bits.
+    uint32_t sortKeyBits = 0;
+    float sortKeyPrecision = 0.001f;  // world units
+
+    // read back the sorted order every frame and check it against the exact splat depths, see SortStats::orderingError.
+    // this stalls the gpu sorts, so it's only meant for debugging. must be set before Init()
+    bool measureSortError = false;
+
+    // see MultiRadixSorter, each workgroup sorts numBlocksPerWorkgroup * 256 keys.
+    // with a sort profile, this is replaced by the value measured on this gpu.
+    uint32_t numBlocksPerWorkgroup = 32;
+
+    // with SortMethod::Auto, Init() picks the sort that was fastest on this gpu, for this number of splats,
+    // from this SortProfile file. if it has no entry yet the sorts are timed first, see SortTuner, and the result is saved.
+    // empty to disable. must be set before Init()
+    std::string sortProfileFilename;
+    bool retuneSort = false;  // time the sorts again, even if the profile already has an entry
+
+    // upload all splat attributes as a single interleaved vertex buffer, instead of one buffer per attribute.
+    // must be set before Init()
+    bool useInterleavedAttribs = true;
+
+    // with instanced quads and a gpu sort, Sort() culls the splats whose 3 sigma bounds miss the viewport.
+    // splats up to this fraction of the viewport size outside of it are kept, so another view can be drawn with
+    // the same sort, e.g. the other eye in vr.
+    float cullPadding = 0.0f;
+
+    // with the onesweep or multi radix sort, Sort() first tests the bounds of each run of CHUNK_SIZE consecutive splats
+    // against the frustum on the cpu, and only pre-sorts the splats of the visible chunks.
+    // the splats should be in spatial order, see GaussianCloud::SortByMortonOrder(). must be set before Init()
+    bool useChunkCulling = true;
+    static const uint32_t CHUNK_SIZE = 256;  // must match the local_size of presort_compute.glsl and preprocess_compute.glsl
+
+    // keep the view dependent color of each splat in a buffer, and only evaluate its SH again once the direction
+    // it's seen from has turned by more than shColorTolerance, see SHColorCache.
+    // needs instanced quads or tile rendering. must be set before Init()
+    bool useSHColorCache = false;
+    float shColorTolerance = 0.01f;  // radians
+    uint32_t shColorPhases = 1;  // see SHColorCache::numPhases
+
+    // evaluate the sh of each splat only up to the degree its size on screen and its distance call for,
+    // see SelectSHDegree() in sh_eval.glsl, so the higher coefficients of small and distant splats are never read.
+    // needs instanced quads, and is not used with the sh color cache. must be set before Init()
+    bool useSHLod = false;
+    glm::vec2 shLodRadius = glm::vec2(2.0f, 6.0f);  // pixels, dc only below x, first degree below y
+    glm::vec2 shLodDistance = glm::vec2(std::numeric_limits<float>::max());  // first degree beyond x, dc only beyond y
+
+    // count the splats drawn with each degree, and compare their colors with the full sh, see SortStats.
+    // slower, the full sh is evaluated as well. gpu sorts only, must be set before Init()
+    bool measureSHLod = false;
 protected:
-    void BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud);
+    void BuildVertexArrayObject(const SplatCache& splatCache);
+    void BuildInterleavedVertexArrayObject(const SplatCache& splatCache);
+    std::shared_ptr<BufferObject> BuildIndexBuffer();
+    // offsets of each attribute in splatBuffer, for the shaders that read it as a storage buffer
+    std::string GetSplatLayoutDefines(const SplatCache& splatCache) const;
+    void UpdateSHColors(const glm::mat4& cameraMat);
+    void SetSHLodUniforms(std::shared_ptr<Program> prog) const;
+    void ReadSHLodStats();
+    // returns the (min, max) depth of the visible chunks, min > max if none are visible.
+    glm::vec2 CullChunks(const glm::mat4& modelViewProj, const glm::vec2& clip);
+    // the view uniforms of preprocess_compute.glsl, prog must be bound
+    void SetRecordUniforms(std::shared_ptr<Program> prog, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                           const glm::vec4& viewport, const glm::vec2& nearFar) const;
+
+    void ApplySortProfile(size_t numSplatsIn);
+    // (min, max) depth of the scene bounds in this view
+    glm::vec2 ComputeSceneDepthRange(const glm::mat4& modelViewProj) const;
+    SortKeyParams ComputeSortKeyParams(const glm::vec2& depthRange, const glm::vec2& nearFar) const;
+    void UpdateOrderingError(const CpuSorter::OrderingError& error);
+    void SortOnCpu(const glm::mat4& modelViewProj, const SortKeyParams& keyParams);
+    void SortOnCpuAsync(const glm::mat4& cameraMat, const glm::mat4& modelViewProj, const SortKeyParams& keyParams);
+    bool IsSortStale(const glm::mat4& cameraMat) const;
 
     std::shared_ptr<rgc::radix_sort::sorter> sorter;
+    std::shared_ptr<MultiRadixSorter> multiRadixSorter;
+    std::shared_ptr<OnesweepSorter> onesweepSorter;
+    std::shared_ptr<CpuSorter> cpuSorter;
+    std::shared_ptr<TileRasterizer> tileRasterizer;
+    std::shared_ptr<SHColorCache> shColorCache;
+    std::vector<glm::vec4> posVec;  // only kept for the cpu sort and measureSortError
+    std::shared_ptr<CpuSortWorker> cpuSortWorker;  // must be destroyed before posVec
+    std::vector<uint32_t> sortedIndexVec;
+    uint64_t frameCount;
+    uint64_t pendingFrame;  // frame of the sort in flight
+    glm::mat4 pendingCameraMat;
+    uint64_t sortedFrame;  // frame of the order in the element buffer
+    glm::mat4 sortedCameraMat;
+    bool hasSortedOrder;
+    SortStats sortStats;
+    CpuSorter::IncrementalStats incrementalStatsBase;  // at the last ResetSortStats()
     std::shared_ptr<Program> splatProg;
     std::shared_ptr<Program> preSortProg;
-    std::shared_ptr<Program> histogramProg;
-    std::shared_ptr<Program> sortProg;
+    std::shared_ptr<Program> sortArgsProg;
+    std::shared_ptr<Program> recordProg;  // reprojects the records for a view other than the sorted one
     std::shared_ptr<VertexArrayObject> splatVao;
+    std::shared_ptr<BufferObject> splatBuffer;  // only with useInterleavedAttribs
 
     std::vector<uint32_t> indexVec;
     std::vector<uint32_t> depthVec;
-    std::vector<glm::vec4> posVec;
     std::vector<uint32_t> atomicCounterVec;
 
     std::shared_ptr<BufferObject> keyBuffer;
     std::shared_ptr<BufferObject> keyBuffer2;
-    std::shared_ptr<BufferObject> histogramBuffer;
     std::shared_ptr<BufferObject> valBuffer;
     std::shared_ptr<BufferObject> valBuffer2;
     std::shared_ptr<BufferObject> posBuffer;
     std::shared_ptr<BufferObject> atomicCounterBuffer;
+    std::shared_ptr<BufferObject> recordBuffer;  // 2D splats, see preprocess_compute.glsl
+    glm::mat4 recordCameraMat;  // view the records were projected for
+    glm::mat4 recordProjMat;
+    glm::vec4 recordViewport;
+    std::shared_ptr<BufferObject> shLodStatsBuffer;  // see SH_LOD_STATS in preprocess_compute.glsl
+    std::shared_ptr<BufferObject> shLodReadbackBuffer;
+    std::vector<uint32_t> shLodStatsVec;  // most recent copy that was read back
+    void* shLodFence;  // GLsync
+    std::shared_ptr<BufferObject> indirectBuffer;  // dispatch and draw commands for the gpu sorts, see sort_args_compute.glsl
+    std::vector<SplatCache::Chunk> chunkVec;  // only with useChunkCulling
+    std::vector<uint32_t> visibleChunkVec;  // indices of the chunks that passed the last CullChunks()
+    std::shared_ptr<BufferObject> visibleChunkBuffer;  // copy of visibleChunkVec, one pre-sort workgroup per entry
 
-    uint32_t sortCount;
+    size_t numSplats;
+    glm::vec3 sceneMin;  // bounds of the splat positions
+    glm::vec3 sceneMax;
+    uint32_t sortCount;  // only used by the cpu sort, the gpu sorts draw with indirectBuffer
     bool isFramebufferSRGBEnabled;
     bool useFullSH;
+    uint32_t shDegree;
     bool useRgcSortOverride;
+    bool isOnesweepProfiled;  // the sort profile picked the onesweep sort, so it has been validated on this gpu
 };
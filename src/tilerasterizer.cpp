@@ -0,0 +1,378 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "tilerasterizer.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES3/gl32.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <algorithm>
+
+#ifndef __ANDROID__
+//#include <tracy/Tracy.hpp>
+#include <Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include "core/log.h"
+#include "core/program.h"
+#include "core/texture.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+#include "multiradixsort.h"
+#include "onesweepsort.h"
+
+// must match preprocess_compute.glsl and tile_render_compute.glsl
+static const uint32_t TILE_SIZE = 16;
+static const uint32_t PREPROCESS_LOCAL_SIZE = 256;
+
+// keys are always sorted with all 32 bits, an even number of passes, so the sorted keys end up back in keyBuffer.
+static const uint32_t KEY_BITS = 32;
+
+// the number of (tile, splat) pairs depends on the view, the buffers start at this many per splat and grow as needed.
+static const size_t INITIAL_INSTANCES_PER_SPLAT = 2;
+static const size_t MIN_INSTANCES = 1 << 16;
+
+// layout of indirectBuffer, see sort_args_compute.glsl
+static const size_t DISPATCH_INDIRECT_OFFSET = 0;
+static const size_t INDIRECT_BUFFER_SIZE = 12;  // in uint32_t
+
+TileRasterizer::TileRasterizer() : numSplats(0), useOnesweepSort(false), numBlocksPerWorkgroup(1), maxInstances(0), numInstances(0),
+                                   imageSize(0, 0), numTiles(0, 0), depthBits(0), countFence(nullptr)
+{
+}
+
+TileRasterizer::~TileRasterizer()
+{
+    if (countFence)
+    {
+        glDeleteSync((GLsync)countFence);
+    }
+}
+
+bool TileRasterizer::Init(size_t numSplatsIn, const std::string& defines, const std::string& shEval, bool useOnesweepSortIn,
+                          uint32_t numBlocksPerWorkgroupIn)
+{
+    GL_ERROR_CHECK("TileRasterizer::Init() begin");
+
+    numSplats = numSplatsIn;
+    useOnesweepSort = useOnesweepSortIn;
+    numBlocksPerWorkgroup = numBlocksPerWorkgroupIn;
+
+    preprocessProg = std::make_shared<Program>();
+    preprocessProg->AddMacro("DEFINES", defines + "#define TILE_KEYS\n");
+    preprocessProg->AddMacro("SH_EVAL", shEval);
+    if (!preprocessProg->LoadCompute("./shader/preprocess_compute.glsl"))
+    {
+        Log::E("Error loading preprocess compute shader!\n");
+        return false;
+    }
+
+    sortArgsProg = std::make_shared<Program>();
+    if (!sortArgsProg->LoadCompute("./shader/sort_args_compute.glsl"))
+    {
+        Log::E("Error loading sort args compute shader!\n");
+        return false;
+    }
+
+    rangesProg = std::make_shared<Program>();
+    if (!rangesProg->LoadCompute("./shader/tile_ranges_compute.glsl"))
+    {
+        Log::E("Error loading tile ranges compute shader!\n");
+        return false;
+    }
+
+    renderProg = std::make_shared<Program>();
+    if (!renderProg->LoadCompute("./shader/tile_render_compute.glsl"))
+    {
+        Log::E("Error loading tile render compute shader!\n");
+        return false;
+    }
+
+    compositeProg = std::make_shared<Program>();
+    if (!compositeProg->LoadVertFrag("./shader/tile_composite_vert.glsl", "./shader/tile_composite_frag.glsl"))
+    {
+        Log::E("Error loading tile composite shaders!\n");
+        return false;
+    }
+    compositeVao = std::make_shared<VertexArrayObject>();
+
+    std::vector<glm::vec4> recordVec(numSplats * 3, glm::vec4(0.0f));
+    recordBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, recordVec, GL_DYNAMIC_STORAGE_BIT);
+
+    countVec.resize(1, 0);
+    countBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, countVec, GL_DYNAMIC_STORAGE_BIT);
+    readbackBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, countVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    std::vector<uint32_t> indirectVec(INDIRECT_BUFFER_SIZE, 0);
+    indirectBuffer = std::make_shared<BufferObject>(GL_DRAW_INDIRECT_BUFFER, indirectVec, GL_DYNAMIC_STORAGE_BIT);
+
+    if (!AllocateInstances(std::max(numSplats * INITIAL_INSTANCES_PER_SPLAT, MIN_INSTANCES)))
+    {
+        return false;
+    }
+
+    GL_ERROR_CHECK("TileRasterizer::Init() end");
+
+    return true;
+}
+
+bool TileRasterizer::IsSupported()
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return GLEW_VERSION_4_3 && (OnesweepSorter::IsSupported() || MultiRadixSorter::IsSupported());
+#endif
+}
+
+bool TileRasterizer::AllocateInstances(size_t maxInstancesIn)
+{
+    maxInstances = maxInstancesIn;
+
+    std::vector<uint32_t> zeroVec(maxInstances, 0);
+    keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+    keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+    valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+    valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+    sortedValBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT);
+
+    if (useOnesweepSort)
+    {
+        onesweepSorter = std::make_shared<OnesweepSorter>();
+        if (!onesweepSorter->Init(maxInstances))
+        {
+            Log::E("Error initializing onesweep sort!\n");
+            return false;
+        }
+    }
+    else
+    {
+        multiRadixSorter = std::make_shared<MultiRadixSorter>();
+        if (!multiRadixSorter->Init(maxInstances, numBlocksPerWorkgroup))
+        {
+            Log::E("Error initializing multi radix sort!\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void TileRasterizer::ResizeImage(uint32_t width, uint32_t height)
+{
+    imageSize = glm::uvec2(width, height);
+    numTiles = glm::uvec2((width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE);
+
+    Texture::Params params = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+    colorTexture = std::make_shared<Texture>(width, height, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, params);
+
+    rangeVec.assign(numTiles.x * numTiles.y * 2, 0);
+    rangeBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, rangeVec, GL_DYNAMIC_STORAGE_BIT);
+
+    // the tile index goes in the top bits of the key, just enough of them for every tile, the rest are depth.
+    uint32_t tileBits = 1;
+    while ((1u << tileBits) < numTiles.x * numTiles.y)
+    {
+        tileBits++;
+    }
+    depthBits = KEY_BITS - tileBits;
+}
+
+void TileRasterizer::ReadInstanceCount()
+{
+    if (!countFence || glClientWaitSync((GLsync)countFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        return;
+    }
+    glDeleteSync((GLsync)countFence);
+    countFence = nullptr;
+
+    readbackBuffer->Read(countVec);
+    numInstances = countVec[0];
+
+    // the instances that didn't fit were dropped from that frame, leave some room so this doesn't happen every frame.
+    if (numInstances > maxInstances)
+    {
+        size_t newMaxInstances = numInstances + numInstances / 4;
+        Log::I("TileRasterizer: %u tile instances, growing buffers from %d to %d\n", numInstances, (int)maxInstances, (int)newMaxInstances);
+        AllocateInstances(newMaxInstances);
+    }
+}
+
+void TileRasterizer::Render(uint32_t splatBuffer, uint32_t colorBuffer, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                            const glm::vec4& viewport, const glm::vec2& nearFar, const glm::vec2& depthRange)
+{
+    ZoneScoped;
+
+    GL_ERROR_CHECK("TileRasterizer::Render() begin");
+
+    uint32_t width = (uint32_t)viewport.z;
+    uint32_t height = (uint32_t)viewport.w;
+    if (!colorTexture || width != imageSize.x || height != imageSize.y)
+    {
+        ResizeImage(width, height);
+    }
+
+    ReadInstanceCount();
+
+    glm::mat4 viewMat = glm::inverse(cameraMat);
+    glm::vec3 eye = glm::vec3(cameraMat[3]);
+
+    {
+        ZoneScopedNC("tile-preprocess", tracy::Color::Red4);
+
+        countVec[0] = 0;
+        countBuffer->Update(countVec);
+        rangeBuffer->Update(rangeVec);
+
+        preprocessProg->Bind();
+        preprocessProg->SetUniform("viewMat", viewMat);
+        preprocessProg->SetUniform("projMat", projMat);
+        preprocessProg->SetUniform("viewport", viewport);
+        if (!colorBuffer)
+        {
+            preprocessProg->SetUniform("eye", eye);
+        }
+        preprocessProg->SetUniform("zNear", nearFar.x);
+        preprocessProg->SetUniform("cullPadding", glm::vec2(0.0f, 0.0f));
+        preprocessProg->SetUniform("numTiles", numTiles);
+        preprocessProg->SetUniform("depthBits", depthBits);
+        preprocessProg->SetUniform("depthRange", depthRange);
+        preprocessProg->SetUniform("maxInstances", (uint32_t)maxInstances);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer);  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, recordBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer->GetObj());
+        if (colorBuffer)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, colorBuffer);  // readonly
+        }
+
+        glDispatchCompute(((GLuint)numSplats + (PREPROCESS_LOCAL_SIZE - 1)) / PREPROCESS_LOCAL_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("TileRasterizer::Render() preprocess");
+    }
+
+    uint32_t numElementsPerWorkgroup = useOnesweepSort ? OnesweepSorter::GetTileSize() : multiRadixSorter->GetElementsPerWorkgroup();
+
+    {
+        ZoneScopedNC("tile-sort-args", tracy::Color::Green);
+
+        sortArgsProg->Bind();
+        sortArgsProg->SetUniform("numElementsPerWorkgroup", numElementsPerWorkgroup);
+        sortArgsProg->SetUniform("maxCount", (uint32_t)maxInstances);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, countBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indirectBuffer->GetObj());  // writeonly
+
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        // keep a copy of the count, which is read back once this frame is done, see ReadInstanceCount()
+        if (!countFence)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, countBuffer->GetObj());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer->GetObj());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        GL_ERROR_CHECK("TileRasterizer::Render() sort-args");
+    }
+
+    {
+        ZoneScopedNC("tile-sort", tracy::Color::Red4);
+        if (useOnesweepSort)
+        {
+            onesweepSorter->Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                                 sortedValBuffer->GetObj(), indirectBuffer->GetObj(), KEY_BITS);
+        }
+        else
+        {
+            multiRadixSorter->SetNumBlocksPerWorkgroup(numBlocksPerWorkgroup);
+            multiRadixSorter->Sort(keyBuffer->GetObj(), keyBuffer2->GetObj(), valBuffer->GetObj(), valBuffer2->GetObj(),
+                                   sortedValBuffer->GetObj(), indirectBuffer->GetObj(), KEY_BITS);
+        }
+        GL_ERROR_CHECK("TileRasterizer::Render() sort");
+    }
+
+    {
+        ZoneScopedNC("tile-ranges", tracy::Color::Green);
+
+        rangesProg->Bind();
+        rangesProg->SetUniform("numElementsPerWorkgroup", numElementsPerWorkgroup);
+        rangesProg->SetUniform("depthBits", depthBits);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rangeBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, indirectBuffer->GetObj());  // readonly
+
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer->GetObj());
+        glDispatchComputeIndirect(DISPATCH_INDIRECT_OFFSET);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("TileRasterizer::Render() ranges");
+    }
+
+    {
+        ZoneScopedNC("tile-render", tracy::Color::Red4);
+
+        renderProg->Bind();
+        renderProg->SetUniform("numTiles", numTiles);
+        renderProg->SetUniform("outImageSize", imageSize);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sortedValBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rangeBuffer->GetObj());  // readonly
+        glBindImageTexture(0, colorTexture->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        glDispatchCompute(numTiles.x, numTiles.y, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        GL_ERROR_CHECK("TileRasterizer::Render() render");
+    }
+
+    {
+        ZoneScopedNC("tile-composite", tracy::Color::DarkGreen);
+
+        // splats are blended in the compute pass, so they can't be depth tested against what's already been drawn.
+        bool depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        compositeProg->Bind();
+        compositeProg->SetUniform("viewport", viewport);
+
+        // use texture unit 0 for colorTexture
+        colorTexture->Bind(0);
+        compositeProg->SetUniform("colorTexture", 0);
+
+        compositeVao->Bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        compositeVao->Unbind();
+
+        if (depthTest)
+        {
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        GL_ERROR_CHECK("TileRasterizer::Render() composite");
+    }
+}
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class BufferObject;
+class MultiRadixSorter;
+class OnesweepSorter;
+class Program;
+struct Texture;
+class VertexArrayObject;
+
+// Compute only splat rendering, like the original 3DGS rasterizer, instead of a global depth sort and a geometry shader.
+// Splats are projected once and binned into 16x16 pixel tiles with (tile, depth) keys, see preprocess_compute.glsl,
+// the keys are sorted with OnesweepSorter or MultiRadixSorter, and each tile is blended front to back in shared memory
+// by tile_render_compute.glsl, which stops as soon as every pixel of the tile is opaque.
+// The result is drawn over the framebuffer with the usual premultiplied alpha blending, without depth testing.
+class TileRasterizer
+{
+public:
+    TileRasterizer();
+    ~TileRasterizer();
+
+    // defines must give SH_DEGREE and the layout of the interleaved splat buffer, see preprocess_compute.glsl.
+    // shEval is the source of sh_eval.glsl.
+    // with useOnesweepSortIn false, MultiRadixSorter is used with numBlocksPerWorkgroupIn.
+    bool Init(size_t numSplatsIn, const std::string& defines, const std::string& shEval, bool useOnesweepSortIn,
+              uint32_t numBlocksPerWorkgroupIn);
+
+    // needs OpenGL 4.3, for image stores, and one of the gpu sorts
+    static bool IsSupported();
+
+    // splatBuffer is the interleaved splat buffer, bound as a shader storage buffer.
+    // colorBuffer is SHColorCache's, when the defines have SH_COLOR_CACHE, otherwise 0.
+    // depthRange = (min depth, 1 / (max depth - min depth)) of the visible splats, see SortKeyParams.
+    void Render(uint32_t splatBuffer, uint32_t colorBuffer, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                const glm::vec4& viewport, const glm::vec2& nearFar, const glm::vec2& depthRange);
+
+    // (tile, splat) pairs of the most recent frame that has been read back, and how many fit in the buffers.
+    uint32_t GetNumInstances() const { return numInstances; }
+    size_t GetMaxInstances() const { return maxInstances; }
+
+protected:
+    bool AllocateInstances(size_t maxInstancesIn);
+    void ResizeImage(uint32_t width, uint32_t height);
+    void ReadInstanceCount();
+
+    size_t numSplats;
+    bool useOnesweepSort;
+    uint32_t numBlocksPerWorkgroup;
+    size_t maxInstances;
+    uint32_t numInstances;
+
+    std::shared_ptr<Program> preprocessProg;
+    std::shared_ptr<Program> sortArgsProg;
+    std::shared_ptr<Program> rangesProg;
+    std::shared_ptr<Program> renderProg;
+    std::shared_ptr<Program> compositeProg;
+    std::shared_ptr<VertexArrayObject> compositeVao;  // empty, the composite triangle has no attributes
+
+    std::shared_ptr<OnesweepSorter> onesweepSorter;
+    std::shared_ptr<MultiRadixSorter> multiRadixSorter;
+
+    std::shared_ptr<BufferObject> recordBuffer;
+    std::shared_ptr<BufferObject> keyBuffer;
+    std::shared_ptr<BufferObject> keyBuffer2;
+    std::shared_ptr<BufferObject> valBuffer;
+    std::shared_ptr<BufferObject> valBuffer2;
+    std::shared_ptr<BufferObject> sortedValBuffer;
+    std::shared_ptr<BufferObject> countBuffer;
+    std::shared_ptr<BufferObject> readbackBuffer;  // copy of countBuffer, see ReadInstanceCount()
+    std::shared_ptr<BufferObject> indirectBuffer;  // see sort_args_compute.glsl
+    std::shared_ptr<BufferObject> rangeBuffer;
+    std::vector<uint32_t> countVec;
+    std::vector<uint32_t> rangeVec;  // zeros
+
+    std::shared_ptr<Texture> colorTexture;
+    glm::uvec2 imageSize;
+    glm::uvec2 numTiles;
+    uint32_t depthBits;
+
+    // the instance count is read back once the frame that wrote it has finished, instead of stalling.
+    void* countFence;  // GLsync
+};